@@ -49,6 +49,7 @@ constexpr auto DrogonPort = 8080;
 constexpr auto DrogonHost = "0.0.0.0";
 constexpr auto DrogonMaxBodySize = 20_GiB;
 constexpr auto DrogonMaxMemoryBodySize = 5_MiB;
+constexpr auto DrogonUploadPath = "/tmp/bxt/";
 } // namespace
 
 void setup_logger() {
@@ -97,14 +98,19 @@ void setup_di_container(kgr::container& container) {
 
     // Invoke all options structures to deserialize their values
     container.invoke<di::Utilities::Configuration, di::Utilities::LMDB::LMDBOptions,
-                     di::Persistence::Box::BoxOptions, di::Presentation::JwtOptions,
-                     di::Presentation::DeploymentOptions>(
-        [](auto& configuration, auto& lmdb_options, auto& box_options, auto& jwt_options,
-           auto& deployment_options) {
+                     di::Persistence::Box::BoxOptions, di::Persistence::Box::PoolGCOptions,
+                     di::Presentation::JwtOptions, di::Presentation::DeploymentOptions>(
+        [](auto& configuration, auto& lmdb_options, auto& box_options, auto& pool_gc_options,
+           auto& jwt_options, auto& deployment_options) {
             lmdb_options.deserialize(configuration);
             box_options.deserialize(configuration);
+            pool_gc_options.deserialize(configuration);
             jwt_options.deserialize(configuration);
             deployment_options.deserialize(configuration);
+
+            pool_gc_options.staging_paths.emplace_back(DrogonUploadPath);
+            pool_gc_options.staging_paths.emplace_back(
+                box_options.box_path / Presentation::UploadStaging::StagingDirectory);
         });
 
     // Parse the repository schema from a YAML file and extend the parser with
@@ -155,12 +161,16 @@ void setup_di_container(kgr::container& container) {
     container.emplace<di::Persistence::Box::LMDBPackageStore>("bxt::Box");
 
     container.emplace<di::Persistence::Box::AlpmDBExporter>();
+    container.service<di::Persistence::Box::PoolLayoutMigrator>();
 
     container.service<di::Persistence::Box::BoxRepository>();
 
     container.invoke<di::Persistence::Box::BoxRepository, di::Persistence::Box::Pool>(
         [](auto& box_repo, auto& pool) { pool.count_links(box_repo); });
 
+    container.service<di::Persistence::Box::PoolGarbageCollector>().start();
+    container.service<di::Persistence::Box::FileListExtractor>().start();
+
     container.service<di::Core::Application::AuthService>();
     container.service<di::Core::Application::PermissionService>();
 
@@ -168,7 +178,8 @@ void setup_di_container(kgr::container& container) {
     container.service<di::Infrastructure::DeploymentService>();
     container.service<di::Infrastructure::WSController>();
 
-    container.service<di::Infrastructure::ArchRepoSyncService>();
+    container.service<di::Infrastructure::ArchRepoSyncService>().start();
+    container.service<di::Infrastructure::SyncScheduler>().start();
     container.service<di::Core::Application::CompareService>();
 }
 
@@ -268,7 +279,7 @@ int main() {
                            .registerPreRoutingAdvice(serveFrontendAdvice)
                            .enableCompressedRequest()
                            .addListener(DrogonHost, DrogonPort)
-                           .setUploadPath("/tmp/bxt/")
+                           .setUploadPath(DrogonUploadPath)
                            .setClientMaxBodySize(DrogonMaxBodySize)
                            .setClientMaxMemoryBodySize(DrogonMaxMemoryBodySize);
 
@@ -11,6 +11,7 @@
 #include "core/domain/value_objects/PackageVersion.h"
 #include "PackageSectionDTO.h"
 #include "parallel_hashmap/phmap.h"
+#include "utilities/alpmdb/Desc.h"
 #include "utilities/log/Logging.h"
 #include "utilities/StaticDTOMapper.h"
 
@@ -28,6 +29,9 @@ struct PackagePoolEntryDTO {
     std::filesystem::path filepath;
     std::optional<std::filesystem::path> signature_path = {};
 
+    // Description parsed while the file was received, not serialized
+    std::optional<Utilities::AlpmDb::Desc> desc = {};
+
     auto operator<=>(PackagePoolEntryDTO const& other) const = default;
 
     template<class Archive> void serialize(Archive& ar) {
@@ -80,8 +84,8 @@ template<> struct bxt::Utilities::StaticDTOMapper<Package, PackageDTO> {
             from.is_any_architecture);
 
         for (auto const& entry : from.pool_entries) {
-            auto entity = PackagePoolEntry::parse_file_path(entry.second.filepath,
-                                                            entry.second.signature_path);
+            auto entity = PackagePoolEntry::parse_file_path(
+                entry.second.filepath, entry.second.signature_path, entry.second.desc);
 
             if (!entity.has_value()) {
                 loge("Failed to parse package pool entry: {}", entry.second.filepath.string());
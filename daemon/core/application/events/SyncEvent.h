@@ -48,4 +48,10 @@ struct SyncFinished : public IntegrationEventBase {
     }
 };
 
+// A scheduled sync of a single section that changed it. It isn't paired with
+// SyncStarted, so it goes to the sync log without ending a running sync.
+struct ScheduledSyncFinished : public SyncFinished {
+    using SyncFinished::SyncFinished;
+};
+
 } // namespace bxt::Core::Application::Events
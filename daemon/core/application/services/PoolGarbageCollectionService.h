@@ -0,0 +1,28 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <cstdint>
+
+namespace bxt::Core::Application {
+
+class PoolGarbageCollectionService {
+public:
+    // Counters of the background garbage collector since the daemon started
+    struct GarbageCollectionStats {
+        uint64_t passes = 0;
+        uint64_t scanned_files = 0;
+        uint64_t reclaimed_files = 0;
+        uint64_t reclaimed_bytes = 0;
+    };
+
+    virtual ~PoolGarbageCollectionService() = default;
+
+    virtual GarbageCollectionStats garbage_collection_stats() const = 0;
+};
+
+} // namespace bxt::Core::Application
@@ -0,0 +1,28 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "core/application/errors/CrudError.h"
+#include "utilities/Error.h"
+#include "utilities/errors/Macro.h"
+
+#include <coro/task.hpp>
+
+namespace bxt::Core::Application {
+
+class PoolMaintenanceService {
+public:
+    BXT_DECLARE_RESULT(CrudError);
+
+    virtual ~PoolMaintenanceService() = default;
+
+    // Starts moving all pool files to the layout that is currently configured.
+    // The migration runs in the background while the daemon keeps serving.
+    virtual coro::task<Result<void>> migrate_layout() = 0;
+};
+
+} // namespace bxt::Core::Application
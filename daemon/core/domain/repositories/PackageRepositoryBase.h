@@ -13,12 +13,24 @@
 #include <core/domain/entities/Package.h>
 #include <core/domain/repositories/RepositoryBase.h>
 #include <functional>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace bxt::Core::Domain {
 struct PackageRepositoryBase : public ReadWriteRepositoryBase<Package> {
     template<typename T> using ReadResult = ReadOnlyRepositoryBase<Package>::Result<T>;
     template<typename T> using WriteResult = ReadWriteRepositoryBase<Package>::Result<T>;
 
+    struct VersionEntry {
+        std::string name;
+        // Version of the preferred pool location
+        PackageVersion version;
+        // Whether the package has a sync pool entry
+        bool synced = false;
+    };
+    using VersionSnapshot = std::vector<VersionEntry>;
+
     virtual coro::task<TResults> find_by_section_async(Section const section,
                                                        std::shared_ptr<UnitOfWorkBase> uow) = 0;
 
@@ -30,5 +42,18 @@ struct PackageRepositoryBase : public ReadWriteRepositoryBase<Package> {
     virtual coro::task<TResult> find_by_section_async(Section const section,
                                                       Name const name,
                                                       std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
+    // Versions of all packages in the section, ordered by name. Skips the
+    // entity mapping, for callers that only compare versions.
+    virtual coro::task<ReadResult<VersionSnapshot>>
+        find_versions_by_section_async(Section const section,
+                                       std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
+    // Drops the given pool location from the packages, a package without any
+    // location left is deleted. Packages not having the location are skipped.
+    virtual coro::task<WriteResult<void>>
+        delete_location_async(std::vector<TId> const ids,
+                              PoolLocation const location,
+                              std::shared_ptr<UnitOfWorkBase> uow) = 0;
 };
 } // namespace bxt::Core::Domain
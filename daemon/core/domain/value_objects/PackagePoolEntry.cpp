@@ -13,7 +13,8 @@ namespace bxt::Core::Domain {
 
 PackagePoolEntry::Result<PackagePoolEntry>
     PackagePoolEntry::parse_file_path(std::filesystem::path const& file_path,
-                                      std::optional<std::filesystem::path> const& signature_path) {
+                                      std::optional<std::filesystem::path> const& signature_path,
+                                      std::optional<Utilities::AlpmDb::Desc> desc) {
     std::string const filename = file_path.filename();
 
     std::vector<std::string> substrings;
@@ -51,17 +52,28 @@ PackagePoolEntry::Result<PackagePoolEntry>
         }
     }
 
-    std::ifstream signature_file(result.m_signature_path.value(), std::ios::binary);
+    if (desc.has_value()) {
+        result.m_desc = std::move(*desc);
+        return result;
+    }
+
+    std::string signature_data;
+    if (result.m_signature_path.has_value()) {
+        std::ifstream signature_file(*result.m_signature_path, std::ios::binary);
 
-    std::string signature_data((std::istreambuf_iterator<char>(signature_file)),
-                               std::istreambuf_iterator<char>());
+        signature_data.assign(std::istreambuf_iterator<char>(signature_file),
+                              std::istreambuf_iterator<char>());
+    }
 
-    auto desc = bxt::Utilities::AlpmDb::Desc::parse_package(file_path, signature_data);
-    if (!desc.has_value()) {
-        return bxt::make_error_with_source<ParsingError>(std::move(desc.error()),
+    // Only .PKGINFO is decompressed here, the file list is attached to the
+    // stored record later by the box FileListExtractor.
+    auto parsed_desc =
+        bxt::Utilities::AlpmDb::Desc::parse_package(file_path, signature_data, false);
+    if (!parsed_desc.has_value()) {
+        return bxt::make_error_with_source<ParsingError>(std::move(parsed_desc.error()),
                                                          ParsingError::ErrorCode::InvalidPackage);
     }
-    result.m_desc = std::move(desc.value());
+    result.m_desc = std::move(parsed_desc.value());
 
     return result;
 }
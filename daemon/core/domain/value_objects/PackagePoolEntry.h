@@ -70,9 +70,12 @@ public:
         return m_desc;
     }
 
+    // The package file is only parsed if no description was parsed before
+    // (e.g. while the file was uploaded).
     static Result<PackagePoolEntry>
         parse_file_path(std::filesystem::path const& file_path,
-                        std::optional<std::filesystem::path> const& signature_path);
+                        std::optional<std::filesystem::path> const& signature_path,
+                        std::optional<Utilities::AlpmDb::Desc> desc = std::nullopt);
 
 private:
     std::filesystem::path m_file_path;
@@ -10,6 +10,8 @@
 #include "core/application/services/CompareService.h"
 #include "core/application/services/PackageService.h"
 #include "core/application/services/PermissionService.h"
+#include "core/application/services/PoolGarbageCollectionService.h"
+#include "core/application/services/PoolMaintenanceService.h"
 #include "core/application/services/SectionService.h"
 #include "core/application/services/UserService.h"
 #include "core/domain/repositories/UnitOfWorkBase.h"
@@ -20,7 +22,9 @@
 #include "event_log/domain/entities/SyncLogEntry.h"
 #include "infrastructure/alpm/ArchRepoOptions.h"
 #include "infrastructure/alpm/ArchRepoSyncService.h"
+#include "infrastructure/alpm/SyncScheduler.h"
 #include "infrastructure/DeploymentService.h"
+#include "infrastructure/HashingService.h"
 #include "infrastructure/PackageService.h"
 #include "infrastructure/ws/WSController.h"
 #include "kangaru/autowire.hpp"
@@ -29,8 +33,12 @@
 #include "persistence/box/BoxRepository.h"
 #include "persistence/box/export/AlpmDBExporter.h"
 #include "persistence/box/export/ExporterBase.h"
+#include "persistence/box/files/FileListExtractor.h"
 #include "persistence/box/pool/Pool.h"
 #include "persistence/box/pool/PoolBase.h"
+#include "persistence/box/pool/PoolGarbageCollector.h"
+#include "persistence/box/pool/PoolGCOptions.h"
+#include "persistence/box/pool/PoolLayoutMigrator.h"
 #include "persistence/box/pool/PoolOptions.h"
 #include "persistence/box/store/LMDBPackageStore.h"
 #include "persistence/box/store/PackageStoreBase.h"
@@ -42,6 +50,7 @@
 #include "presentation/cli-controllers/DeploymentController.h"
 #include "presentation/cli-controllers/DeploymentOptions.h"
 #include "presentation/JwtOptions.h"
+#include "presentation/UploadStaging.h"
 #include "presentation/web-controllers/AuthController.h"
 #include "presentation/web-controllers/CompareController.h"
 #include "presentation/web-controllers/LogController.h"
@@ -125,6 +134,12 @@ namespace Core {
 
         struct SyncService : kgr::abstract_service<bxt::Core::Application::SyncService> {};
 
+        struct PoolMaintenanceService
+            : kgr::abstract_service<bxt::Core::Application::PoolMaintenanceService> {};
+
+        struct PoolGarbageCollectionService
+            : kgr::abstract_service<bxt::Core::Application::PoolGarbageCollectionService> {};
+
         struct UserService
             : kgr::single_service<bxt::Core::Application::UserService,
                                   kgr::dependency<di::Core::Domain::UserRepository,
@@ -187,12 +202,16 @@ namespace Infrastructure {
         : kgr::shared_service<bxt::Infrastructure::WSController,
                               kgr::dependency<di::Utilities::EventBus>> {};
 
+    struct HashingService : kgr::single_service<bxt::Infrastructure::HashingService> {};
+
     struct PackageService
         : kgr::single_service<bxt::Infrastructure::PackageService,
                               kgr::dependency<di::Utilities::EventBusDispatcher,
                                               di::Core::Domain::PackageRepositoryBase,
                                               di::Core::Domain::ReadOnlySectionRepository,
-                                              di::Core::Domain::UnitOfWorkBaseFactory>>
+                                              di::Core::Domain::UnitOfWorkBaseFactory,
+                                              di::Infrastructure::HashingService,
+                                              di::Utilities::IOScheduler>>
         , kgr::overrides<di::Core::Application::PackageService> {};
 
     struct DeploymentService
@@ -210,9 +229,17 @@ namespace Infrastructure {
                               kgr::dependency<di::Utilities::EventBusDispatcher,
                                               di::Core::Domain::PackageRepositoryBase,
                                               di::Infrastructure::ArchRepoOptions,
-                                              di::Core::Domain::UnitOfWorkBaseFactory>>
+                                              di::Core::Domain::UnitOfWorkBaseFactory,
+                                              di::Infrastructure::HashingService,
+                                              di::Utilities::LMDB::Environment>>
         , kgr::overrides<di::Core::Application::SyncService> {};
 
+    struct SyncScheduler
+        : kgr::single_service<bxt::Infrastructure::SyncScheduler,
+                              kgr::dependency<di::Infrastructure::ArchRepoOptions,
+                                              di::Infrastructure::ArchRepoSyncService,
+                                              di::Utilities::IOScheduler>> {};
+
 } // namespace Infrastructure
 
 namespace Persistence {
@@ -262,6 +289,15 @@ namespace Persistence {
                                                   di::Core::Domain::UnitOfWorkBaseFactory>>
             , kgr::overrides<PoolBase> {};
 
+        struct PoolGCOptions : kgr::single_service<bxt::Persistence::Box::PoolGCOptions> {};
+
+        struct PoolGarbageCollector
+            : kgr::single_service<bxt::Persistence::Box::PoolGarbageCollector,
+                                  kgr::dependency<di::Persistence::Box::PoolGCOptions,
+                                                  di::Persistence::Box::Pool,
+                                                  Utilities::IOScheduler>>
+            , kgr::overrides<di::Core::Application::PoolGarbageCollectionService> {};
+
         struct PackageStoreBase : kgr::abstract_service<bxt::Persistence::Box::PackageStoreBase> {};
 
         struct LMDBPackageStore
@@ -286,10 +322,29 @@ namespace Persistence {
                                                   di::Core::Domain::UnitOfWorkBaseFactory>>
             , kgr::overrides<ExporterBase> {};
 
+        struct PoolLayoutMigrator
+            : kgr::single_service<bxt::Persistence::Box::PoolLayoutMigrator,
+                                  kgr::dependency<di::Persistence::Box::PackageStoreBase,
+                                                  di::Persistence::Box::Pool,
+                                                  di::Persistence::Box::ExporterBase,
+                                                  di::Core::Domain::UnitOfWorkBaseFactory,
+                                                  Utilities::IOScheduler>>
+            , kgr::overrides<di::Core::Application::PoolMaintenanceService> {};
+
+        struct FileListExtractor
+            : kgr::single_service<bxt::Persistence::Box::FileListExtractor,
+                                  kgr::dependency<di::Persistence::Box::PackageStoreBase,
+                                                  di::Persistence::Box::ExporterBase,
+                                                  di::Core::Domain::UnitOfWorkBaseFactory,
+                                                  Utilities::IOScheduler>> {};
+
         struct BoxRepository
-            : kgr::single_service<
-                  bxt::Persistence::Box::BoxRepository,
-                  kgr::dependency<BoxOptions, PackageStoreBase, WritebackScheduler, ExporterBase>>
+            : kgr::single_service<bxt::Persistence::Box::BoxRepository,
+                                  kgr::dependency<BoxOptions,
+                                                  PackageStoreBase,
+                                                  WritebackScheduler,
+                                                  ExporterBase,
+                                                  FileListExtractor>>
             , kgr::overrides<di::Core::Domain::PackageRepositoryBase> {};
     } // namespace Box
 } // namespace Persistence
@@ -298,18 +353,27 @@ namespace Presentation {
 
     struct JwtOptions : kgr::single_service<bxt::Presentation::JwtOptions> {};
 
+    struct UploadStaging
+        : kgr::single_service<bxt::Presentation::UploadStaging,
+                              kgr::dependency<di::Persistence::Box::BoxOptions,
+                                              di::Infrastructure::HashingService>> {};
+
     struct PackageController
         : kgr::shared_service<bxt::Presentation::PackageController,
                               kgr::dependency<di::Core::Application::PackageService,
                                               di::Core::Application::SyncService,
-                                              di::Core::Application::PermissionService>> {};
+                                              di::Core::Application::PoolMaintenanceService,
+                                              di::Core::Application::PoolGarbageCollectionService,
+                                              di::Core::Application::PermissionService,
+                                              di::Presentation::UploadStaging>> {};
 
     struct DeploymentOptions : kgr::single_service<bxt::Presentation::DeploymentOptions> {};
 
     struct DeploymentController
         : kgr::shared_service<bxt::Presentation::DeploymentController,
                               kgr::dependency<di::Presentation::DeploymentOptions,
-                                              di::Core::Application::DeploymentService>> {};
+                                              di::Core::Application::DeploymentService,
+                                              di::Presentation::UploadStaging>> {};
 
     struct CompareController
         : kgr::shared_service<bxt::Presentation::CompareController,
@@ -49,7 +49,7 @@ void LogService::init() {
 
     using namespace bxt::Core::Application::Events;
 
-    m_listener.listen<SyncFinished>([this](SyncFinished const& sync_event) {
+    auto const log_sync = [this](SyncFinished const& sync_event) {
         Domain::SyncLogEntry sync_log_entry(
             sync_event.when, sync_event.user_name,
             sync_event.added_packages | transform(pkg_to_log_entry) | to<std::vector>(),
@@ -66,7 +66,9 @@ void LogService::init() {
 
             co_return;
         }());
-    });
+    };
+    m_listener.listen<SyncFinished>(log_sync);
+    m_listener.listen<ScheduledSyncFinished>(log_sync);
 
     m_listener.listen<Commited>([this](auto const& commit_event) {
         Domain::CommitLogEntry commit_log_entry {
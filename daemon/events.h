@@ -40,6 +40,7 @@ static inline std::unordered_map<std::type_index, eventbus_visitor> event_map {
     to_eventbus_visitor<PackageUpdated, EventBase>(),
     to_eventbus_visitor<SyncStarted, IntegrationEventBase>(),
     to_eventbus_visitor<SyncFinished, IntegrationEventBase>(),
+    to_eventbus_visitor<ScheduledSyncFinished, IntegrationEventBase>(),
     to_eventbus_visitor<Commited, IntegrationEventBase>(),
     to_eventbus_visitor<DeploySuccess, IntegrationEventBase>(),
 
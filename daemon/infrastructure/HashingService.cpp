@@ -0,0 +1,114 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "HashingService.h"
+
+#include "utilities/Digest.h"
+#include "utilities/MemoryLiterals.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <coro/when_all.hpp>
+#include <fcntl.h>
+#include <optional>
+#include <ranges>
+#include <unistd.h>
+
+namespace bxt::Infrastructure {
+
+namespace {
+    using namespace bxt::MemoryLiterals;
+
+    constexpr auto HashChunkSize = 1_MiB;
+} // namespace
+
+HashingService::HashingService(uint32_t thread_count)
+    : m_pool(coro::thread_pool::options {.thread_count = std::max(thread_count, 1u)}) {
+}
+
+coro::task<HashingService::Result<std::string>>
+    HashingService::sha256(std::filesystem::path const path) {
+    co_await m_pool.schedule();
+
+    auto checksums = hash_file(path, false);
+    if (!checksums.has_value()) {
+        co_return std::unexpected(std::move(checksums.error()));
+    }
+
+    co_return std::move(checksums->sha256);
+}
+
+coro::task<HashingService::Result<HashingService::Checksums>>
+    HashingService::checksums(std::filesystem::path const path) {
+    co_await m_pool.schedule();
+
+    co_return hash_file(path, true);
+}
+
+coro::task<std::vector<HashingService::Result<std::string>>>
+    HashingService::sha256(std::vector<std::filesystem::path> const paths) {
+    auto tasks = paths | std::views::transform([this](auto const& path) { return sha256(path); })
+                 | std::ranges::to<std::vector>();
+
+    auto hashed = co_await coro::when_all(std::move(tasks));
+
+    std::vector<Result<std::string>> result;
+    result.reserve(hashed.size());
+    for (auto& hash : hashed) {
+        result.emplace_back(std::move(hash.return_value()));
+    }
+
+    co_return result;
+}
+
+HashingService::Result<HashingService::Checksums>
+    HashingService::hash_file(std::filesystem::path const& path, bool with_md5) {
+    auto const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return bxt::make_error<HashingError>(path, std::error_code(errno, std::system_category()));
+    }
+
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // Every pool thread reuses its own buffer
+    thread_local std::vector<uint8_t> buffer(HashChunkSize);
+
+    auto sha256 = Utilities::Digest::sha256();
+    std::optional<Utilities::Digest> md5;
+    if (with_md5) {
+        md5 = Utilities::Digest::md5();
+    }
+
+    Checksums result;
+    ssize_t size = 0;
+    while ((size = ::read(fd, buffer.data(), buffer.size())) != 0) {
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::error_code const ec(errno, std::system_category());
+            ::close(fd);
+            return bxt::make_error<HashingError>(path, ec);
+        }
+
+        sha256.update(buffer.data(), static_cast<std::size_t>(size));
+        if (md5) {
+            md5->update(buffer.data(), static_cast<std::size_t>(size));
+        }
+        result.size += static_cast<std::uintmax_t>(size);
+    }
+
+    ::close(fd);
+
+    result.sha256 = sha256.hex_digest();
+    if (md5) {
+        result.md5 = md5->hex_digest();
+    }
+
+    return result;
+}
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,66 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "utilities/Error.h"
+#include "utilities/errors/Macro.h"
+
+#include <coro/task.hpp>
+#include <coro/thread_pool.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace bxt::Infrastructure {
+
+// Computes file checksums on a dedicated CPU pool. Files are streamed in
+// chunks through OpenSSL EVP, which picks the hardware accelerated
+// implementation (SHA-NI, AVX2, ...) available on the host.
+class HashingService {
+public:
+    struct HashingError : public bxt::Error {
+        HashingError(std::filesystem::path const& path, std::error_code const& ec) {
+            message = fmt::format("Can't hash \"{}\": {}", path.string(), ec.message());
+        }
+    };
+    BXT_DECLARE_RESULT(HashingError);
+
+    struct Checksums {
+        std::uintmax_t size = 0;
+        std::string md5;
+        std::string sha256;
+    };
+
+    explicit HashingService(uint32_t thread_count = std::thread::hardware_concurrency());
+
+    coro::task<Result<std::string>> sha256(std::filesystem::path const path);
+
+    coro::task<Result<Checksums>> checksums(std::filesystem::path const path);
+
+    // Hashes all files concurrently, results are in the order of the paths
+    coro::task<std::vector<Result<std::string>>>
+        sha256(std::vector<std::filesystem::path> const paths);
+
+    // Runs other CPU bound work (e.g. package parsing, which hashes as well)
+    // on the hashing pool.
+    template<typename TFunction>
+    coro::task<std::invoke_result_t<TFunction>> offload(TFunction function) {
+        co_await m_pool.schedule();
+        co_return function();
+    }
+
+private:
+    static Result<Checksums> hash_file(std::filesystem::path const& path, bool with_md5);
+
+    coro::thread_pool m_pool;
+};
+
+} // namespace bxt::Infrastructure
@@ -38,11 +38,25 @@ coro::task<PackageService::Result<void>>
           })
         | std::ranges::to<std::vector>();
 
+    // Parsing decompresses and hashes every package, spread it over the
+    // hashing pool before the write transaction is started.
+    auto parse_tasks =
+        transaction.to_add | std::views::transform([this](PackageDTO const& package) {
+            return m_hashing_service.offload(
+                [package] { return PackageDTOMapper::to_entity(package); });
+        })
+        | std::ranges::to<std::vector>();
+
+    auto parsed_packages = co_await coro::when_all(std::move(parse_tasks));
+
+    // The parsing left us on the hashing pool, LMDB is used from the IO threads
+    co_await m_scheduler->schedule();
+
     auto uow = co_await m_uow_factory(true);
 
     std::vector<coro::task<PackageService::Result<void>>> tasks;
-    for (auto const& package : transaction.to_add) {
-        tasks.push_back(add_package(package, uow));
+    for (auto& parsed_package : parsed_packages) {
+        tasks.push_back(add_package(std::move(parsed_package.return_value()), uow));
     }
 
     auto added = co_await coro::when_all(std::move(tasks));
@@ -149,25 +163,22 @@ coro::task<PackageService::Result<void>>
 }
 
 coro::task<PackageService::Result<void>>
-    PackageService::add_package(PackageDTO const package,
+    PackageService::add_package(Package const deployed_entity,
                                 std::shared_ptr<UnitOfWorkBase> unitofwork) {
-    auto deployed_entity = PackageDTOMapper::to_entity(package);
-
-    auto current_entitites = co_await m_repository.find_by_section_async(
-        SectionDTOMapper::to_entity(package.section), unitofwork);
+    // Only the package itself is compared, loading the whole section would
+    // decode every record of it for each added package
+    auto current_entity = co_await m_repository.find_by_id_async(deployed_entity.id(), unitofwork);
 
-    if (!current_entitites.has_value()) {
+    if (!current_entity.has_value()
+        && current_entity.error().error_type != ReadError::EntityNotFound) {
         co_return bxt::make_error<CrudError>(CrudError::ErrorType::InvalidArgument);
     }
 
-    auto current_entity = std::ranges::find(*current_entitites, package.name, &Package::name);
-
-    if (current_entity != current_entitites->end()
-        && deployed_entity.version() <= current_entity->version()) {
+    if (current_entity.has_value() && deployed_entity.version() <= current_entity->version()) {
         co_return bxt::make_error<CrudError>(CrudError::ErrorType::EntityAlreadyExists);
     }
 
-    auto saved = co_await m_repository.save_async(PackageDTOMapper::to_entity(package), unitofwork);
+    auto saved = co_await m_repository.save_async(deployed_entity, unitofwork);
 
     if (!saved.has_value()) {
         co_return bxt::make_error_with_source<CrudError>(std::move(saved.error()),
@@ -13,7 +13,9 @@
 #include "core/domain/repositories/PackageRepositoryBase.h"
 #include "core/domain/repositories/ReadOnlyRepositoryBase.h"
 #include "core/domain/repositories/UnitOfWorkBase.h"
+#include "coro/io_scheduler.hpp"
 #include "coro/task.hpp"
+#include "infrastructure/HashingService.h"
 #include "PackageServiceOptions.h"
 #include "utilities/eventbus/EventBusDispatcher.h"
 
@@ -26,11 +28,15 @@ public:
     PackageService(Utilities::EventBusDispatcher& dispatcher,
                    Core::Domain::PackageRepositoryBase& repository,
                    Core::Domain::ReadOnlyRepositoryBase<Core::Domain::Section>& section_repository,
-                   UnitOfWorkBaseFactory& uow_factory)
+                   UnitOfWorkBaseFactory& uow_factory,
+                   HashingService& hashing_service,
+                   std::shared_ptr<coro::io_scheduler> scheduler)
         : m_dispatcher(dispatcher)
         , m_repository(repository)
         , m_section_repository(section_repository)
-        , m_uow_factory(uow_factory) {
+        , m_uow_factory(uow_factory)
+        , m_hashing_service(hashing_service)
+        , m_scheduler(std::move(scheduler)) {
     }
 
     virtual coro::task<Result<void>> commit_transaction(Transaction const transaction) override;
@@ -49,7 +55,7 @@ public:
                                          std::string const arch) override;
 
 private:
-    coro::task<Result<void>> add_package(PackageDTO const package,
+    coro::task<Result<void>> add_package(Package const package,
                                          std::shared_ptr<UnitOfWorkBase> uow);
 
     coro::task<PackageService::Result<void>>
@@ -69,6 +75,8 @@ private:
     Core::Domain::PackageRepositoryBase& m_repository;
     Core::Domain::ReadOnlyRepositoryBase<Section>& m_section_repository;
     UnitOfWorkBaseFactory& m_uow_factory;
+    HashingService& m_hashing_service;
+    std::shared_ptr<coro::io_scheduler> m_scheduler;
 };
 
 } // namespace bxt::Infrastructure
@@ -11,6 +11,7 @@
 #include "infrastructure/alpm/ArchRepoSource.h"
 #include "utilities/repo-schema/SchemaExtension.h"
 
+#include <chrono>
 #include <filesystem>
 #include <parallel_hashmap/phmap.h>
 #include <yaml-cpp/yaml.h>
@@ -21,6 +22,29 @@ struct ArchRepoOptions : public Utilities::RepoSchema::Extension {
     phmap::parallel_flat_hash_map<Core::Application::PackageSectionDTO, ArchRepoSource> sources;
     std::filesystem::path download_path = "/var/cache/bxt/packages";
 
+    // Upper bound of simultaneous connections to a single mirror
+    std::size_t max_connections_per_host = 4;
+    // Upper bound of simultaneous downloads over all mirrors
+    std::size_t max_concurrent_downloads = 8;
+    // Extra attempts to fetch a section's database
+    std::size_t database_retries = 4;
+    // Extra download rounds for the packages of a section that failed
+    std::size_t package_retries = 3;
+    // Failed syncs after which a package version is skipped, 0 disables it
+    std::size_t quarantine_after = 0;
+    // Package changes written per transaction when a sync is saved
+    std::size_t commit_batch_size = 256;
+    // Verified cache files are hashed again once this old, 0 disables it
+    std::chrono::seconds cache_scrub_age = std::chrono::days(7);
+    // Delay between two passes over the verified cache files
+    std::chrono::seconds cache_scrub_interval = std::chrono::hours(6);
+    // Delay between scheduled syncs of a section, 0 disables them
+    std::chrono::seconds sync_interval = std::chrono::seconds(0);
+    // Upper bound of the random delay added to every scheduled sync
+    std::chrono::seconds sync_jitter = std::chrono::minutes(5);
+    // Sections synced by the scheduler at the same time
+    std::size_t max_concurrent_sections = 2;
+
     virtual void parse(const YAML::Node& root_node) override {
         constexpr char Tag[] = "(alpm.sync)";
 
@@ -29,6 +53,42 @@ struct ArchRepoOptions : public Utilities::RepoSchema::Extension {
         if (options_node["download-path"].IsDefined() && options_node["download-path"].IsScalar()) {
             download_path = options_node["download-path"].as<std::string>();
         }
+        if (options_node["max-connections-per-host"].IsScalar()) {
+            max_connections_per_host =
+                options_node["max-connections-per-host"].as<std::size_t>();
+        }
+        if (options_node["max-concurrent-downloads"].IsScalar()) {
+            max_concurrent_downloads =
+                options_node["max-concurrent-downloads"].as<std::size_t>();
+        }
+        if (options_node["database-retries"].IsScalar()) {
+            database_retries = options_node["database-retries"].as<std::size_t>();
+        }
+        if (options_node["package-retries"].IsScalar()) {
+            package_retries = options_node["package-retries"].as<std::size_t>();
+        }
+        if (options_node["quarantine-after"].IsScalar()) {
+            quarantine_after = options_node["quarantine-after"].as<std::size_t>();
+        }
+        if (options_node["commit-batch-size"].IsScalar()) {
+            commit_batch_size = options_node["commit-batch-size"].as<std::size_t>();
+        }
+        if (options_node["cache-scrub-age"].IsScalar()) {
+            cache_scrub_age = std::chrono::seconds(options_node["cache-scrub-age"].as<int64_t>());
+        }
+        if (options_node["cache-scrub-interval"].IsScalar()) {
+            cache_scrub_interval =
+                std::chrono::seconds(options_node["cache-scrub-interval"].as<int64_t>());
+        }
+        if (options_node["sync-interval"].IsScalar()) {
+            sync_interval = std::chrono::seconds(options_node["sync-interval"].as<int64_t>());
+        }
+        if (options_node["sync-jitter"].IsScalar()) {
+            sync_jitter = std::chrono::seconds(options_node["sync-jitter"].as<int64_t>());
+        }
+        if (options_node["max-concurrent-sections"].IsScalar()) {
+            max_concurrent_sections = options_node["max-concurrent-sections"].as<std::size_t>();
+        }
         for (auto const& branch : options_node["sync-branches"].as<std::vector<std::string>>()) {
             for (auto const& repo : root_node["repositories"]) {
                 auto const& key = repo.first;
@@ -6,11 +6,15 @@
  */
 #pragma once
 
+#include "infrastructure/alpm/ExclusionMatcher.h"
+
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <optional>
-#include <parallel_hashmap/phmap.h>
 #include <string>
+#include <vector>
 #include <yaml-cpp/yaml.h>
 
 namespace bxt::Infrastructure {
@@ -29,28 +33,42 @@ struct ArchRepoSource {
             return node[value].as<TReturn>();
         };
 
-        result.repo_url = get_if_defined("repo-url", result.repo_url);
+        // Either one mirror or a list of them
+        if (node["repo-url"].IsSequence() && node["repo-url"].size() > 0) {
+            result.repo_urls = node["repo-url"].as<std::vector<std::string>>();
+        } else if (node["repo-url"].IsScalar()) {
+            result.repo_urls = {node["repo-url"].as<std::string>()};
+        }
         result.repo_structure_template =
             get_if_defined("repo-structure-template", result.repo_structure_template);
         auto const exclude_list_path =
             get_if_defined.operator()<std::string>("exclude-list-path", "exclude_list");
         std::ifstream file(exclude_list_path);
         if (file.is_open()) {
+            std::vector<std::string> patterns;
             std::string line;
             while (std::getline(file, line)) {
-                result.exclude_list.insert(std::move(line));
+                patterns.emplace_back(std::move(line));
             }
             file.close();
+
+            result.exclusions = ExclusionMatcher(patterns);
+        }
+
+        if (node["sync-interval"].IsScalar()) {
+            result.sync_interval = std::chrono::seconds(node["sync-interval"].as<int64_t>());
         }
 
         return result;
     };
 
-    std::string repo_url = "cloudflaremirrors.com";
+    std::vector<std::string> repo_urls = {"cloudflaremirrors.com"};
     std::string repo_structure_template = "/archlinux/{repository}/os/{architecture}";
-    phmap::parallel_flat_hash_set<std::string> exclude_list;
+    ExclusionMatcher exclusions;
 
     std::optional<std::string> repo_name;
+    // Overrides the global sync interval for this source, 0 disables it
+    std::optional<std::chrono::seconds> sync_interval;
 };
 
 } // namespace bxt::Infrastructure
@@ -12,32 +12,126 @@
 #include "core/domain/entities/Package.h"
 #include "core/domain/enums/PoolLocation.h"
 #include "core/domain/repositories/UnitOfWorkBase.h"
+#include "core/domain/value_objects/PackagePoolEntry.h"
+#include "persistence/lmdb/LmdbUnitOfWork.h"
 #include "utilities/alpmdb/Desc.h"
 #include "utilities/base64.h"
+#include "utilities/Digest.h"
 #include "utilities/Error.h"
-#include "utilities/hash_from_file.h"
 #include "utilities/libarchive/Reader.h"
 #include "utilities/log/Logging.h"
 #include "utilities/to_string.h"
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <coro/event.hpp>
 #include <coro/sync_wait.hpp>
 #include <coro/thread_pool.hpp>
 #include <coro/when_all.hpp>
 #include <expected>
+#include <functional>
 #include <httplib.h>
 #include <ios>
 #include <iterator>
 #include <memory>
+#include <mutex>
 #include <nonstd/scope.hpp>
-#include <openssl/sha.h>
 #include <optional>
+#include <parallel_hashmap/phmap.h>
+#include <random>
 #include <ranges>
 #include <string>
 #include <system_error>
+#include <thread>
+#include <tuple>
 #include <vector>
 
 namespace bxt::Infrastructure {
 
+namespace {
+    // Downloads started while the section's database is parsed. The parse
+    // counts as one pending item until it ends, the last one sets `done`.
+    struct StartedDownloads {
+        // False if the package was started already, e.g. by an earlier
+        // attempt to fetch the database
+        bool add(std::string const& name) {
+            std::lock_guard lock(mutex);
+            if (!started.emplace(name).second) {
+                return false;
+            }
+            ++pending;
+            return true;
+        }
+
+        void complete() {
+            if (--pending == 0) {
+                done.set();
+            }
+        }
+
+        std::mutex mutex;
+        phmap::flat_hash_set<std::string> started;
+        std::vector<Package> packages;
+        std::vector<ArchRepoSyncService::FailedDownload> failed;
+        std::atomic<std::size_t> pending = 1;
+        // Set once the database can't be fetched, downloads finishing
+        // after that aren't written
+        std::atomic<bool> abandoned = false;
+        coro::event done;
+    };
+
+    // Exponential, with up to half of it added as jitter so retries of
+    // concurrent sections don't hit the mirrors at the same moment
+    std::chrono::milliseconds retry_delay(std::size_t round) {
+        using namespace std::chrono_literals;
+        constexpr auto base = 500ms;
+        constexpr auto limit = 30s;
+
+        auto const exponent = std::min<std::size_t>(round, 6);
+        auto const delay = std::min<std::chrono::milliseconds>(base * (1U << exponent), limit);
+
+        thread_local std::mt19937 generator {std::random_device {}()};
+        std::uniform_int_distribution<std::chrono::milliseconds::rep> jitter(0,
+                                                                            delay.count() / 2);
+
+        return delay + std::chrono::milliseconds(jitter(generator));
+    }
+
+    // What the sync log needs of a package once it went to the writer: the
+    // descriptions are by far the largest part and are dropped
+    Package log_summary(Package const& package) {
+        Package summary(package.section(), package.name(), package.is_any_arch());
+        for (auto const& [location, entry] : package.pool_entries()) {
+            summary.pool_entries().emplace(
+                location, Core::Domain::PackagePoolEntry(entry.file_path(), entry.signature_path(),
+                                                         {}, entry.version()));
+        }
+        return summary;
+    }
+
+    // Runs a blocking function on a thread of its own. Setting the event
+    // resumes the caller on that thread, so it moves to the scheduler before
+    // the thread is joined.
+    template<typename TFunction>
+    coro::task<std::invoke_result_t<TFunction>>
+        run_on_thread(std::shared_ptr<coro::io_scheduler> scheduler, TFunction function) {
+        std::optional<std::invoke_result_t<TFunction>> result;
+        coro::event done;
+
+        std::jthread thread([&] {
+            result.emplace(function());
+            done.set();
+        });
+
+        co_await done;
+        co_await scheduler->schedule();
+
+        co_return std::move(*result);
+    }
+} // namespace
+
 coro::task<SyncService::Result<void>> ArchRepoSyncService::sync(PackageSectionDTO const section,
                                                                 RequestContext const context) {
     using namespace Core::Application::Events;
@@ -45,22 +139,77 @@ coro::task<SyncService::Result<void>> ArchRepoSyncService::sync(PackageSectionDT
     co_await m_dispatcher.dispatch_single_async<IntegrationEventPtr>(
         std::make_shared<SyncStarted>());
 
-    auto uow = co_await m_uow_factory(true);
+    SectionChanges changes;
+    auto synced = co_await sync_and_save(section, DownloadScheduler::Priority::User, changes);
+
+    // Packages written before a failure are reported as well
+    co_await m_dispatcher.dispatch_single_async<IntegrationEventPtr>(std::make_shared<SyncFinished>(
+        std::move(changes.packages), std::move(changes.removed), context.user_name));
+
+    if (!synced.has_value()) {
+        co_return std::unexpected(std::move(synced.error()));
+    }
+
+    co_return {};
+}
 
-    auto all_packages = co_await sync_section(section);
-    if (!all_packages.has_value()) {
+coro::task<SyncService::Result<bool>>
+    ArchRepoSyncService::sync_scheduled(PackageSectionDTO const section) {
+    using namespace Core::Application::Events;
+
+    SectionChanges changes;
+    auto synced = co_await sync_and_save(section, DownloadScheduler::Priority::Normal, changes);
+
+    // Unchanged sections leave no trace in the sync log, failed ones report
+    // what they have written
+    bool const changed = !changes.packages.empty() || !changes.removed.empty();
+    if (changed) {
         co_await m_dispatcher.dispatch_single_async<IntegrationEventPtr>(
-            std::make_shared<SyncFinished>(std::move(*all_packages),
-                                           std::vector<bxt::Core::Domain::Package::TId> {},
-                                           context.user_name));
+            std::make_shared<ScheduledSyncFinished>(
+                std::move(changes.packages), std::move(changes.removed), ScheduledSyncUser));
+    }
 
-        co_return std::unexpected(all_packages.error());
+    if (!synced.has_value()) {
+        co_return std::unexpected(std::move(synced.error()));
     }
-    co_await uow->commit_async();
 
-    co_await m_dispatcher.dispatch_single_async<IntegrationEventPtr>(std::make_shared<SyncFinished>(
-        std::move(*all_packages), std::vector<bxt::Core::Domain::Package::TId> {},
-        context.user_name));
+    co_return changed;
+}
+
+coro::task<SyncService::Result<void>>
+    ArchRepoSyncService::sync_and_save(PackageSectionDTO const section,
+                                       DownloadScheduler::Priority priority,
+                                       SectionChanges& saved) {
+    std::vector<Package> written;
+    PackageWriter writer(package_writer_options(), [this, &written](std::vector<Package> batch) {
+        return write_packages(std::move(batch), written);
+    });
+
+    auto const state_key = bxt::to_string(section);
+    auto changes = co_await sync_section(section, priority, writer);
+
+    // The packages pushed before a failure are written in any case
+    auto finished = co_await writer.finish();
+    saved.packages = std::move(written);
+
+    if (!changes.has_value()) {
+        forget_upstream_state(state_key);
+        co_return std::unexpected(std::move(changes.error()));
+    }
+    if (changes->skipped) {
+        co_return {};
+    }
+    if (!finished.has_value()) {
+        forget_upstream_state(state_key);
+        co_return std::unexpected(std::move(finished.error()));
+    }
+
+    auto removed = co_await save_changes(*changes, {state_key});
+    if (!removed.has_value()) {
+        forget_upstream_state(state_key);
+        co_return std::unexpected(std::move(removed.error()));
+    }
+    saved.removed = std::move(changes->removed);
 
     co_return {};
 }
@@ -68,10 +217,17 @@ coro::task<SyncService::Result<void>> ArchRepoSyncService::sync(PackageSectionDT
 coro::task<SyncService::Result<void>> ArchRepoSyncService::sync_all(RequestContext const context) {
     using namespace Core::Application::Events;
 
-    auto tasks =
-        m_options.sources
-        | std::views::transform([this](auto const& src) { return sync_section(src.first); })
-        | std::ranges::to<std::vector>();
+    // Shared by the sections, so their batches don't compete for the writer
+    std::vector<Package> written;
+    PackageWriter writer(package_writer_options(), [this, &written](std::vector<Package> batch) {
+        return write_packages(std::move(batch), written);
+    });
+
+    auto const sections = m_options.sources | std::views::keys | std::ranges::to<std::vector>();
+    auto tasks = sections | std::views::transform([this, &writer](auto const& section) {
+                     return sync_section(section, DownloadScheduler::Priority::Normal, writer);
+                 })
+                 | std::ranges::to<std::vector>();
 
     auto guard = nonstd::make_scope_exit([this]() {
         coro::sync_wait(m_dispatcher.dispatch_single_async<IntegrationEventPtr>(
@@ -81,119 +237,333 @@ coro::task<SyncService::Result<void>> ArchRepoSyncService::sync_all(RequestConte
     co_await m_dispatcher.dispatch_single_async<IntegrationEventPtr>(
         std::make_shared<SyncStarted>());
 
-    auto package_lists = co_await coro::when_all(std::move(tasks));
+    auto section_changes = co_await coro::when_all(std::move(tasks));
 
-    if (package_lists.empty()) {
+    if (section_changes.empty()) {
         logi("No packages to sync");
         co_return {};
     }
 
-    auto& all_packages = package_lists[0].return_value();
-    if (!all_packages.has_value()) {
-        loge("Failed to sync packages: {}", all_packages.error().what());
-        co_return std::unexpected(all_packages.error());
+    SectionChanges all_changes;
+    // Sections skipped for another run leave their states to it
+    std::vector<std::string> state_keys;
+    std::optional<SyncError> error;
+    for (std::size_t i = 0; i < section_changes.size(); ++i) {
+        auto& changes = section_changes[i].return_value();
+        if (changes.has_value() && changes->skipped) {
+            continue;
+        }
+        state_keys.emplace_back(bxt::to_string(sections[i]));
+
+        if (!changes.has_value()) {
+            loge("Failed to sync packages: {}", changes.error().what());
+            if (!error.has_value()) {
+                error = std::move(changes.error());
+            }
+            continue;
+        }
+
+        // Only the removals, the written packages come from the writer
+        all_changes.removed.insert(all_changes.removed.end(),
+                                   std::make_move_iterator(changes->removed.begin()),
+                                   std::make_move_iterator(changes->removed.end()));
+    }
+
+    // The packages of failed sections that were pushed already are written
+    // as well
+    if (auto finished = co_await writer.finish(); !finished.has_value()) {
+        loge("Failed to save packages: {}", finished.error().what());
+        if (!error.has_value()) {
+            error = std::move(finished.error());
+        }
     }
 
-    for (auto it = package_lists.begin() + 1; it != package_lists.end(); ++it) {
-        auto& package_list = it->return_value();
+    logi("Saved {} packages in {} transactions", writer.written(), writer.batches());
 
-        if (!package_list.has_value()) {
-            loge("Failed to sync packages: {}", all_packages.error().what());
+    // Removals and upstream states wait for a sync that went through
+    std::vector<Package::TId> removed;
+    if (!error.has_value()) {
+        logi("Removing {} packages dropped upstream...", all_changes.removed.size());
 
-            co_return std::unexpected(package_list.error());
+        auto saved = co_await save_changes(all_changes, state_keys);
+        if (saved.has_value()) {
+            removed = std::move(all_changes.removed);
+        } else {
+            error = std::move(saved.error());
+        }
+    } else {
+        // The next sync fetches the databases of this one again
+        for (auto const& key : state_keys) {
+            forget_upstream_state(key);
         }
+    }
 
-        all_packages->insert(all_packages->end(), std::make_move_iterator(package_list->begin()),
-                             std::make_move_iterator(package_list->end()));
+    co_await m_dispatcher.dispatch_single_async<IntegrationEventPtr>(std::make_shared<SyncFinished>(
+        std::move(written), std::move(removed), context.user_name));
+    guard.release();
+
+    if (error.has_value()) {
+        co_return std::unexpected(std::move(*error));
     }
+    co_return {};
+}
+
+void ArchRepoSyncService::start() {
+    m_verified_cache.start();
+}
+
+ArchRepoSyncService::PackageWriter::Options ArchRepoSyncService::package_writer_options() const {
+    auto const batch_size = std::max<std::size_t>(1, m_options.commit_batch_size);
 
-    logi("Downloaded {} packages, saving to database...", all_packages->size());
+    // A few batches may queue up while one is written, more means the
+    // database can't keep up and the downloads have to wait
+    return {.batch_size = batch_size, .capacity = 4 * batch_size};
+}
+
+coro::task<SyncService::Result<void>>
+    ArchRepoSyncService::write_packages(std::vector<Package> batch,
+                                        std::vector<Package>& written) {
+    auto summaries = batch | std::views::transform(log_summary) | std::ranges::to<std::vector>();
 
     auto uow = co_await m_uow_factory(true);
 
-    auto saved = co_await m_package_repository.save_async(*all_packages, uow);
+    auto saved = co_await m_package_repository.save_async(std::move(batch), uow);
     if (!saved.has_value()) {
         loge("Failed to save packages: {}", saved.error().what());
         co_return bxt::make_error_with_source<SyncError>(std::move(saved.error()),
                                                          SyncError::RepositoryError);
     }
 
-    auto commit_ok = co_await uow->commit_async();
+    // The cache files of the batch move to the pool with the commit, only
+    // the ones left behind by failed attempts keep their entries
+    for (auto const& summary : summaries) {
+        m_verified_cache.forget(summary.filepath());
+    }
+    if (auto verified = co_await m_verified_cache.save(uow); !verified.has_value()) {
+        logw("Can't save the verified cache files: {}", verified.error().what());
+    }
 
+    auto commit_ok = co_await uow->commit_async();
     if (!commit_ok.has_value()) {
-        loge("Failed to save packages: {}", saved.error().what());
+        loge("Failed to commit packages: {}", commit_ok.error().what());
         co_return bxt::make_error_with_source<SyncError>(std::move(commit_ok.error()),
                                                          SyncError::RepositoryError);
     }
 
-    logi("Saved {} packages to database", all_packages->size());
+    written.insert(written.end(), std::make_move_iterator(summaries.begin()),
+                   std::make_move_iterator(summaries.end()));
+    co_return {};
+}
+
+coro::task<SyncService::Result<void>>
+    ArchRepoSyncService::save_changes(SectionChanges const& changes,
+                                      std::vector<std::string> const& state_keys) {
+    auto const batch_size = std::max<std::size_t>(1, m_options.commit_batch_size);
+    auto const& removed = changes.removed;
+
+    // At least one transaction, the upstream states are saved even when
+    // nothing was removed
+    std::size_t next_removal = 0;
+    bool last = false;
+    while (!last) {
+        auto uow = co_await m_uow_factory(true);
+
+        auto const removal_count = std::min(batch_size, removed.size() - next_removal);
+        if (removal_count > 0) {
+            auto batch = removed | std::views::drop(next_removal)
+                         | std::views::take(removal_count) | std::ranges::to<std::vector>();
+
+            auto deleted = co_await m_package_repository.delete_location_async(
+                std::move(batch), Core::Domain::PoolLocation::Sync, uow);
+            if (!deleted.has_value()) {
+                loge("Failed to remove packages: {}", deleted.error().what());
+                co_return bxt::make_error_with_source<SyncError>(std::move(deleted.error()),
+                                                                 SyncError::RepositoryError);
+            }
+            next_removal += removal_count;
+        }
+
+        last = next_removal == removed.size();
+        if (last) {
+            auto states_saved = co_await save_upstream_states(uow, state_keys);
+            if (!states_saved.has_value()) {
+                loge("Failed to save upstream states: {}", states_saved.error().what());
+                co_return bxt::make_error_with_source<SyncError>(std::move(states_saved.error()),
+                                                                 SyncError::RepositoryError);
+            }
+
+            // Files of failed downloads may have been verified as well
+            if (auto verified = co_await m_verified_cache.save(uow); !verified.has_value()) {
+                logw("Can't save the verified cache files: {}", verified.error().what());
+            }
+        }
+
+        auto commit_ok = co_await uow->commit_async();
+        if (!commit_ok.has_value()) {
+            loge("Failed to commit the sync: {}", commit_ok.error().what());
+            co_return bxt::make_error_with_source<SyncError>(std::move(commit_ok.error()),
+                                                             SyncError::RepositoryError);
+        }
+    }
 
-    co_await m_dispatcher.dispatch_single_async<IntegrationEventPtr>(std::make_shared<SyncFinished>(
-        std::move(*all_packages), std::vector<bxt::Core::Domain::Package::TId> {},
-        context.user_name));
-    guard.release();
     co_return {};
 }
 
-coro::task<SyncService::Result<std::vector<Package>>>
-    ArchRepoSyncService::sync_section(PackageSectionDTO const section) {
+coro::task<SyncService::Result<ArchRepoSyncService::SectionChanges>>
+    ArchRepoSyncService::sync_section(PackageSectionDTO const section,
+                                      DownloadScheduler::Priority priority,
+                                      PackageWriter& writer) {
     if (!m_options.sources.contains(section)) {
         co_return {};
     }
-    constexpr int max_retries = 5;
-    std::vector<Package> packages;
 
-    for (int attempt = 0; attempt < max_retries; ++attempt) {
-        auto remote_packages = co_await get_available_packages(section);
+    auto const section_name = bxt::to_string(section);
 
-        if (!remote_packages.has_value()) {
-            if (attempt == max_retries - 1) {
-                co_return bxt::make_error_with_source<SyncError>(std::move(remote_packages.error()),
-                                                                 SyncError::NetworkError);
-            }
-            continue;
+    // A section synced by request and by the scheduler at the same time
+    // would download every package twice
+    {
+        std::lock_guard lock(m_running_mutex);
+        if (!m_running_sections.emplace(section_name).second) {
+            logi("Section {} is being synced already, skipping it", section_name);
+            co_return SectionChanges {.skipped = true};
         }
+    }
+    auto const running = nonstd::make_scope_exit([this, &section_name] {
+        std::lock_guard lock(m_running_mutex);
+        m_running_sections.erase(section_name);
+    });
 
-        auto task = [this, section](PackageInfo const pkginfo) -> coro::task<Result<Package>> {
-            co_return co_await download_package(section, pkginfo.filename, pkginfo.hash,
-                                                pkginfo.signature);
-        };
+    auto const quarantine = co_await load_quarantine(section_name);
 
-        auto tasks =
-            *remote_packages | std::views::transform(task) | std::ranges::to<std::vector>();
+    auto downloads = std::make_shared<StartedDownloads>();
+    std::atomic<std::size_t> quarantined_count = 0;
 
-        auto const package_results = co_await coro::when_all(std::move(tasks));
-        bool all_downloads_successful = true;
-        packages.clear();
-        packages.reserve(package_results.size());
+    // Called from the parsing thread
+    auto const start_download = [&, this](PackageInfo package) {
+        if (auto const it = quarantine.find(package.name);
+            it != quarantine.end() && it->second.version == package.version.string()
+            && it->second.failures >= m_options.quarantine_after) {
+            logw("Package {} {} is quarantined after {} failed syncs. Skipping.", package.name,
+                 package.version.string(), it->second.failures);
+            ++quarantined_count;
+            return;
+        }
 
-        for (auto const& package_result : package_results) {
-            auto& package = package_result.return_value();
+        if (!downloads->add(package.name)) {
+            return;
+        }
 
-            if (!package.has_value()) {
-                loge("Download of {} has failed. The reason is \"{}\". "
-                     "Retrying...",
-                     package.error().package_filename, package.error().what());
-                all_downloads_successful = false;
-                break;
+        tp->schedule([](ArchRepoSyncService* self, PackageSectionDTO target,
+                        PackageInfo package_info, DownloadScheduler::Priority order,
+                        PackageWriter* package_writer,
+                        std::shared_ptr<StartedDownloads> started) -> coro::task<void> {
+            auto result = co_await self->download_package(target, package_info, order);
+            if (result.has_value()) {
+                auto summary = log_summary(*result);
+                // Waits while the writer is behind
+                if (!started->abandoned && co_await package_writer->push(std::move(*result))) {
+                    std::lock_guard lock(started->mutex);
+                    started->packages.emplace_back(std::move(summary));
+                }
+            } else {
+                std::lock_guard lock(started->mutex);
+                started->failed.emplace_back(std::move(package_info), result.error().what());
             }
+            started->complete();
+        }(this, section, std::move(package), priority, &writer, downloads));
+    };
 
-            packages.emplace_back(std::move(*package));
-        }
+    // Downloads already running keep going while the database is retried,
+    // the ones that succeeded aren't started again
+    ArchRepoSyncService::Result<UpstreamDiff> diff;
+    for (std::size_t attempt = 0; attempt <= m_options.database_retries; ++attempt) {
+        diff = co_await get_available_packages(section, start_download);
 
-        if (all_downloads_successful) {
+        if (diff.has_value()) {
             break;
         }
 
-        if (attempt == max_retries - 1) {
-            loge("Max retries reached. Some package downloads failed.");
-            co_return bxt::make_error<SyncError>(SyncError::NetworkError);
+        logw("Can't get the packages of {}: {}", section_name, diff.error().what());
+        if (attempt < m_options.database_retries) {
+            co_await tp->yield_for(retry_delay(attempt));
+        }
+    }
+
+    // The section fails, the downloads still running are left unwritten
+    if (!diff.has_value()) {
+        downloads->abandoned = true;
+    }
+    downloads->complete();
+    co_await downloads->done;
+
+    if (!diff.has_value()) {
+        co_return bxt::make_error_with_source<SyncError>(std::move(diff.error()),
+                                                         SyncError::NetworkError);
+    }
+
+    auto packages = std::move(downloads->packages);
+    auto failed = std::move(downloads->failed);
+
+    // Only the failed packages are downloaded again
+    for (std::size_t round = 0; round < m_options.package_retries && !failed.empty(); ++round) {
+        auto const delay = retry_delay(round);
+        logi("Section {}: retrying {} failed downloads in {} ms", section_name, failed.size(),
+             delay.count());
+        co_await tp->yield_for(delay);
+
+        auto retries = failed | std::views::transform([&](FailedDownload const& download) {
+                           return download_package(section, download.package, priority);
+                       })
+                       | std::ranges::to<std::vector>();
+
+        auto results = co_await coro::when_all(std::move(retries));
+
+        std::vector<FailedDownload> still_failed;
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            auto& result = results[i].return_value();
+
+            if (!result.has_value()) {
+                still_failed.emplace_back(std::move(failed[i].package), result.error().what());
+                continue;
+            }
+
+            auto summary = log_summary(*result);
+            if (co_await writer.push(std::move(*result))) {
+                packages.emplace_back(std::move(summary));
+            }
         }
+        failed = std::move(still_failed);
+    }
+
+    auto const progress = m_download_scheduler.progress();
+    logi("Section {}: {} packages fetched, {} failed, {} quarantined. Downloads: {} completed, "
+         "{} failed, {} queued, {} MiB received",
+         section_name, packages.size(), failed.size(), quarantined_count.load(), progress.completed,
+         progress.failed, progress.queued, progress.bytes_received / (1024 * 1024));
+
+    for (auto const& [package, reason] : failed) {
+        loge("Download of {} has failed. The reason is \"{}\".", package.filename, reason);
+    }
 
-        logi("Retrying to sync packages, attempt {}", attempt + 1);
+    // The next sync has to fetch the database again to retry these
+    if (!failed.empty()) {
+        forget_upstream_state(section_name);
     }
 
-    co_return packages;
+    if (m_options.quarantine_after > 0) {
+        co_await update_quarantine(section_name, quarantine, packages, failed);
+    }
+
+    auto const section_entity = SectionDTOMapper::to_entity(section);
+    std::vector<Package::TId> removed;
+    removed.reserve(diff->removed.size());
+    for (auto& name : diff->removed) {
+        logi("Package {} is no longer in {}, removing it from the sync pool", name,
+             section_name);
+        removed.emplace_back(section_entity, std::move(name));
+    }
+
+    co_return SectionChanges {.packages = std::move(packages), .removed = std::move(removed)};
 }
 
 std::optional<ArchRepoSyncService::PackageInfo> parse_descfile(auto& entry) {
@@ -203,7 +573,7 @@ std::optional<ArchRepoSyncService::PackageInfo> parse_descfile(auto& entry) {
         return {};
     }
 
-    Utilities::AlpmDb::Desc desc({contents->begin(), contents->end()});
+    Utilities::AlpmDb::Desc const desc({contents->begin(), contents->end()});
 
     auto const filename = desc.get("FILENAME");
     if (!filename.has_value()) {
@@ -233,22 +603,27 @@ std::optional<ArchRepoSyncService::PackageInfo> parse_descfile(auto& entry) {
         return {};
     }
 
-    auto signature = desc.get("PGPSIG");
+    std::size_t size = 0;
+    if (auto const csize = desc.get("CSIZE"); csize.has_value()) {
+        std::from_chars(csize->data(), csize->data() + csize->size(), size);
+    }
+
+    std::optional<std::string> signature;
 
-    if (signature.has_value()) {
-        signature = bxt::Utilities::b64_decode(*signature);
+    if (auto const encoded_signature = desc.get("PGPSIG"); encoded_signature.has_value()) {
+        signature = bxt::Utilities::b64_decode(*encoded_signature);
     }
 
-    return ArchRepoSyncService::PackageInfo {.name = *name,
-                                             .filename = *filename,
+    return ArchRepoSyncService::PackageInfo {.name = std::string(*name),
+                                             .filename = std::string(*filename),
                                              .version = *version,
-                                             .hash = *hash,
-                                             .signature = signature};
+                                             .hash = std::string(*hash),
+                                             .signature = std::move(signature),
+                                             .size = size};
 }
-coro::task<ArchRepoSyncService::Result<std::vector<ArchRepoSyncService::PackageInfo>>>
-    ArchRepoSyncService::get_available_packages(PackageSectionDTO const section) {
-    std::vector<PackageInfo> result;
-
+coro::task<ArchRepoSyncService::Result<ArchRepoSyncService::UpstreamDiff>>
+    ArchRepoSyncService::get_available_packages(PackageSectionDTO const section,
+                                                PackageHandler const on_outdated) {
     auto const repository_name = m_options.sources[section].repo_name.value_or(section.repository);
 
     auto const db_path_format =
@@ -258,7 +633,151 @@ coro::task<ArchRepoSyncService::Result<std::vector<ArchRepoSyncService::PackageI
                                   fmt::arg("repository", repository_name),
                                   fmt::arg("architecture", section.architecture));
 
-    auto download_result = co_await download_file(m_options.sources[section].repo_url, path);
+    auto const repo_urls = m_options.sources[section].repo_urls;
+    auto const state_key = bxt::to_string(section);
+    auto const database_url = [&path](std::string const& mirror) {
+        return fmt::format("{}{}", HttpClientPool::normalize(mirror), path);
+    };
+
+    if (repo_urls.size() > 1) {
+        co_await probe_mirrors(repo_urls, path);
+    }
+    auto mirrors = m_mirror_ranking.rank(repo_urls);
+
+    // Conditional request against the validators of the last synced
+    // database. Those only mean something to the mirror that served it, so
+    // it is asked first as long as it is healthy.
+    httplib::Headers headers;
+    auto const known_state = co_await load_upstream_state(state_key);
+    auto const validated_by =
+        known_state.has_value()
+            ? std::ranges::find_if(mirrors,
+                                   [&](auto const& mirror) {
+                                       return database_url(mirror) == known_state->url
+                                              && m_mirror_ranking.mirror(mirror).healthy;
+                                   })
+            : mirrors.end();
+    if (validated_by != mirrors.end()) {
+        std::ranges::rotate(mirrors.begin(), validated_by, validated_by + 1);
+
+        if (!known_state->etag.empty()) {
+            headers.emplace("If-None-Match", known_state->etag);
+        }
+        if (!known_state->last_modified.empty()) {
+            headers.emplace("If-Modified-Since", known_state->last_modified);
+        }
+    }
+
+    // One snapshot of the local versions, read up front so every package can
+    // be compared as soon as its desc arrives
+    PackageRepositoryBase::VersionSnapshot local;
+    {
+        auto uow = co_await m_uow_factory();
+        auto versions = co_await m_package_repository.find_versions_by_section_async(
+            SectionDTOMapper::to_entity(section), uow);
+        if (!versions.has_value()) {
+            co_return bxt::make_error_with_source<DownloadError>(
+                std::move(versions.error()), path, "Can't read the local versions");
+        }
+        local = std::move(*versions);
+    }
+
+    Archive::PushSource source;
+    auto digest = Utilities::Digest::sha256();
+
+    // Everything upstream lists, excluded packages included: those are
+    // kept as they are rather than removed
+    std::vector<std::string> upstream_names;
+
+    // Runs on a thread of its own, blocking on the source for the whole
+    // transfer. The hashing pool is kept for CPU bound work.
+    auto const parse = [&]() -> Result<std::size_t> {
+        // Nothing arrives for a 304 or a failed request
+        if (!source.wait()) {
+            return 0;
+        }
+
+        Archive::Reader reader;
+
+        archive_read_support_filter_all(reader);
+        archive_read_support_format_all(reader);
+
+        auto open_ok = reader.open_source([&source] { return source.read(); });
+
+        if (!open_ok.has_value()) {
+            source.close();
+            return bxt::make_error_with_source<DownloadError>(std::move(open_ok.error()), path,
+                                                              "The archive cannot be opened");
+        }
+
+        auto const& exclusions = m_options.sources.at(section).exclusions;
+        ExclusionMatcher::Stats exclusion_stats;
+
+        std::size_t outdated_count = 0;
+        for (auto& [header, entry] : reader) {
+            std::string pname = archive_entry_pathname(*header);
+
+            if (!pname.ends_with("/desc")) {
+                continue;
+            }
+
+            auto parsed_package_info = parse_descfile(entry);
+
+            if (!parsed_package_info.has_value()) {
+                source.close();
+                return bxt::make_error<DownloadError>(
+                    "Unknown", fmt::format("Cannot parse descfile {}", pname));
+            }
+
+            upstream_names.emplace_back(parsed_package_info->name);
+
+            auto const exclusion = exclusions.match(parsed_package_info->name);
+            exclusion_stats.count(exclusion);
+            if (exclusion != ExclusionMatcher::Match::None) {
+                logi("Package {} is excluded. Skipping.", parsed_package_info->name);
+                continue;
+            }
+
+            if (!is_outdated(*parsed_package_info, local)) {
+                continue;
+            }
+
+            ++outdated_count;
+            on_outdated(std::move(*parsed_package_info));
+        }
+
+        // A truncated database, e.g. of a mirror in the middle of an update,
+        // lists only part of the packages. The missing ones aren't removed.
+        if (auto finished = reader.finished(); !finished.has_value()) {
+            source.close();
+            return bxt::make_error_with_source<DownloadError>(std::move(finished.error()), path,
+                                                              "The database is incomplete");
+        }
+
+        if (exclusions.size() > 0) {
+            logi("Section {}: {} of {} packages excluded by {} patterns ({} by name, {} by "
+                 "prefix, {} by expression)",
+                 bxt::to_string(section), exclusion_stats.excluded(), exclusion_stats.checked,
+                 exclusions.size(), exclusion_stats.literal, exclusion_stats.prefix,
+                 exclusion_stats.pattern);
+        }
+
+        // Let the transfer complete, the archive may end before the body does
+        while (auto const block = source.read()) {
+            if (block->empty()) {
+                break;
+            }
+        }
+
+        return outdated_count;
+    };
+
+    auto results = co_await coro::when_all(
+        stream_file(std::move(mirrors), path, std::move(headers), source, digest),
+        run_on_thread(tp, parse));
+
+    auto& [served_by, download_result] = std::get<0>(results).return_value();
+    auto& outdated_count = std::get<1>(results).return_value();
 
     if (!download_result.has_value()) {
         co_return bxt::make_error<DownloadError>(path, "Can't download the database");
@@ -268,64 +787,84 @@ coro::task<ArchRepoSyncService::Result<std::vector<ArchRepoSyncService::PackageI
                                                  httplib::to_string(download_result->error()));
     }
 
-    auto response = download_result->value();
+    auto const& response = download_result->value();
+
+    if (response.status == httplib::StatusCode::NotModified_304) {
+        logi("Database {} is not modified, skipping the section", database_url(served_by));
+        co_return UpstreamDiff {};
+    }
 
     if (response.status != 200) {
         co_return bxt::make_error<DownloadError>(path, "The response is non-200");
     }
 
-    Archive::Reader reader;
-
-    archive_read_support_filter_all(reader);
-    archive_read_support_format_all(reader);
+    if (!outdated_count.has_value()) {
+        co_return std::unexpected(std::move(outdated_count.error()));
+    }
 
-    auto open_ok =
-        reader.open_memory(reinterpret_cast<uint8_t*>(response.body.data()), response.body.size());
+    UpstreamState state {.url = database_url(served_by),
+                         .etag = response.get_header_value("ETag"),
+                         .last_modified = response.get_header_value("Last-Modified"),
+                         .sha256 = digest.hex_digest()};
 
-    if (!open_ok.has_value()) {
-        co_return bxt::make_error_with_source<DownloadError>(std::move(open_ok.error()), path,
-                                                             "The archive cannot be opened");
+    // Some mirrors don't send validators, or rewrite them on every request.
+    // An unchanged database yields no outdated packages besides the ones
+    // missing locally.
+    if (known_state.has_value() && known_state->sha256 == state.sha256) {
+        logi("Database {} is unchanged", state.url);
     }
-    auto uow = co_await m_uow_factory();
-    for (auto& [header, entry] : reader) {
-        std::string pname = archive_entry_pathname(*header);
+    remember_upstream_state(state_key, std::move(state));
 
-        if (!pname.ends_with("/desc")) {
-            continue;
+    UpstreamDiff diff {.outdated = *outdated_count};
+
+    // An empty database is more likely a broken mirror than a repository
+    // that lost all of its packages
+    if (upstream_names.empty()) {
+        if (std::ranges::any_of(local, &PackageRepositoryBase::VersionEntry::synced)) {
+            logw("Database {} lists no packages, keeping the synced ones", path);
         }
+        co_return diff;
+    }
 
-        auto parsed_package_info = parse_descfile(entry);
+    diff.removed = find_removed(std::move(upstream_names), local);
 
-        if (!parsed_package_info.has_value()) {
-            co_return bxt::make_error<DownloadError>(
-                "Unknown", fmt::format("Cannot parse descfile {}", pname));
-        }
+    co_return diff;
+}
 
-        auto const& [name, filename, version, hash, signature] = *parsed_package_info;
+bool ArchRepoSyncService::is_outdated(PackageInfo const& package,
+                                      PackageRepositoryBase::VersionSnapshot const& local) {
+    using Entry = PackageRepositoryBase::VersionEntry;
+    auto const it = std::ranges::lower_bound(local, package.name, {}, &Entry::name);
 
-        if (is_excluded(section, name)) {
-            logi("Package {} is excluded. Skipping.", name);
-            continue;
+    return it == local.end() || it->name != package.name || it->version < package.version;
+}
+
+std::vector<std::string>
+    ArchRepoSyncService::find_removed(std::vector<std::string> upstream,
+                                      PackageRepositoryBase::VersionSnapshot const& local) {
+    std::ranges::sort(upstream);
+
+    std::vector<std::string> removed;
+    auto upstream_it = upstream.begin();
+    for (auto const& entry : local) {
+        while (upstream_it != upstream.end() && *upstream_it < entry.name) {
+            ++upstream_it;
         }
 
-        auto const existing_package = co_await m_package_repository.find_by_section_async(
-            SectionDTOMapper::to_entity(section), name, uow);
-        if (existing_package.has_value()) {
-            if (existing_package->version() < version) {
-                result.emplace_back(std::move(*parsed_package_info));
-            }
-        } else {
-            result.emplace_back(std::move(*parsed_package_info));
+        if (entry.synced && (upstream_it == upstream.end() || *upstream_it != entry.name)) {
+            removed.emplace_back(entry.name);
         }
     }
-    co_return result;
+
+    return removed;
 }
 
 coro::task<ArchRepoSyncService::Result<Package>>
     ArchRepoSyncService::download_package(PackageSectionDTO section,
-                                          std::string package_filename,
-                                          std::string sha256_hash,
-                                          std::optional<std::string> signature) {
+                                          PackageInfo package_info,
+                                          DownloadScheduler::Priority priority) {
+    auto const& [name, package_filename, version, sha256_hash, signature, size] = package_info;
+
     auto const repository_name = m_options.sources[section].repo_name.value_or(section.repository);
 
     auto const path_format =
@@ -346,42 +885,46 @@ coro::task<ArchRepoSyncService::Result<Package>>
 
     auto const full_filename = fmt::format("{}/{}", filepath.string(), package_filename);
 
+    // Consecutive packages start on different mirrors, failed attempts fall
+    // over to the next one
+    auto const mirrors =
+        m_mirror_ranking.candidates(m_options.sources[section].repo_urls, m_stripe++);
+
     if (std::filesystem::exists(full_filename)) {
         logi("Found package file in local cache: {}, checking the hash... ", full_filename);
 
-        if (bxt::hash_from_file<SHA256, SHA256_DIGEST_LENGTH>(full_filename) == sha256_hash) {
+        // Files verified before are only hashed again if they changed since
+        auto const cached_hash = co_await m_verified_cache.sha256(full_filename);
+        if (cached_hash.has_value() && *cached_hash == sha256_hash) {
             logi("Hash is ok. Using local cache package file: {}", full_filename);
         } else {
             logw("Hash is wrong. Invalid package file: {}, removing it", full_filename);
             std::filesystem::remove(full_filename);
+            m_verified_cache.forget(full_filename);
         }
     }
     if (!std::filesystem::exists(full_filename)) {
-        auto response =
-            co_await download_file(m_options.sources[section].repo_url, path, full_filename);
+        auto downloaded =
+            co_await download_to_file(mirrors, path, full_filename, sha256_hash, priority, size);
 
-        if (!response.has_value()) {
-            co_return bxt::make_error<DownloadError>(package_filename,
-                                                     "Can't download the package");
-        }
-        if (!(*response)) {
-            co_return bxt::make_error<DownloadError>(package_filename,
-                                                     httplib::to_string(response->error()));
+        if (!downloaded.has_value()) {
+            co_return bxt::make_error_with_source<DownloadError>(
+                std::move(downloaded.error()), package_filename, "Can't download the package");
         }
+
+        // Hashed while it arrived, forgotten again once it's in the pool
+        m_verified_cache.remember(full_filename, downloaded->sha256);
     }
     if (signature == std::nullopt) {
         logi("Signature was not found in downloaded database."
              "Trying to download it from the repository...");
-        auto response = co_await download_file(m_options.sources[section].repo_url, path + ".sig",
-                                               full_filename + ".sig");
+        auto downloaded =
+            co_await download_to_file(mirrors, path + ".sig", full_filename + ".sig", "", priority);
 
-        if (!response.has_value()) {
-            co_return bxt::make_error<DownloadError>(package_filename + ".sig",
-                                                     "Can't download the signature");
-        }
-        if (!(*response)) {
-            co_return bxt::make_error<DownloadError>(package_filename + ".sig",
-                                                     httplib::to_string(response->error()));
+        if (!downloaded.has_value()) {
+            co_return bxt::make_error_with_source<DownloadError>(
+                std::move(downloaded.error()), package_filename + ".sig",
+                "Can't download the signature");
         }
     } else {
         logi("Signature was found in downloaded database, writing it to file.");
@@ -397,8 +940,15 @@ coro::task<ArchRepoSyncService::Result<Package>>
         }
     }
 
-    auto result = Package::from_file_path(SectionDTOMapper::to_entity(section),
-                                          Core::Domain::PoolLocation::Sync, full_filename);
+    // Parsing decompresses and hashes the whole package, keep it off the
+    // network threads.
+    auto result = co_await m_hashing_service.offload([&section, &full_filename] {
+        return Package::from_file_path(SectionDTOMapper::to_entity(section),
+                                       Core::Domain::PoolLocation::Sync, full_filename);
+    });
+
+    // The package goes to the batch writer and LMDB from here
+    co_await tp->schedule();
 
     if (result.has_value()) {
         co_return result.value();
@@ -407,86 +957,306 @@ coro::task<ArchRepoSyncService::Result<Package>>
             std::move(result.error()), package_filename, "Can't parse the package");
     }
 }
-coro::task<std::optional<httplib::Result>>
-    ArchRepoSyncService::download_file(std::string url, std::string path, std::string filename) {
+namespace {
+    // Not Modified answers a conditional request, the body is empty
+    bool is_fetched(httplib::Response const& response) {
+        return response.status == httplib::StatusCode::OK_200
+               || response.status == httplib::StatusCode::NotModified_304;
+    }
+} // namespace
+
+coro::task<ArchRepoSyncService::StreamedFile>
+    ArchRepoSyncService::stream_file(std::vector<std::string> mirrors,
+                                     std::string path,
+                                     httplib::Headers headers,
+                                     Archive::PushSource& source,
+                                     Utilities::Digest& digest) {
     using namespace std::chrono_literals;
     constexpr int retry_max = 5;
     constexpr auto delay = 50ms;
 
-    int current_retry = 0;
+    StreamedFile result;
+    bool streamed = false;
+
+    for (int current_retry = 0; current_retry < retry_max && !mirrors.empty(); ++current_retry) {
+        // Failed attempts move on to the next mirror
+        auto const& url = mirrors[current_retry % mirrors.size()];
+        result.mirror = url;
+        {
+            // Holds the download and connection slots only while the request
+            // is in flight
+            DownloadScheduler::Request const request {
+                .mirror = url, .priority = DownloadScheduler::Priority::Database};
+            auto ticket = co_await m_download_scheduler.acquire(request);
+            auto client = co_await m_client_pool.acquire(url);
+            co_await tp->schedule();
+
+            auto const started = MirrorRanking::Clock::now();
+            bool accepted = false;
+            result.response = client->Get(
+                path, url == mirrors.front() ? headers : httplib::Headers {},
+                [&](httplib::Response const& head) {
+                    if (is_fetched(head)) {
+                        m_mirror_ranking.record_latency(url,
+                                                        MirrorRanking::Clock::now() - started);
+                    }
+                    accepted = head.status == httplib::StatusCode::OK_200;
+                    return true;
+                },
+                [&](char const* data, std::size_t data_length) {
+                    if (!accepted) {
+                        return true;
+                    }
+                    streamed = true;
+                    ticket.add_received(data_length);
+                    digest.update(data, data_length);
+
+                    // Fails once the parser gave up
+                    return source.write(reinterpret_cast<uint8_t const*>(data), data_length);
+                });
+
+            if (result.response && *result.response && is_fetched(result.response->value())) {
+                ticket.succeed();
+            }
+        }
+
+        auto const& response = result.response;
+        if (response && response->error() == httplib::Error::Success
+            && is_fetched(response->value())) {
+            logi("Successfully downloaded file: {}{}", url, path);
+            break;
+        }
+
+        m_mirror_ranking.record_failure(url);
 
-    std::optional<httplib::Result> response;
+        if (streamed) {
+            loge("Transfer of {}{} was interrupted", url, path);
+            break;
+        }
 
-    while (current_retry < retry_max) {
-        auto client = co_await get_client(url);
-        if (!client) {
-            loge("Failed to get client for URL: {}", url);
-            co_return {};
+        logw("Failed to download file: {}{}, retrying...", url, path);
+        // Back off only before asking the same mirrors again
+        if ((current_retry + 1) % mirrors.size() == 0) {
+            co_await tp->yield_for(delay);
         }
+    }
 
-        if (!filename.empty()) {
-            std::ofstream stream(filename, std::ios::binary);
-            if (!stream.is_open()) {
-                loge("Failed to open file: {}", filename);
-                co_return {};
-            }
+    auto const& response = result.response;
+    source.finish(response && response->error() == httplib::Error::Success
+                  && response->value().status == httplib::StatusCode::OK_200);
 
-            response = client->Get(path, [&](char const* data, size_t data_length) {
-                stream.write(data, static_cast<std::streamsize>(data_length));
-                return stream.good();
-            });
+    co_return result;
+}
 
-            stream.close();
+coro::task<std::expected<ResumableDownload, ResumableDownloadError>>
+    ArchRepoSyncService::download_to_file(std::vector<std::string> mirrors,
+                                          std::string path,
+                                          std::filesystem::path target,
+                                          std::string sha256,
+                                          DownloadScheduler::Priority priority,
+                                          std::size_t size) {
+    using namespace std::chrono_literals;
+    constexpr int retry_max = 5;
+    constexpr auto delay = 50ms;
+
+    std::expected<ResumableDownload, ResumableDownloadError> result =
+        bxt::make_error<ResumableDownloadError>(ResumableDownloadError::ErrorType::NetworkError,
+                                                "No mirrors configured");
+
+    for (int current_retry = 0; current_retry < retry_max && !mirrors.empty(); ++current_retry) {
+        // A part left by a failed mirror is continued on the next one, the
+        // checksum guards against mirrors serving different files
+        auto const& url = mirrors[current_retry % mirrors.size()];
+        {
+            DownloadScheduler::Request const request {
+                .mirror = url, .priority = priority, .size = size};
+            auto ticket = co_await m_download_scheduler.acquire(request);
+            auto client = co_await m_client_pool.acquire(url);
+            co_await tp->schedule();
+
+            auto const started = MirrorRanking::Clock::now();
+            result = download_resumable(*client, path, target, sha256, [&ticket](auto bytes) {
+                ticket.add_received(bytes);
+            });
 
-            if (!stream) {
-                loge("Failed to write to file: {}", filename);
-                co_return {};
+            if (result.has_value()) {
+                m_mirror_ranking.record_transfer(url, result->received,
+                                                 MirrorRanking::Clock::now() - started);
+                ticket.succeed();
+            } else {
+                m_mirror_ranking.record_failure(url);
             }
-        } else {
-            response = client->Get(path, httplib::Headers());
         }
 
-        if (response && response->error() == httplib::Error::Success
-            && response->value().status == 200) {
-            logi("Successfully downloaded file: {}", path);
-            co_return response;
+        if (result.has_value()) {
+            if (result->resumed_from > 0) {
+                logi("Successfully downloaded file: {}{} (resumed at {} bytes)", url, path,
+                     result->resumed_from);
+            } else {
+                logi("Successfully downloaded file: {}{}", url, path);
+            }
+            co_return result;
         }
 
-        logw("Failed to download file: {}, retrying...", path);
-        co_await tp->yield_for(delay);
-        ++current_retry;
+        logw("Failed to download file: {}{} ({}), retrying...", url, path,
+             result.error().what());
+        if ((current_retry + 1) % mirrors.size() == 0) {
+            co_await tp->yield_for(delay);
+        }
     }
 
     loge("Failed to download file: {} after {} retries", path, retry_max);
-    co_return response;
+    co_return result;
 }
 
-bool ArchRepoSyncService::is_excluded(PackageSectionDTO const& section,
-                                      std::string const& package_name) const {
-    auto const& exclude_list = m_options.sources.at(section).exclude_list;
-    for (auto const& pattern : exclude_list) {
-        if (std::regex_match(package_name, std::regex(pattern))) {
-            return true;
+coro::task<void> ArchRepoSyncService::probe_mirrors(std::vector<std::string> const mirrors,
+                                                    std::string const path) {
+    auto probe = [this, &path](std::string url) -> coro::task<void> {
+        auto client = co_await m_client_pool.acquire(url);
+        co_await tp->schedule();
+
+        auto const started = MirrorRanking::Clock::now();
+        auto const response = client->Head(path);
+
+        if (response && response->status < httplib::StatusCode::BadRequest_400) {
+            m_mirror_ranking.record_latency(url, MirrorRanking::Clock::now() - started);
+        } else {
+            logw("Mirror {} failed the probe for {}", url, path);
+            m_mirror_ranking.record_failure(url);
         }
+    };
+
+    co_await coro::when_all(mirrors | std::views::transform(probe)
+                            | std::ranges::to<std::vector>());
+}
+
+coro::task<std::optional<UpstreamState>>
+    ArchRepoSyncService::load_upstream_state(std::string const key) {
+    auto const uow =
+        std::dynamic_pointer_cast<Persistence::LmdbUnitOfWork>(co_await m_uow_factory());
+    if (!uow) {
+        co_return std::nullopt;
+    }
+
+    auto state = co_await m_upstream_states.get(uow->txn().value, key);
+    if (!state.has_value()) {
+        co_return std::nullopt;
     }
 
-    return false;
+    co_return std::move(*state);
 }
 
-coro::task<std::unique_ptr<httplib::SSLClient>>
-    ArchRepoSyncService::get_client(std::string const url) {
-    using namespace std::chrono_literals;
-    constexpr static auto timeout = 5s;
+void ArchRepoSyncService::remember_upstream_state(std::string const& key, UpstreamState state) {
+    std::lock_guard lock(m_pending_states_mutex);
+    m_pending_states.insert_or_assign(key, std::move(state));
+}
 
-    co_await tp->schedule();
+coro::task<std::expected<void, DatabaseError>>
+    ArchRepoSyncService::save_upstream_states(std::shared_ptr<UnitOfWorkBase> uow,
+                                              std::vector<std::string> const& keys) {
+    auto const lmdb_uow = std::dynamic_pointer_cast<Persistence::LmdbUnitOfWork>(uow);
+    if (!lmdb_uow) {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
 
-    auto client_ptr = std::make_unique<httplib::SSLClient>(url);
+    std::vector<std::pair<std::string, UpstreamState>> states;
+    {
+        std::lock_guard lock(m_pending_states_mutex);
+        for (auto const& key : keys) {
+            if (auto const it = m_pending_states.find(key); it != m_pending_states.end()) {
+                states.emplace_back(it->first, std::move(it->second));
+                m_pending_states.erase(it);
+            }
+        }
+    }
 
-    client_ptr->set_follow_location(true);
-    client_ptr->enable_server_certificate_verification(true);
-    client_ptr->set_connection_timeout(timeout);
+    for (auto const& [state_key, state] : states) {
+        auto put_ok = co_await m_upstream_states.put(lmdb_uow->txn().value, state_key, state);
+        if (!put_ok.has_value()) {
+            co_return std::unexpected(std::move(put_ok.error()));
+        }
+    }
 
-    co_return client_ptr;
+    co_return {};
+}
+
+void ArchRepoSyncService::forget_upstream_state(std::string const& key) {
+    std::lock_guard lock(m_pending_states_mutex);
+    m_pending_states.erase(key);
+}
+
+coro::task<ArchRepoSyncService::Quarantine>
+    ArchRepoSyncService::load_quarantine(std::string const section_name) {
+    Quarantine result;
+    if (m_options.quarantine_after == 0) {
+        co_return result;
+    }
+
+    auto const uow =
+        std::dynamic_pointer_cast<Persistence::LmdbUnitOfWork>(co_await m_uow_factory());
+    if (!uow) {
+        co_return result;
+    }
+
+    auto const prefix = fmt::format("{}/", section_name);
+    auto const visited = co_await m_quarantine.accept(
+        uow->txn().value,
+        [&](std::string_view key, QuarantineEntry const& entry) {
+            result.emplace(key.substr(prefix.size()), entry);
+            return Utilities::NavigationAction::Next;
+        },
+        prefix);
+
+    if (!visited.has_value()) {
+        logw("Can't read the quarantine of {}: {}", section_name, visited.error().what());
+    }
+
+    co_return result;
+}
+
+coro::task<void> ArchRepoSyncService::update_quarantine(std::string const section_name,
+                                                        Quarantine const& quarantine,
+                                                        std::vector<Package> const& downloaded,
+                                                        std::vector<FailedDownload> const& failed) {
+    auto const uow =
+        std::dynamic_pointer_cast<Persistence::LmdbUnitOfWork>(co_await m_uow_factory(true));
+    if (!uow) {
+        co_return;
+    }
+
+    // A successful download ends the package's streak
+    for (auto const& package : downloaded) {
+        if (quarantine.contains(package.name())) {
+            co_await m_quarantine.del(uow->txn().value,
+                                      fmt::format("{}/{}", section_name, package.name()));
+        }
+    }
+
+    for (auto const& [package, reason] : failed) {
+        QuarantineEntry entry {.version = package.version.string(), .reason = reason};
+
+        // A new upstream version starts over
+        if (auto const it = quarantine.find(package.name);
+            it != quarantine.end() && it->second.version == entry.version) {
+            entry.failures = it->second.failures;
+        }
+        if (++entry.failures == m_options.quarantine_after) {
+            logw("Package {} {} failed in {} syncs and is quarantined", package.name,
+                 entry.version, entry.failures);
+        }
+
+        auto const put_ok = co_await m_quarantine.put(
+            uow->txn().value, fmt::format("{}/{}", section_name, package.name), entry);
+        if (!put_ok.has_value()) {
+            // The other packages are still counted
+            loge("Can't update the quarantine of {}: {}", package.name, put_ok.error().what());
+            continue;
+        }
+    }
+
+    if (auto const committed = co_await uow->commit_async(); !committed.has_value()) {
+        loge("Can't save the quarantine of {}: {}", section_name, committed.error().what());
+    }
 }
 
 } // namespace bxt::Infrastructure
@@ -12,13 +12,36 @@
 #include "core/domain/entities/Package.h"
 #include "core/domain/repositories/PackageRepositoryBase.h"
 #include "core/domain/repositories/UnitOfWorkBase.h"
+#include "infrastructure/HashingService.h"
+#include "infrastructure/alpm/BatchWriter.h"
+#include "infrastructure/alpm/DownloadScheduler.h"
+#include "infrastructure/alpm/HttpClientPool.h"
+#include "infrastructure/alpm/MirrorRanking.h"
+#include "infrastructure/alpm/QuarantineEntry.h"
+#include "infrastructure/alpm/ResumableDownload.h"
+#include "infrastructure/alpm/UpstreamState.h"
+#include "infrastructure/alpm/VerifiedCache.h"
+#include "utilities/Digest.h"
 #include "utilities/Error.h"
+#include "utilities/errors/DatabaseError.h"
 #include "utilities/eventbus/EventBusDispatcher.h"
+#include "utilities/libarchive/PushSource.h"
+#include "utilities/lmdb/Database.h"
+#include "utilities/lmdb/Environment.h"
 
+#include <algorithm>
+#include <atomic>
 #include <boost/uuid/uuid.hpp>
 #include <coro/io_scheduler.hpp>
 #include <coro/thread_pool.hpp>
+#include <expected>
+#include <filesystem>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <parallel_hashmap/phmap.h>
+#include <string>
 #include <vector>
 
 #define CPPHTTPLIB_OPENSSL_SUPPORT
@@ -44,49 +67,206 @@ public:
         Core::Domain::PackageVersion version;
         std::string hash;
         std::optional<std::string> signature;
+        // Compressed size, zero if the database doesn't list it
+        std::size_t size = 0;
     };
 
+    struct FailedDownload {
+        PackageInfo package;
+        std::string reason;
+    };
+
+    // Receives the packages to download, from the parsing thread while the
+    // database is still arriving
+    using PackageHandler = std::function<void(PackageInfo)>;
+
     ArchRepoSyncService(Utilities::EventBusDispatcher& dispatcher,
                         PackageRepositoryBase& package_repository,
                         ArchRepoOptions& options,
-                        UnitOfWorkBaseFactory& uow_factory)
+                        UnitOfWorkBaseFactory& uow_factory,
+                        HashingService& hashing_service,
+                        std::shared_ptr<Utilities::LMDB::Environment> env)
         : m_dispatcher(dispatcher)
         , m_package_repository(package_repository)
+        , m_uow_factory(uow_factory)
+        , m_hashing_service(hashing_service)
         , m_options(options)
-        , m_uow_factory(uow_factory) {
+        , m_client_pool({.max_connections_per_host = options.max_connections_per_host})
+        , m_download_scheduler({.max_concurrent_downloads = options.max_concurrent_downloads,
+                                .max_downloads_per_mirror = options.max_connections_per_host})
+        , m_mirror_ranking({})
+        , tp(coro::io_scheduler::make_shared(
+              {.pool = {.thread_count = static_cast<uint32_t>(
+                            std::max<std::size_t>(1, options.max_concurrent_downloads))}}))
+        , m_upstream_states(env, "bxt::UpstreamStates")
+        , m_quarantine(env, "bxt::SyncQuarantine")
+        , m_verified_cache({.max_age = options.cache_scrub_age,
+                            .interval = options.cache_scrub_interval},
+                           env,
+                           uow_factory,
+                           hashing_service,
+                           tp) {
     }
 
+    // Starts the background work that outlives single syncs
+    void start();
+
+    // Name the sync log shows for syncs nobody requested
+    static constexpr char ScheduledSyncUser[] = "scheduler";
+
+    // Sync of the scheduler: no events unless something changed. Returns
+    // whether it did.
+    coro::task<SyncService::Result<bool>> sync_scheduled(PackageSectionDTO const section);
+
     coro::task<SyncService::Result<void>> sync(PackageSectionDTO const section,
                                                RequestContext const context) override;
     coro::task<SyncService::Result<void>> sync_all(RequestContext const context) override;
 
+    // Whether the package is missing from `local` (sorted by name) or newer
+    // than there
+    static bool is_outdated(PackageInfo const& package,
+                            PackageRepositoryBase::VersionSnapshot const& local);
+
+    // Synced packages of `local` (sorted by name) that `upstream` doesn't
+    // list anymore, found by merging both in name order
+    static std::vector<std::string>
+        find_removed(std::vector<std::string> upstream,
+                     PackageRepositoryBase::VersionSnapshot const& local);
+
 protected:
-    coro::task<SyncService::Result<std::vector<Package>>>
-        sync_section(PackageSectionDTO const section);
+    // Downloaded packages are written while the sync goes on, in batches of
+    // `commit_batch_size` packages per transaction
+    using PackageWriter = BatchWriter<Package, SyncError>;
+    PackageWriter::Options package_writer_options() const;
+    // Called for one batch at a time, `written` gets the committed packages
+    // without their descriptions
+    coro::task<SyncService::Result<void>> write_packages(std::vector<Package> batch,
+                                                         std::vector<Package>& written);
+
+    struct SectionChanges {
+        // Handed to the writer, kept without their descriptions for the
+        // sync log
+        std::vector<Package> packages;
+        // Packages to drop from the sync pool
+        std::vector<Package::TId> removed;
+        // Another run syncs the section, its upstream state isn't ours to
+        // save
+        bool skipped = false;
+    };
+
+    coro::task<SyncService::Result<SectionChanges>>
+        sync_section(PackageSectionDTO const section,
+                     DownloadScheduler::Priority priority,
+                     PackageWriter& writer);
+
+    // Runs the section's sync and saves all of its changes. `saved` gets the
+    // changes that reached the database, also when the sync fails.
+    coro::task<SyncService::Result<void>> sync_and_save(PackageSectionDTO const section,
+                                                        DownloadScheduler::Priority priority,
+                                                        SectionChanges& saved);
+
+    // Applies the removals in transactions of at most `commit_batch_size`
+    // packages. The upstream states of `state_keys` go with the last one, so
+    // an interrupted sync makes the next one fetch the databases again.
+    coro::task<SyncService::Result<void>>
+        save_changes(SectionChanges const& changes, std::vector<std::string> const& state_keys);
 
-    coro::task<Result<std::vector<PackageInfo>>>
-        get_available_packages(PackageSectionDTO const section);
-    coro::task<Result<Package>>
-        download_package(PackageSectionDTO section,
-                         std::string package_filename,
-                         std::string sha256_hash,
-                         std::optional<std::string> signature = std::nullopt);
+    struct UpstreamDiff {
+        // Packages handed to the handler
+        std::size_t outdated = 0;
+        // Names of synced packages upstream doesn't have anymore
+        std::vector<std::string> removed;
+    };
+
+    // Streams the section's database and hands every outdated package to
+    // `on_outdated` as soon as its desc is parsed
+    coro::task<Result<UpstreamDiff>> get_available_packages(PackageSectionDTO const section,
+                                                            PackageHandler const on_outdated);
+    coro::task<Result<Package>> download_package(PackageSectionDTO section,
+                                                 PackageInfo package_info,
+                                                 DownloadScheduler::Priority priority);
+
+    struct StreamedFile {
+        // The mirror of the last attempt
+        std::string mirror;
+        std::optional<httplib::Result> response;
+    };
+
+    // Pushes a 200 body into `source` and `digest` while it arrives, the
+    // source is finished in any case. Failed attempts go to the next mirror,
+    // but attempts that already pushed data can't be retried. `headers` are
+    // sent to the first mirror only.
+    coro::task<StreamedFile> stream_file(std::vector<std::string> mirrors,
+                                         std::string path,
+                                         httplib::Headers headers,
+                                         Archive::PushSource& source,
+                                         Utilities::Digest& digest);
+
+    // Fetches into `target` through a resumable part file, verifying `sha256`
+    // when it isn't empty. Failed attempts go to the next mirror.
+    coro::task<std::expected<ResumableDownload, ResumableDownloadError>>
+        download_to_file(std::vector<std::string> mirrors,
+                         std::string path,
+                         std::filesystem::path target,
+                         std::string sha256,
+                         DownloadScheduler::Priority priority,
+                         std::size_t size = 0);
+
+    // Measures the latency of every mirror with a HEAD request for `path`
+    coro::task<void> probe_mirrors(std::vector<std::string> const mirrors,
+                                   std::string const path);
 
-    coro::task<std::unique_ptr<httplib::SSLClient>> get_client(std::string const url);
+    coro::task<std::optional<UpstreamState>> load_upstream_state(std::string const key);
 
-    coro::task<std::optional<httplib::Result>>
-        download_file(std::string url, std::string path, std::string filename = "");
+    // Upstream states become visible only with the packages they describe:
+    // they are kept aside until the sync is saved.
+    void remember_upstream_state(std::string const& key, UpstreamState state);
+    coro::task<std::expected<void, DatabaseError>>
+        save_upstream_states(std::shared_ptr<UnitOfWorkBase> uow,
+                             std::vector<std::string> const& keys);
+    void forget_upstream_state(std::string const& key);
 
-    bool is_excluded(PackageSectionDTO const& section, std::string const& package_name) const;
+    // Quarantine entries of a section by package name, empty if the
+    // quarantine is disabled
+    using Quarantine = phmap::flat_hash_map<std::string, QuarantineEntry>;
+    coro::task<Quarantine> load_quarantine(std::string const section_name);
+    // Counts the failed packages and clears the downloaded ones, in a write
+    // transaction of its own
+    coro::task<void> update_quarantine(std::string const section_name,
+                                       Quarantine const& quarantine,
+                                       std::vector<Package> const& downloaded,
+                                       std::vector<FailedDownload> const& failed);
 
 private:
     Utilities::EventBusDispatcher& m_dispatcher;
     PackageRepositoryBase& m_package_repository;
     UnitOfWorkBaseFactory& m_uow_factory;
+    HashingService& m_hashing_service;
 
     ArchRepoOptions m_options;
-    std::shared_ptr<coro::io_scheduler> tp =
-        coro::io_scheduler::make_shared({.pool = {.thread_count = 4}});
+
+    // Shared by all sections, keyed by mirror
+    HttpClientPool m_client_pool;
+    DownloadScheduler m_download_scheduler;
+    MirrorRanking m_mirror_ranking;
+    // Spreads consecutive packages over the mirrors
+    std::atomic<std::size_t> m_stripe = 0;
+
+    // Requests block their thread, so there is one per admitted download
+    std::shared_ptr<coro::io_scheduler> tp;
+
+    // Keyed by section
+    Utilities::LMDB::Database<UpstreamState> m_upstream_states;
+    std::mutex m_pending_states_mutex;
+    phmap::flat_hash_map<std::string, UpstreamState> m_pending_states;
+
+    // Keyed by "section/package name"
+    Utilities::LMDB::Database<QuarantineEntry> m_quarantine;
+
+    VerifiedCache m_verified_cache;
+
+    std::mutex m_running_mutex;
+    phmap::flat_hash_set<std::string> m_running_sections;
 };
 
 } // namespace bxt::Infrastructure
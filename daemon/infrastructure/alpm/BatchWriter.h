@@ -0,0 +1,172 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <coro/semaphore.hpp>
+#include <coro/task.hpp>
+#include <cstddef>
+#include <expected>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace bxt::Infrastructure {
+
+// Last stage of a sync: items are queued and handed to the writer in
+// batches, one write transaction each, so the writer lock is taken briefly
+// and often. Producers wait while `capacity` items are queued or being
+// written, a slow database holds them back instead of piling items up.
+//
+// The producer that fills a batch writes it, batches are written one at a
+// time.
+template<typename T, typename TError> class BatchWriter {
+public:
+    using Writer = std::function<coro::task<std::expected<void, TError>>(std::vector<T>)>;
+
+    struct Options {
+        std::size_t batch_size = 256;
+        // Raised to the batch size if smaller, a batch has to fit
+        std::size_t capacity = 1024;
+    };
+
+    BatchWriter(Options options, Writer writer)
+        : m_batch_size(std::max<std::size_t>(1, options.batch_size))
+        , m_slots(static_cast<std::ptrdiff_t>(std::max(m_batch_size, options.capacity)))
+        , m_writer(std::move(writer)) {
+    }
+
+    BatchWriter(BatchWriter const&) = delete;
+    BatchWriter& operator=(BatchWriter const&) = delete;
+
+    // Returns false once a write has failed, the item is dropped then
+    coro::task<bool> push(T item) {
+        co_await m_slots.acquire();
+
+        std::optional<std::vector<T>> batch;
+        bool accepted = false;
+        {
+            std::lock_guard lock(m_mutex);
+            if (!m_error.has_value()) {
+                m_pending.emplace_back(std::move(item));
+                accepted = true;
+
+                if (!m_writing) {
+                    batch = take_batch();
+                    m_writing = batch.has_value();
+                }
+            }
+        }
+        if (!accepted) {
+            release(1);
+            co_return false;
+        }
+
+        while (batch.has_value()) {
+            auto freed = batch->size();
+            auto written = co_await m_writer(std::move(*batch));
+
+            {
+                std::lock_guard lock(m_mutex);
+                if (written.has_value()) {
+                    m_written += freed;
+                    ++m_batches;
+                } else if (!m_error.has_value()) {
+                    m_error = std::move(written.error());
+                    // Nothing is written after a failure, the queued items go
+                    freed += m_pending.size();
+                    m_pending.clear();
+                }
+
+                batch = m_error.has_value() ? std::nullopt : take_batch();
+                m_writing = batch.has_value();
+            }
+            release(freed);
+        }
+
+        co_return !failed();
+    }
+
+    // Writes the rest, once every push has returned
+    coro::task<std::expected<void, TError>> finish() {
+        std::vector<T> rest;
+        {
+            std::lock_guard lock(m_mutex);
+            if (m_error.has_value()) {
+                co_return std::unexpected(*m_error);
+            }
+            rest = std::exchange(m_pending, {});
+        }
+
+        if (rest.empty()) {
+            co_return {};
+        }
+
+        auto const size = rest.size();
+        auto written = co_await m_writer(std::move(rest));
+        release(size);
+
+        std::lock_guard lock(m_mutex);
+        if (!written.has_value()) {
+            m_error = written.error();
+            co_return std::unexpected(std::move(written.error()));
+        }
+
+        m_written += size;
+        ++m_batches;
+        co_return {};
+    }
+
+    bool failed() const {
+        std::lock_guard lock(m_mutex);
+        return m_error.has_value();
+    }
+    std::size_t written() const {
+        return m_written;
+    }
+    std::size_t batches() const {
+        return m_batches;
+    }
+
+private:
+    // Under the lock. Only the push that is writing takes batches, the
+    // others leave theirs to it.
+    std::optional<std::vector<T>> take_batch() {
+        if (m_pending.size() < m_batch_size) {
+            return std::nullopt;
+        }
+
+        std::vector<T> batch(std::make_move_iterator(m_pending.begin()),
+                             std::make_move_iterator(m_pending.begin() + m_batch_size));
+        m_pending.erase(m_pending.begin(), m_pending.begin() + m_batch_size);
+        return batch;
+    }
+
+    // Resumes waiting producers inline, never call it under the lock
+    void release(std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            m_slots.release();
+        }
+    }
+
+    std::size_t const m_batch_size;
+    coro::semaphore m_slots;
+    Writer m_writer;
+
+    mutable std::mutex m_mutex;
+    std::vector<T> m_pending;
+    bool m_writing = false;
+    std::optional<TError> m_error;
+
+    std::atomic<std::size_t> m_written = 0;
+    std::atomic<std::size_t> m_batches = 0;
+};
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,151 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "DownloadScheduler.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace bxt::Infrastructure {
+
+DownloadScheduler::Ticket::Ticket(DownloadScheduler& scheduler, Mirror& mirror)
+    : m_scheduler(&scheduler)
+    , m_mirror(&mirror) {
+}
+
+DownloadScheduler::Ticket::Ticket(Ticket&& other) noexcept
+    : m_scheduler(std::exchange(other.m_scheduler, nullptr))
+    , m_mirror(other.m_mirror)
+    , m_succeeded(other.m_succeeded) {
+}
+
+DownloadScheduler::Ticket::~Ticket() {
+    if (m_scheduler) {
+        m_scheduler->release(*m_mirror, m_succeeded);
+    }
+}
+
+void DownloadScheduler::Ticket::add_received(std::size_t bytes) {
+    m_scheduler->m_bytes_received += bytes;
+}
+
+bool DownloadScheduler::Awaiter::await_ready() {
+    return m_scheduler.try_admit(m_mirror);
+}
+
+bool DownloadScheduler::Awaiter::await_suspend(std::coroutine_handle<> handle) {
+    std::lock_guard lock(m_scheduler.m_mutex);
+
+    // A slot may have been freed since await_ready
+    if (m_scheduler.m_active < m_scheduler.m_options.max_concurrent_downloads
+        && m_mirror.active < m_scheduler.m_options.max_downloads_per_mirror) {
+        ++m_scheduler.m_active;
+        ++m_mirror.active;
+        --m_scheduler.m_progress.queued;
+        ++m_scheduler.m_progress.active;
+        return false;
+    }
+
+    m_mirror.waiters.emplace(Waiter {.priority = m_priority,
+                                     .size = m_size,
+                                     .sequence = m_scheduler.m_sequence++,
+                                     .handle = handle});
+    return true;
+}
+
+DownloadScheduler::Ticket DownloadScheduler::Awaiter::await_resume() {
+    return Ticket(m_scheduler, m_mirror);
+}
+
+DownloadScheduler::DownloadScheduler(Options options)
+    : m_options(std::move(options)) {
+    m_options.max_concurrent_downloads = std::max<std::size_t>(1,
+                                                               m_options.max_concurrent_downloads);
+    m_options.max_downloads_per_mirror = std::max<std::size_t>(1,
+                                                               m_options.max_downloads_per_mirror);
+}
+
+DownloadScheduler::Awaiter DownloadScheduler::acquire(Request request) {
+    std::lock_guard lock(m_mutex);
+
+    ++m_progress.queued;
+    m_progress.bytes_expected += request.size;
+
+    auto& mirror = m_mirrors[request.mirror];
+    if (!mirror) {
+        mirror = std::make_unique<Mirror>();
+    }
+
+    return Awaiter(*this, *mirror, request);
+}
+
+DownloadScheduler::Progress DownloadScheduler::progress() const {
+    std::lock_guard lock(m_mutex);
+
+    auto result = m_progress;
+    result.bytes_received = m_bytes_received;
+
+    return result;
+}
+
+bool DownloadScheduler::try_admit(Mirror& mirror) {
+    std::lock_guard lock(m_mutex);
+
+    if (m_active >= m_options.max_concurrent_downloads) {
+        return false;
+    }
+
+    if (mirror.active >= m_options.max_downloads_per_mirror) {
+        return false;
+    }
+
+    ++m_active;
+    ++mirror.active;
+    --m_progress.queued;
+    ++m_progress.active;
+
+    return true;
+}
+
+void DownloadScheduler::release(Mirror& released, bool succeeded) {
+    std::coroutine_handle<> next;
+    {
+        std::lock_guard lock(m_mutex);
+
+        --m_active;
+        --released.active;
+        --m_progress.active;
+        ++(succeeded ? m_progress.completed : m_progress.failed);
+
+        // Only one slot was freed, so at most one waiter can be admitted: the
+        // best head among the mirrors that are below their own limit.
+        Mirror* best = nullptr;
+        for (auto& [name, mirror] : m_mirrors) {
+            if (mirror->waiters.empty() || mirror->active >= m_options.max_downloads_per_mirror) {
+                continue;
+            }
+            if (!best || *mirror->waiters.begin() < *best->waiters.begin()) {
+                best = mirror.get();
+            }
+        }
+
+        if (best) {
+            next = best->waiters.begin()->handle;
+            best->waiters.erase(best->waiters.begin());
+
+            ++m_active;
+            ++best->active;
+            --m_progress.queued;
+            ++m_progress.active;
+        }
+    }
+
+    if (next) {
+        next.resume();
+    }
+}
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,148 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <parallel_hashmap/phmap.h>
+#include <set>
+#include <string>
+
+namespace bxt::Infrastructure {
+
+// Admits downloads under a global and a per-mirror concurrency limit. Waiting
+// downloads are started by priority, then smallest first, so the queue drains
+// predictably instead of in whatever order the tasks were created.
+class DownloadScheduler {
+    struct Mirror;
+
+public:
+    enum class Priority : uint8_t {
+        Normal,
+        // Sections synced on a user request
+        User,
+        // Databases gate the package downloads of their section
+        Database,
+    };
+
+    struct Options {
+        std::size_t max_concurrent_downloads = 8;
+        std::size_t max_downloads_per_mirror = 4;
+    };
+
+    struct Request {
+        std::string mirror;
+        Priority priority = Priority::Normal;
+        // Expected size in bytes, zero if unknown
+        std::size_t size = 0;
+    };
+
+    struct Progress {
+        std::size_t queued = 0;
+        std::size_t active = 0;
+        std::size_t completed = 0;
+        std::size_t failed = 0;
+        std::size_t bytes_expected = 0;
+        std::size_t bytes_received = 0;
+    };
+
+    // Admission of a single download, frees the slot when destroyed
+    class Ticket {
+    public:
+        Ticket(Ticket&& other) noexcept;
+        Ticket& operator=(Ticket&&) = delete;
+        ~Ticket();
+
+        void add_received(std::size_t bytes);
+
+        // Counts the download as completed rather than failed
+        void succeed() {
+            m_succeeded = true;
+        }
+
+    private:
+        friend class DownloadScheduler;
+
+        Ticket(DownloadScheduler& scheduler, Mirror& mirror);
+
+        DownloadScheduler* m_scheduler;
+        Mirror* m_mirror;
+        bool m_succeeded = false;
+    };
+
+    class Awaiter {
+    public:
+        bool await_ready();
+        bool await_suspend(std::coroutine_handle<> handle);
+        Ticket await_resume();
+
+    private:
+        friend class DownloadScheduler;
+
+        Awaiter(DownloadScheduler& scheduler, Mirror& mirror, Request const& request)
+            : m_scheduler(scheduler)
+            , m_mirror(mirror)
+            , m_priority(request.priority)
+            , m_size(request.size) {
+        }
+
+        DownloadScheduler& m_scheduler;
+        Mirror& m_mirror;
+        Priority m_priority;
+        std::size_t m_size;
+    };
+
+    explicit DownloadScheduler(Options options);
+
+    // co_await to wait for a slot, the resulting Ticket holds it
+    Awaiter acquire(Request request);
+
+    Progress progress() const;
+
+private:
+    struct Waiter {
+        Priority priority;
+        std::size_t size;
+        uint64_t sequence;
+        std::coroutine_handle<> handle;
+
+        bool operator<(Waiter const& other) const {
+            if (priority != other.priority) {
+                return priority > other.priority;
+            }
+            if (size != other.size) {
+                return size < other.size;
+            }
+            return sequence < other.sequence;
+        }
+    };
+
+    struct Mirror {
+        std::size_t active = 0;
+        std::set<Waiter> waiters;
+    };
+
+    bool try_admit(Mirror& mirror);
+    void release(Mirror& mirror, bool succeeded);
+
+    Options m_options;
+
+    mutable std::mutex m_mutex;
+    // Boxed, tickets and awaiters keep pointers to their mirror
+    phmap::flat_hash_map<std::string, std::unique_ptr<Mirror>> m_mirrors;
+    std::size_t m_active = 0;
+    uint64_t m_sequence = 0;
+
+    Progress m_progress;
+    std::atomic<std::size_t> m_bytes_received = 0;
+};
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,143 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "ExclusionMatcher.h"
+
+#include "utilities/log/Logging.h"
+
+#include <algorithm>
+#include <fmt/format.h>
+
+namespace bxt::Infrastructure {
+
+namespace {
+    constexpr std::string_view Metacharacters = R"(\^$.|?*+()[]{})";
+
+    bool is_literal(std::string_view pattern) {
+        return pattern.find_first_of(Metacharacters) == std::string_view::npos;
+    }
+
+    bool has_backreference(std::string_view pattern) {
+        for (std::size_t i = 0; i + 1 < pattern.size(); ++i) {
+            if (pattern[i] != '\\') {
+                continue;
+            }
+            if (pattern[i + 1] >= '1' && pattern[i + 1] <= '9') {
+                return true;
+            }
+            // Skip the escaped character
+            ++i;
+        }
+        return false;
+    }
+
+    // The whole name is matched anyway, so the anchors are redundant
+    std::string_view strip_anchors(std::string_view pattern) {
+        if (pattern.starts_with('^')) {
+            pattern.remove_prefix(1);
+        }
+        if (pattern.ends_with('$') && !pattern.ends_with("\\$")) {
+            pattern.remove_suffix(1);
+        }
+        return pattern;
+    }
+
+    constexpr auto Syntax = std::regex::ECMAScript | std::regex::optimize;
+} // namespace
+
+void ExclusionMatcher::Stats::count(Match match) {
+    ++checked;
+
+    switch (match) {
+    case Match::Literal:
+        ++literal;
+        break;
+    case Match::Prefix:
+        ++prefix;
+        break;
+    case Match::Pattern:
+        ++pattern;
+        break;
+    case Match::None:
+        break;
+    }
+}
+
+ExclusionMatcher::ExclusionMatcher(std::vector<std::string> const& patterns) {
+    for (auto const& pattern : patterns) {
+        add_pattern(pattern);
+    }
+
+    if (m_alternatives.empty()) {
+        return;
+    }
+
+    std::string combined;
+    for (auto const& alternative : m_alternatives) {
+        combined += fmt::format("{}(?:{})", combined.empty() ? "" : "|", alternative);
+    }
+    m_combined.emplace(combined, Syntax);
+}
+
+void ExclusionMatcher::add_pattern(std::string const& pattern) {
+    if (pattern.empty()) {
+        return;
+    }
+
+    auto const stripped = strip_anchors(pattern);
+
+    if (is_literal(stripped)) {
+        m_literals.emplace(stripped);
+        ++m_size;
+        return;
+    }
+
+    if (stripped.ends_with(".*") && is_literal(stripped.substr(0, stripped.size() - 2))) {
+        m_prefixes.emplace_back(stripped.substr(0, stripped.size() - 2));
+        ++m_size;
+        return;
+    }
+
+    // Compiled on its own first, so one invalid pattern doesn't break the
+    // combined expression
+    try {
+        std::regex compiled(pattern, Syntax);
+
+        if (has_backreference(pattern)) {
+            m_separate.emplace_back(std::move(compiled));
+        } else {
+            m_alternatives.emplace_back(pattern);
+        }
+        ++m_size;
+    } catch (std::regex_error const& error) {
+        logw("Exclusion pattern \"{}\" is invalid and is ignored: {}", pattern, error.what());
+    }
+}
+
+ExclusionMatcher::Match ExclusionMatcher::match(std::string_view name) const {
+    if (m_literals.contains(name)) {
+        return Match::Literal;
+    }
+
+    if (std::ranges::any_of(m_prefixes,
+                            [name](auto const& prefix) { return name.starts_with(prefix); })) {
+        return Match::Prefix;
+    }
+
+    if (m_combined.has_value() && std::regex_match(name.begin(), name.end(), *m_combined)) {
+        return Match::Pattern;
+    }
+
+    if (std::ranges::any_of(m_separate, [name](auto const& pattern) {
+            return std::regex_match(name.begin(), name.end(), pattern);
+        })) {
+        return Match::Pattern;
+    }
+
+    return Match::None;
+}
+
+} // namespace bxt::Infrastructure
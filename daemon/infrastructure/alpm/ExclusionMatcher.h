@@ -0,0 +1,64 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <parallel_hashmap/phmap.h>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bxt::Infrastructure {
+
+// Package name patterns of a sync source, compiled once. Patterns are
+// ECMAScript regular expressions matched against the whole name. Plain names
+// and "name.*" prefixes are answered from a hash set and a prefix list, all
+// other patterns share one combined expression.
+class ExclusionMatcher {
+public:
+    enum class Match { None, Literal, Prefix, Pattern };
+
+    // Per sync tally of the lookups, for logging
+    struct Stats {
+        void count(Match match);
+        std::size_t excluded() const {
+            return literal + prefix + pattern;
+        }
+
+        std::size_t checked = 0;
+        std::size_t literal = 0;
+        std::size_t prefix = 0;
+        std::size_t pattern = 0;
+    };
+
+    ExclusionMatcher() = default;
+    // Invalid patterns are logged and skipped
+    explicit ExclusionMatcher(std::vector<std::string> const& patterns);
+
+    Match match(std::string_view name) const;
+
+    std::size_t size() const {
+        return m_size;
+    }
+
+private:
+    void add_pattern(std::string const& pattern);
+
+    phmap::flat_hash_set<std::string> m_literals;
+    std::vector<std::string> m_prefixes;
+
+    std::vector<std::string> m_alternatives;
+    std::optional<std::regex> m_combined;
+    // Back-references are numbered per pattern, so those can't be combined
+    std::vector<std::regex> m_separate;
+
+    std::size_t m_size = 0;
+};
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,106 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "HttpClientPool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace bxt::Infrastructure {
+
+HttpClientPool::Lease::Lease(Host& host, std::unique_ptr<httplib::Client> client)
+    : m_host(&host)
+    , m_client(std::move(client)) {
+}
+
+HttpClientPool::Lease::Lease(Lease&& other) noexcept
+    : m_host(std::exchange(other.m_host, nullptr))
+    , m_client(std::move(other.m_client)) {
+}
+
+HttpClientPool::Lease::~Lease() {
+    if (!m_host) {
+        return;
+    }
+
+    {
+        std::lock_guard lock(m_host->mutex);
+        m_host->idle.emplace_back(std::move(m_client));
+    }
+
+    // Resumes the next waiter inline, so the host lock must be released first
+    m_host->slots.release();
+}
+
+HttpClientPool::HttpClientPool(Options options)
+    : m_options(std::move(options)) {
+    m_options.max_connections_per_host = std::max<std::size_t>(1,
+                                                               m_options.max_connections_per_host);
+}
+
+coro::task<HttpClientPool::Lease> HttpClientPool::acquire(std::string const url) {
+    auto const base_url = normalize(url);
+    auto& target = host(base_url);
+
+    co_await target.slots.acquire();
+
+    std::unique_ptr<httplib::Client> client;
+    {
+        std::lock_guard lock(target.mutex);
+        if (!target.idle.empty()) {
+            client = std::move(target.idle.back());
+            target.idle.pop_back();
+        }
+    }
+
+    if (client) {
+        ++m_reused;
+    } else {
+        client = make_client(base_url);
+        ++m_created;
+    }
+
+    co_return Lease(target, std::move(client));
+}
+
+HttpClientPool::Stats HttpClientPool::stats() const {
+    return {.created = m_created.load(), .reused = m_reused.load()};
+}
+
+std::string HttpClientPool::normalize(std::string const& url) {
+    auto base_url = url.contains("://") ? url : "https://" + url;
+
+    while (base_url.ends_with('/')) {
+        base_url.pop_back();
+    }
+
+    return base_url;
+}
+
+HttpClientPool::Host& HttpClientPool::host(std::string const& base_url) {
+    std::lock_guard lock(m_mutex);
+
+    auto& target = m_hosts[base_url];
+    if (!target) {
+        target = std::make_unique<Host>(m_options.max_connections_per_host);
+    }
+
+    return *target;
+}
+
+std::unique_ptr<httplib::Client> HttpClientPool::make_client(std::string const& base_url) const {
+    auto client = std::make_unique<httplib::Client>(base_url);
+
+    client->set_keep_alive(true);
+    client->set_follow_location(true);
+    client->enable_server_certificate_verification(true);
+    client->set_connection_timeout(m_options.connection_timeout);
+    client->set_read_timeout(m_options.read_timeout);
+
+    return client;
+}
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,99 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <coro/semaphore.hpp>
+#include <coro/task.hpp>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <parallel_hashmap/phmap.h>
+#include <string>
+#include <vector>
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include <httplib.h>
+
+namespace bxt::Infrastructure {
+
+// Keeps keep-alive clients per mirror, so consecutive downloads from the same
+// host reuse the connection (and the TLS session) instead of reconnecting.
+// The pool is shared by all sections syncing from the same mirror.
+class HttpClientPool {
+    struct Host;
+
+public:
+    struct Options {
+        std::size_t max_connections_per_host = 4;
+        std::chrono::seconds connection_timeout = std::chrono::seconds(5);
+        std::chrono::seconds read_timeout = std::chrono::seconds(60);
+    };
+
+    struct Stats {
+        std::size_t created = 0;
+        std::size_t reused = 0;
+    };
+
+    class Lease {
+    public:
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&&) = delete;
+        ~Lease();
+
+        httplib::Client* operator->() const {
+            return m_client.get();
+        }
+        httplib::Client& operator*() const {
+            return *m_client;
+        }
+
+    private:
+        friend class HttpClientPool;
+
+        Lease(Host& host, std::unique_ptr<httplib::Client> client);
+
+        Host* m_host;
+        std::unique_ptr<httplib::Client> m_client;
+    };
+
+    explicit HttpClientPool(Options options);
+
+    // Waits for a free slot of the host and hands out an idle client, or a
+    // new one if none is idle. URLs without a scheme are treated as https.
+    coro::task<Lease> acquire(std::string const url);
+
+    Stats stats() const;
+
+    static std::string normalize(std::string const& url);
+
+private:
+    struct Host {
+        explicit Host(std::size_t max_connections)
+            : slots(static_cast<std::ptrdiff_t>(max_connections)) {
+        }
+
+        coro::semaphore slots;
+
+        std::mutex mutex;
+        std::vector<std::unique_ptr<httplib::Client>> idle;
+    };
+
+    Host& host(std::string const& base_url);
+    std::unique_ptr<httplib::Client> make_client(std::string const& base_url) const;
+
+    Options m_options;
+
+    std::mutex m_mutex;
+    phmap::flat_hash_map<std::string, std::unique_ptr<Host>> m_hosts;
+
+    std::atomic<std::size_t> m_created = 0;
+    std::atomic<std::size_t> m_reused = 0;
+};
+
+} // namespace bxt::Infrastructure
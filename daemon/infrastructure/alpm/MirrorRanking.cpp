@@ -0,0 +1,154 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "MirrorRanking.h"
+
+#include "utilities/MemoryLiterals.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+namespace bxt::Infrastructure {
+
+namespace {
+    using namespace bxt::MemoryLiterals;
+
+    // Weight of the newest sample in the moving averages
+    constexpr double Smoothing = 0.3;
+
+    // Small files mostly measure the round trip, not the bandwidth
+    constexpr std::size_t MinThroughputSample = 64_KiB;
+
+    double smooth(double average, double sample) {
+        return average == 0 ? sample : average + Smoothing * (sample - average);
+    }
+} // namespace
+
+MirrorRanking::MirrorRanking(Options options)
+    : m_options(std::move(options)) {
+}
+
+std::vector<std::string> MirrorRanking::rank(std::vector<std::string> const& urls) const {
+    struct Ranked {
+        std::string url;
+        Mirror mirror;
+    };
+
+    std::vector<Ranked> ranked;
+    ranked.reserve(urls.size());
+    {
+        std::lock_guard lock(m_mutex);
+
+        auto const now = Clock::now();
+        for (auto const& url : urls) {
+            auto const it = m_states.find(url);
+            ranked.emplace_back(url, it == m_states.end() ? Mirror {} : snapshot(it->second, now));
+        }
+    }
+
+    auto const latency = [](Mirror const& mirror) {
+        return mirror.latency.count() > 0 ? mirror.latency.count()
+                                          : std::numeric_limits<std::int64_t>::max();
+    };
+
+    std::ranges::stable_sort(ranked, [&latency](Ranked const& lhs, Ranked const& rhs) {
+        if (lhs.mirror.healthy != rhs.mirror.healthy) {
+            return lhs.mirror.healthy;
+        }
+        if (lhs.mirror.bytes_per_second != rhs.mirror.bytes_per_second) {
+            return lhs.mirror.bytes_per_second > rhs.mirror.bytes_per_second;
+        }
+        return latency(lhs.mirror) < latency(rhs.mirror);
+    });
+
+    std::vector<std::string> result;
+    result.reserve(ranked.size());
+    for (auto& [url, mirror] : ranked) {
+        result.emplace_back(std::move(url));
+    }
+
+    return result;
+}
+
+std::vector<std::string> MirrorRanking::candidates(std::vector<std::string> const& urls,
+                                                   std::size_t stripe) const {
+    auto ranked = rank(urls);
+
+    double best = 0;
+    for (auto const& url : ranked) {
+        if (auto const state = mirror(url); state.healthy) {
+            best = std::max(best, state.bytes_per_second);
+        }
+    }
+
+    // Unmeasured mirrors are striped too, that's how they get measured
+    auto const stripe_end = std::ranges::stable_partition(ranked, [&](auto const& url) {
+                                auto const state = mirror(url);
+                                return state.healthy
+                                       && (state.bytes_per_second == 0
+                                           || state.bytes_per_second * m_options.slow_factor
+                                                  >= best);
+                            }).begin();
+
+    auto const striped = std::distance(ranked.begin(), stripe_end);
+    if (striped > 1) {
+        std::ranges::rotate(ranked.begin(), ranked.begin() + (stripe % striped), stripe_end);
+    }
+
+    return ranked;
+}
+
+void MirrorRanking::record_latency(std::string const& url, Clock::duration latency) {
+    std::lock_guard lock(m_mutex);
+
+    auto& state = m_states[url];
+    state.latency_us = smooth(
+        state.latency_us, std::chrono::duration<double, std::micro>(latency).count());
+    state.failures = 0;
+}
+
+void MirrorRanking::record_transfer(std::string const& url,
+                                    std::size_t bytes,
+                                    Clock::duration duration) {
+    std::lock_guard lock(m_mutex);
+
+    auto& state = m_states[url];
+    state.failures = 0;
+
+    auto const seconds = std::chrono::duration<double>(duration).count();
+    if (bytes < MinThroughputSample || seconds <= 0) {
+        return;
+    }
+
+    state.bytes_per_second = smooth(state.bytes_per_second, static_cast<double>(bytes) / seconds);
+}
+
+void MirrorRanking::record_failure(std::string const& url) {
+    std::lock_guard lock(m_mutex);
+
+    auto& state = m_states[url];
+    if (++state.failures >= m_options.max_failures) {
+        state.benched_until = Clock::now() + m_options.cooldown;
+    }
+}
+
+MirrorRanking::Mirror MirrorRanking::mirror(std::string const& url) const {
+    std::lock_guard lock(m_mutex);
+
+    auto const it = m_states.find(url);
+    return it == m_states.end() ? Mirror {} : snapshot(it->second, Clock::now());
+}
+
+MirrorRanking::Mirror MirrorRanking::snapshot(State const& state, Clock::time_point now) const {
+    return {.latency = std::chrono::microseconds(static_cast<std::int64_t>(state.latency_us)),
+            .bytes_per_second = state.bytes_per_second,
+            .failures = state.failures,
+            .healthy = state.failures < m_options.max_failures || now >= state.benched_until};
+}
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,76 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <parallel_hashmap/phmap.h>
+#include <string>
+#include <vector>
+
+namespace bxt::Infrastructure {
+
+// Measured quality of the sync mirrors, shared by all sections. Latency comes
+// from probes and database requests, throughput from package transfers.
+// Mirrors failing repeatedly are benched for a while and only used as a last
+// resort.
+class MirrorRanking {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        // Consecutive failures after which a mirror is benched
+        std::size_t max_failures = 3;
+        std::chrono::seconds cooldown = std::chrono::seconds(60);
+        // Mirrors slower than the fastest one by this factor aren't striped
+        double slow_factor = 4.0;
+    };
+
+    struct Mirror {
+        // Zero until measured
+        std::chrono::microseconds latency {0};
+        double bytes_per_second = 0;
+        std::size_t failures = 0;
+        bool healthy = true;
+    };
+
+    explicit MirrorRanking(Options options);
+
+    // Best first: healthy before benched, then by throughput and latency.
+    // Mirrors without measurements keep their configured order.
+    std::vector<std::string> rank(std::vector<std::string> const& urls) const;
+
+    // Mirrors to try for one file: the healthy, reasonably fast mirrors
+    // rotated by `stripe`, so consecutive files spread over them, followed
+    // by the rest in rank order for failover.
+    std::vector<std::string> candidates(std::vector<std::string> const& urls,
+                                        std::size_t stripe) const;
+
+    void record_latency(std::string const& url, Clock::duration latency);
+    void record_transfer(std::string const& url, std::size_t bytes, Clock::duration duration);
+    void record_failure(std::string const& url);
+
+    Mirror mirror(std::string const& url) const;
+
+private:
+    struct State {
+        double latency_us = 0;
+        double bytes_per_second = 0;
+        std::size_t failures = 0;
+        Clock::time_point benched_until {};
+    };
+
+    Mirror snapshot(State const& state, Clock::time_point now) const;
+
+    Options m_options;
+
+    mutable std::mutex m_mutex;
+    phmap::flat_hash_map<std::string, State> m_states;
+};
+
+} // namespace bxt::Infrastructure
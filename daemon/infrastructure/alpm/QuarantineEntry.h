@@ -0,0 +1,28 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <cereal/types/string.hpp>
+#include <cstddef>
+#include <string>
+
+namespace bxt::Infrastructure {
+
+// Consecutive syncs in which an upstream package version couldn't be
+// downloaded. Once `failures` reaches the configured limit the version is
+// skipped until upstream replaces it.
+struct QuarantineEntry {
+    std::string version;
+    std::size_t failures = 0;
+    std::string reason;
+
+    template<class Archive> void serialize(Archive& ar) {
+        ar(version, failures, reason);
+    }
+};
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,172 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "ResumableDownload.h"
+
+#include "utilities/Digest.h"
+#include "utilities/MemoryLiterals.h"
+
+#include <fmt/format.h>
+#include <fstream>
+#include <optional>
+#include <system_error>
+#include <vector>
+
+namespace bxt::Infrastructure {
+
+namespace {
+    using namespace bxt::MemoryLiterals;
+    using ErrorType = ResumableDownloadError::ErrorType;
+
+    constexpr auto HashChunkSize = 1_MiB;
+
+    // Feeds the bytes already in the part file to the digest, returns how many
+    // there were or nullopt if the part can't be read.
+    std::optional<std::size_t> hash_existing(std::filesystem::path const& part,
+                                             Utilities::Digest& digest) {
+        std::ifstream stream(part, std::ios::binary);
+        if (!stream.is_open()) {
+            return std::nullopt;
+        }
+
+        std::vector<char> buffer(HashChunkSize);
+        std::size_t size = 0;
+        while (stream) {
+            stream.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            auto const count = static_cast<std::size_t>(stream.gcount());
+            digest.update(buffer.data(), count);
+            size += count;
+        }
+
+        if (!stream.eof()) {
+            return std::nullopt;
+        }
+        return size;
+    }
+
+    std::unexpected<ResumableDownloadError>
+        discard(std::filesystem::path const& part, ErrorType type, std::string const& details) {
+        std::error_code ec;
+        std::filesystem::remove(part, ec);
+        return bxt::make_error<ResumableDownloadError>(type, details);
+    }
+} // namespace
+
+std::expected<ResumableDownload, ResumableDownloadError>
+    download_resumable(httplib::Client& client,
+                       std::string const& path,
+                       std::filesystem::path const& target,
+                       std::string_view expected_sha256,
+                       std::function<void(std::size_t)> const& on_received) {
+    auto part = target;
+    part += ".part";
+
+    auto digest = Utilities::Digest::sha256();
+    ResumableDownload download;
+
+    std::error_code ec;
+    if (std::filesystem::exists(part, ec)) {
+        if (auto const existing = hash_existing(part, digest); existing.has_value()) {
+            download.resumed_from = *existing;
+        } else {
+            digest = Utilities::Digest::sha256();
+        }
+    }
+
+    httplib::Headers headers;
+    if (download.resumed_from > 0) {
+        headers.emplace("Range", fmt::format("bytes={}-", download.resumed_from));
+    }
+
+    std::ofstream stream;
+    int status = 0;
+    bool range_mismatch = false;
+
+    auto const response = client.Get(
+        path, headers,
+        [&](httplib::Response const& head) {
+            status = head.status;
+
+            if (status == httplib::StatusCode::PartialContent_206) {
+                // The range must start where the part ends, anything else
+                // would corrupt it
+                auto const expected_range = fmt::format("bytes {}-", download.resumed_from);
+                if (download.resumed_from == 0
+                    || !head.get_header_value("Content-Range").starts_with(expected_range)) {
+                    range_mismatch = true;
+                    return false;
+                }
+                stream.open(part, std::ios::binary | std::ios::app);
+            } else if (status == httplib::StatusCode::OK_200) {
+                // Range ignored or nothing to resume: start over
+                download.resumed_from = 0;
+                digest = Utilities::Digest::sha256();
+                stream.open(part, std::ios::binary | std::ios::trunc);
+            } else {
+                return true;
+            }
+
+            return stream.is_open();
+        },
+        [&](char const* data, std::size_t data_length) {
+            if (!stream.is_open()) {
+                return true;
+            }
+
+            stream.write(data, static_cast<std::streamsize>(data_length));
+            digest.update(data, data_length);
+            download.received += data_length;
+
+            if (on_received) {
+                on_received(data_length);
+            }
+            return stream.good();
+        });
+
+    if (stream.is_open()) {
+        stream.close();
+    }
+    if (stream.fail()) {
+        return discard(part, ErrorType::IOError, part.string());
+    }
+
+    if (range_mismatch) {
+        return discard(part, ErrorType::HttpError, "Content-Range doesn't match the part");
+    }
+
+    if (!response) {
+        // The part stays so the next attempt continues from where this one
+        // stopped
+        return bxt::make_error<ResumableDownloadError>(ErrorType::NetworkError,
+                                                       httplib::to_string(response.error()));
+    }
+
+    // Nothing left to send: the part was already complete
+    if (status == httplib::StatusCode::RangeNotSatisfiable_416 && download.resumed_from > 0) {
+        status = httplib::StatusCode::PartialContent_206;
+    }
+
+    if (status != httplib::StatusCode::OK_200
+        && status != httplib::StatusCode::PartialContent_206) {
+        return bxt::make_error<ResumableDownloadError>(ErrorType::HttpError,
+                                                       fmt::format("HTTP status {}", status));
+    }
+
+    download.sha256 = digest.hex_digest();
+    if (!expected_sha256.empty() && download.sha256 != expected_sha256) {
+        return discard(part, ErrorType::HashMismatch,
+                       fmt::format("expected {}, got {}", expected_sha256, download.sha256));
+    }
+
+    std::filesystem::rename(part, target, ec);
+    if (ec) {
+        return discard(part, ErrorType::IOError, ec.message());
+    }
+
+    return download;
+}
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,61 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "utilities/Error.h"
+
+#include <cstddef>
+#include <expected>
+#include <filesystem>
+#include <frozen/unordered_map.h>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include <httplib.h>
+
+namespace bxt::Infrastructure {
+
+struct ResumableDownloadError : public bxt::Error {
+    enum class ErrorType { NetworkError, HttpError, IOError, HashMismatch };
+
+    ResumableDownloadError(ErrorType error_type, std::string const& details)
+        : error_type(error_type) {
+        message = fmt::format("{}: {}", error_messages.at(error_type), details);
+    }
+
+    ErrorType error_type;
+
+    static constexpr frozen::unordered_map<ErrorType, std::string_view, 4> error_messages {
+        {ErrorType::NetworkError, "Transfer interrupted"},
+        {ErrorType::HttpError, "Unexpected response"},
+        {ErrorType::IOError, "Can't write the file"},
+        {ErrorType::HashMismatch, "Checksum mismatch"}};
+};
+
+struct ResumableDownload {
+    // Bytes already present in the part file when the attempt started
+    std::size_t resumed_from = 0;
+    std::size_t received = 0;
+    std::string sha256;
+};
+
+// Downloads `path` into `target` through "<target>.part". A part left by an
+// interrupted attempt is continued with a Range request; if the server
+// ignores the range, the file starts over. The SHA256 is computed while
+// writing and the part is renamed into place only if it matches
+// `expected_sha256` (when given). Interrupted transfers keep the part, hash
+// mismatches discard it.
+std::expected<ResumableDownload, ResumableDownloadError>
+    download_resumable(httplib::Client& client,
+                       std::string const& path,
+                       std::filesystem::path const& target,
+                       std::string_view expected_sha256 = {},
+                       std::function<void(std::size_t)> const& on_received = {});
+
+} // namespace bxt::Infrastructure
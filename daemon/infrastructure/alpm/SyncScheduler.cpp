@@ -0,0 +1,105 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "SyncScheduler.h"
+
+#include "utilities/log/Logging.h"
+#include "utilities/to_string.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace bxt::Infrastructure {
+
+SyncScheduler::SyncScheduler(ArchRepoOptions& options,
+                             ArchRepoSyncService& sync_service,
+                             std::shared_ptr<coro::io_scheduler> scheduler)
+    : m_options(options)
+    , m_sync_service(sync_service)
+    , m_scheduler(std::move(scheduler))
+    , m_slots(
+          static_cast<std::ptrdiff_t>(std::max<std::size_t>(1, options.max_concurrent_sections)))
+    , m_random(std::random_device {}()) {
+}
+
+void SyncScheduler::start() {
+    if (m_started.exchange(true)) {
+        return;
+    }
+
+    std::size_t scheduled = 0;
+    for (auto const& [section, source] : m_options.sources) {
+        auto const interval = source.sync_interval.value_or(m_options.sync_interval);
+        if (interval.count() <= 0) {
+            continue;
+        }
+
+        m_scheduler->schedule(run(section, interval));
+        ++scheduled;
+    }
+
+    if (scheduled == 0) {
+        logi("Sync scheduler: No sections to sync periodically");
+        return;
+    }
+
+    logi("Sync scheduler: Syncing {} sections periodically, at most {} at a time", scheduled,
+         std::max<std::size_t>(1, m_options.max_concurrent_sections));
+}
+
+std::chrono::milliseconds SyncScheduler::delay(std::chrono::seconds interval,
+                                               std::chrono::seconds jitter,
+                                               std::mt19937_64& random) {
+    std::chrono::milliseconds result = interval;
+    if (jitter.count() > 0) {
+        std::uniform_int_distribution<int64_t> distribution(
+            0, std::chrono::milliseconds(jitter).count());
+        result += std::chrono::milliseconds(distribution(random));
+    }
+
+    return result;
+}
+
+coro::task<void> SyncScheduler::run(Core::Application::PackageSectionDTO const section,
+                                    std::chrono::seconds const interval) {
+    co_await m_scheduler->schedule();
+
+    auto const section_name = bxt::to_string(section);
+
+    // Jitter only, so a restart doesn't postpone the first sync by a whole
+    // interval, but the sections still don't start together
+    co_await m_scheduler->schedule_after(next_delay(std::chrono::seconds(0)));
+
+    while (true) {
+        co_await m_slots.acquire();
+
+        auto const started_at = std::chrono::steady_clock::now();
+        auto const synced = co_await m_sync_service.sync_scheduled(section);
+
+        // Resumes the next waiting section inline
+        m_slots.release();
+
+        if (!synced.has_value()) {
+            logw("Sync scheduler: Syncing {} failed: {}", section_name, synced.error().what());
+        } else if (*synced) {
+            logi("Sync scheduler: Synced {} in {}s", section_name,
+                 std::chrono::duration_cast<std::chrono::seconds>(
+                     std::chrono::steady_clock::now() - started_at)
+                     .count());
+        } else {
+            logd("Sync scheduler: {} is up to date", section_name);
+        }
+
+        co_await m_scheduler->schedule_after(next_delay(interval));
+    }
+}
+
+std::chrono::milliseconds SyncScheduler::next_delay(std::chrono::seconds interval) {
+    std::lock_guard lock(m_random_mutex);
+    return delay(interval, m_options.sync_jitter, m_random);
+}
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,57 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "core/application/dtos/PackageSectionDTO.h"
+#include "infrastructure/alpm/ArchRepoOptions.h"
+#include "infrastructure/alpm/ArchRepoSyncService.h"
+
+#include <atomic>
+#include <chrono>
+#include <coro/io_scheduler.hpp>
+#include <coro/semaphore.hpp>
+#include <coro/task.hpp>
+#include <memory>
+#include <mutex>
+#include <random>
+
+namespace bxt::Infrastructure {
+
+// Syncs every source on its own cadence, configured globally or per source.
+// A random jitter spreads the syncs so the sections of a mirror aren't
+// fetched at once, and only a few sections are synced at the same time.
+class SyncScheduler {
+public:
+    SyncScheduler(ArchRepoOptions& options,
+                  ArchRepoSyncService& sync_service,
+                  std::shared_ptr<coro::io_scheduler> scheduler);
+
+    void start();
+
+    // Time until the next sync: the interval plus up to `jitter`
+    static std::chrono::milliseconds
+        delay(std::chrono::seconds interval, std::chrono::seconds jitter, std::mt19937_64& random);
+
+private:
+    coro::task<void> run(Core::Application::PackageSectionDTO const section,
+                         std::chrono::seconds const interval);
+
+    std::chrono::milliseconds next_delay(std::chrono::seconds interval);
+
+    ArchRepoOptions& m_options;
+    ArchRepoSyncService& m_sync_service;
+    std::shared_ptr<coro::io_scheduler> m_scheduler;
+
+    coro::semaphore m_slots;
+
+    std::mutex m_random_mutex;
+    std::mt19937_64 m_random;
+
+    std::atomic<bool> m_started = false;
+};
+
+} // namespace bxt::Infrastructure
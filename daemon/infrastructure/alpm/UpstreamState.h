@@ -0,0 +1,27 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <cereal/types/string.hpp>
+#include <string>
+
+namespace bxt::Infrastructure {
+
+// Validators of the last upstream database a section was synced from
+struct UpstreamState {
+    // Database URL the validators belong to
+    std::string url;
+    std::string etag;
+    std::string last_modified;
+    std::string sha256;
+
+    template<class Archive> void serialize(Archive& ar) {
+        ar(url, etag, last_modified, sha256);
+    }
+};
+
+} // namespace bxt::Infrastructure
@@ -0,0 +1,265 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "VerifiedCache.h"
+
+#include "persistence/lmdb/LmdbUnitOfWork.h"
+#include "utilities/log/Logging.h"
+
+#include <sys/stat.h>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace bxt::Infrastructure {
+
+namespace {
+    // Files hashed by the scrub before it yields, so syncs don't compete
+    // with it for the disk for long
+    constexpr std::size_t ScrubBatchSize = 16;
+    constexpr auto ScrubBatchDelay = std::chrono::seconds(1);
+
+    int64_t now() {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+} // namespace
+
+VerifiedCache::VerifiedCache(Options options,
+                             std::shared_ptr<Utilities::LMDB::Environment> env,
+                             UnitOfWorkBaseFactory& uow_factory,
+                             HashingService& hashing_service,
+                             std::shared_ptr<coro::io_scheduler> scheduler)
+    : m_options(std::move(options))
+    , m_uow_factory(uow_factory)
+    , m_hashing_service(hashing_service)
+    , m_scheduler(std::move(scheduler))
+    , m_db(std::move(env), "bxt::VerifiedCache") {
+}
+
+void VerifiedCache::start() {
+    if (m_options.max_age.count() == 0) {
+        logi("Cache scrub: Disabled by configuration");
+        return;
+    }
+
+    if (m_started.exchange(true)) {
+        return;
+    }
+
+    m_scheduler->schedule(run());
+}
+
+coro::task<HashingService::Result<std::string>>
+    VerifiedCache::sha256(std::filesystem::path const path) {
+    auto const key = path.string();
+    auto current = examine(path);
+
+    if (current.has_value()) {
+        std::optional<VerifiedFile> entry;
+        {
+            std::lock_guard lock(m_pending_mutex);
+            if (auto const it = m_pending.find(key); it != m_pending.end()) {
+                entry = it->second;
+            }
+        }
+
+        if (!entry.has_value()) {
+            auto const uow = std::dynamic_pointer_cast<Persistence::LmdbUnitOfWork>(
+                co_await m_uow_factory());
+            if (uow) {
+                if (auto stored = co_await m_db.get(uow->txn().value, key); stored.has_value()) {
+                    entry = std::move(*stored);
+                }
+            }
+        }
+
+        if (entry.has_value() && matches(*entry, *current)) {
+            co_return entry->sha256;
+        }
+    }
+
+    auto hash = co_await m_hashing_service.sha256(path);
+    co_await m_scheduler->schedule();
+
+    if (hash.has_value()) {
+        remember(path, *hash);
+    }
+
+    co_return hash;
+}
+
+void VerifiedCache::remember(std::filesystem::path const& path, std::string sha256) {
+    auto entry = examine(path);
+    if (!entry.has_value()) {
+        return;
+    }
+    entry->sha256 = std::move(sha256);
+    entry->verified_at = now();
+
+    std::lock_guard lock(m_pending_mutex);
+    m_pending.insert_or_assign(path.string(), std::move(entry));
+}
+
+void VerifiedCache::forget(std::filesystem::path const& path) {
+    std::lock_guard lock(m_pending_mutex);
+    m_pending.insert_or_assign(path.string(), std::nullopt);
+}
+
+coro::task<std::expected<void, DatabaseError>>
+    VerifiedCache::save(std::shared_ptr<UnitOfWorkBase> uow) {
+    auto const lmdb_uow = std::dynamic_pointer_cast<Persistence::LmdbUnitOfWork>(uow);
+    if (!lmdb_uow) {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    phmap::flat_hash_map<std::string, std::optional<VerifiedFile>> pending;
+    {
+        std::lock_guard lock(m_pending_mutex);
+        pending = std::exchange(m_pending, {});
+    }
+
+    for (auto const& [key, entry] : pending) {
+        if (entry.has_value()) {
+            auto put_ok = co_await m_db.put(lmdb_uow->txn().value, key, *entry);
+            if (!put_ok.has_value()) {
+                co_return std::unexpected(std::move(put_ok.error()));
+            }
+        } else {
+            // Missing entries are fine, the file may never have been verified
+            co_await m_db.del(lmdb_uow->txn().value, key);
+        }
+    }
+
+    co_return {};
+}
+
+coro::task<VerifiedCache::ScrubStats> VerifiedCache::scrub() {
+    ScrubStats stats;
+    auto const verified_before = now() - m_options.max_age.count();
+
+    std::vector<std::pair<std::string, VerifiedFile>> stale;
+    {
+        auto const uow =
+            std::dynamic_pointer_cast<Persistence::LmdbUnitOfWork>(co_await m_uow_factory());
+        if (!uow) {
+            co_return stats;
+        }
+
+        co_await m_db.accept(uow->txn().value,
+                             [&](std::string_view key, VerifiedFile const& entry) {
+                                 if (entry.verified_at < verified_before) {
+                                     stale.emplace_back(key, entry);
+                                 }
+                                 return Utilities::NavigationAction::Next;
+                             });
+    }
+
+    for (std::size_t offset = 0; offset < stale.size(); offset += ScrubBatchSize) {
+        if (offset > 0) {
+            co_await m_scheduler->schedule_after(ScrubBatchDelay);
+        }
+
+        auto const end = std::min(stale.size(), offset + ScrubBatchSize);
+
+        std::vector<std::pair<std::string, VerifiedFile>> batch;
+        std::vector<std::filesystem::path> paths;
+        for (std::size_t i = offset; i < end; ++i) {
+            auto const& [key, entry] = stale[i];
+            std::filesystem::path const path = key;
+            ++stats.checked;
+
+            auto const current = examine(path);
+            if (!current.has_value() || !matches(entry, *current)) {
+                forget(path);
+                ++stats.dropped;
+                continue;
+            }
+
+            batch.emplace_back(stale[i]);
+            paths.emplace_back(path);
+        }
+
+        auto const hashes = co_await m_hashing_service.sha256(paths);
+
+        // Back from the hashing pool before the results are saved
+        co_await m_scheduler->schedule();
+
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            auto const& [key, entry] = batch[i];
+            auto const& path = paths[i];
+            auto const& hash = hashes[i];
+
+            if (!hash.has_value()) {
+                forget(path);
+                ++stats.dropped;
+                continue;
+            }
+
+            if (*hash != entry.sha256) {
+                logw("Cache scrub: {} doesn't match its checksum anymore, removing it",
+                     path.string());
+                std::error_code ec;
+                std::filesystem::remove(path, ec);
+                forget(path);
+                ++stats.corrupted;
+                continue;
+            }
+
+            remember(path, *hash);
+        }
+
+        auto uow = co_await m_uow_factory(true);
+        if (auto saved = co_await save(uow); !saved.has_value()) {
+            logw("Cache scrub: Can't save the results: {}", saved.error().what());
+            co_return stats;
+        }
+        if (auto committed = co_await uow->commit_async(); !committed.has_value()) {
+            logw("Cache scrub: Can't save the results: {}", committed.error().what());
+            co_return stats;
+        }
+    }
+
+    co_return stats;
+}
+
+std::optional<VerifiedFile> VerifiedCache::examine(std::filesystem::path const& path) {
+    struct stat status {};
+    if (::stat(path.c_str(), &status) != 0 || !S_ISREG(status.st_mode)) {
+        return std::nullopt;
+    }
+
+    return VerifiedFile {.size = static_cast<std::uintmax_t>(status.st_size),
+                         .mtime = static_cast<int64_t>(status.st_mtim.tv_sec) * 1'000'000'000
+                                  + status.st_mtim.tv_nsec,
+                         .inode = static_cast<uint64_t>(status.st_ino)};
+}
+
+bool VerifiedCache::matches(VerifiedFile const& entry, VerifiedFile const& current) {
+    return entry.size == current.size && entry.mtime == current.mtime
+           && entry.inode == current.inode && !entry.sha256.empty();
+}
+
+coro::task<void> VerifiedCache::run() {
+    co_await m_scheduler->schedule();
+
+    while (true) {
+        co_await m_scheduler->schedule_after(m_options.interval);
+
+        auto const started_at = std::chrono::steady_clock::now();
+        auto const stats = co_await scrub();
+
+        logi("Cache scrub: Pass finished in {}s, {} files checked, {} entries dropped, {} "
+             "corrupted files removed",
+             std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now()
+                                                              - started_at)
+                 .count(),
+             stats.checked, stats.dropped, stats.corrupted);
+    }
+}
+
+} // namespace bxt::Infrastructure
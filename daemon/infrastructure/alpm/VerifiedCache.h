@@ -0,0 +1,97 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "core/domain/repositories/UnitOfWorkBase.h"
+#include "infrastructure/alpm/VerifiedFile.h"
+#include "infrastructure/HashingService.h"
+#include "utilities/errors/DatabaseError.h"
+#include "utilities/lmdb/Database.h"
+#include "utilities/lmdb/Environment.h"
+
+#include <atomic>
+#include <chrono>
+#include <coro/io_scheduler.hpp>
+#include <coro/task.hpp>
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <parallel_hashmap/phmap.h>
+#include <string>
+
+namespace bxt::Infrastructure {
+
+// Remembers which download cache files were verified, keyed by path. A file
+// whose size, modification time and inode still match its entry is trusted
+// without reading it again. A background scrub hashes the entries that
+// weren't verified for a while, so silent corruption is still found.
+class VerifiedCache {
+public:
+    struct Options {
+        // Entries verified longer ago are hashed again by the scrub, zero
+        // disables it
+        std::chrono::seconds max_age = std::chrono::days(7);
+        // Delay between two scrub passes
+        std::chrono::seconds interval = std::chrono::hours(6);
+    };
+
+    struct ScrubStats {
+        std::size_t checked = 0;
+        std::size_t dropped = 0;
+        std::size_t corrupted = 0;
+    };
+
+    VerifiedCache(Options options,
+                  std::shared_ptr<Utilities::LMDB::Environment> env,
+                  UnitOfWorkBaseFactory& uow_factory,
+                  HashingService& hashing_service,
+                  std::shared_ptr<coro::io_scheduler> scheduler);
+
+    // Starts the periodic scrub
+    void start();
+
+    // Checksum of a cached file. The recorded one while the file still
+    // matches its entry, otherwise the file is hashed and remembered.
+    coro::task<HashingService::Result<std::string>> sha256(std::filesystem::path const path);
+
+    // Records a checksum computed elsewhere, e.g. while downloading
+    void remember(std::filesystem::path const& path, std::string sha256);
+    // For files that are removed or replaced
+    void forget(std::filesystem::path const& path);
+
+    // Writes what was remembered or forgotten since the last save, in the
+    // transaction of the caller
+    coro::task<std::expected<void, DatabaseError>> save(std::shared_ptr<UnitOfWorkBase> uow);
+
+    // Hashes the entries verified more than `max_age` ago. Entries of files
+    // that are gone or changed are dropped, corrupted files are removed.
+    coro::task<ScrubStats> scrub();
+
+    // What identifies the file on disk, nullopt if it can't be examined
+    static std::optional<VerifiedFile> examine(std::filesystem::path const& path);
+    static bool matches(VerifiedFile const& entry, VerifiedFile const& current);
+
+private:
+    coro::task<void> run();
+
+    Options m_options;
+    UnitOfWorkBaseFactory& m_uow_factory;
+    HashingService& m_hashing_service;
+    std::shared_ptr<coro::io_scheduler> m_scheduler;
+
+    Utilities::LMDB::Database<VerifiedFile> m_db;
+
+    // Changes waiting for the next save, nullopt deletes the entry
+    std::mutex m_pending_mutex;
+    phmap::flat_hash_map<std::string, std::optional<VerifiedFile>> m_pending;
+
+    std::atomic<bool> m_started = false;
+};
+
+} // namespace bxt::Infrastructure
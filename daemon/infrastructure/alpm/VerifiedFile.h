@@ -0,0 +1,31 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <cereal/types/string.hpp>
+#include <cstdint>
+#include <string>
+
+namespace bxt::Infrastructure {
+
+// A download cache file whose checksum was computed, along with what
+// identifies that exact file on disk
+struct VerifiedFile {
+    std::uintmax_t size = 0;
+    // Modification time in nanoseconds since the epoch
+    int64_t mtime = 0;
+    uint64_t inode = 0;
+    std::string sha256;
+    // Seconds since the epoch
+    int64_t verified_at = 0;
+
+    template<class Archive> void serialize(Archive& ar) {
+        ar(size, mtime, inode, sha256, verified_at);
+    }
+};
+
+} // namespace bxt::Infrastructure
@@ -38,11 +38,13 @@ namespace bxt::Persistence::Box {
 BoxRepository::BoxRepository(BoxOptions options,
                              PackageStoreBase& package_store,
                              WritebackScheduler& writeback_sceduler,
-                             ExporterBase& exporter)
+                             ExporterBase& exporter,
+                             FileListExtractor& file_list_extractor)
     : m_options(std::move(options))
     , m_package_store(package_store)
     , m_scheduler(writeback_sceduler)
-    , m_exporter(exporter) {};
+    , m_exporter(exporter)
+    , m_file_list_extractor(file_list_extractor) {};
 
 void BoxRepository::make_writeback_hook(Section const section,
                                         std::shared_ptr<UnitOfWorkBase> uow) {
@@ -52,30 +54,36 @@ void BoxRepository::make_writeback_hook(Section const section,
                    "Box::Exporter::WriteBack");
 }
 
+void BoxRepository::make_file_list_hook(std::vector<Package> const& packages,
+                                        std::shared_ptr<UnitOfWorkBase> uow) {
+    auto package_ids = packages | std::views::transform([](auto const& package) {
+                           return PackageRecord::Id {
+                               .section = SectionDTOMapper::to_dto(package.section()),
+                               .name = package.name()};
+                       })
+                       | std::ranges::to<std::vector>();
+
+    uow->post_hook([this, package_ids = std::move(package_ids)]() mutable {
+        m_file_list_extractor.enqueue(std::move(package_ids));
+    });
+}
+
 coro::task<BoxRepository::TResult>
     BoxRepository::find_by_id_async(TId id, std::shared_ptr<UnitOfWorkBase> uow) {
-    std::optional<BoxRepository::TResult> result;
-    auto accept_ok = co_await m_package_store.accept(
-        [&](std::string_view key, PackageRecord const& value) {
-            if (value.id.section == SectionDTOMapper::to_dto(id.section)
-                && value.id.name == id.package_name) {
-                result = RecordMapper::to_entity(value);
-                return Utilities::NavigationAction::Stop;
-            }
-            return Utilities::NavigationAction::Next;
-        },
-        bxt::to_string(id), uow);
-
-    if (!result.has_value()) {
-        co_return bxt::make_error<ReadError>(ReadError::EntityNotFound);
-    }
+    auto record = co_await m_package_store.find_by_id(
+        PackageRecord::Id {.section = SectionDTOMapper::to_dto(id.section),
+                           .name = id.package_name},
+        uow);
 
-    if (!accept_ok.has_value()) {
-        co_return bxt::make_error_with_source<ReadError>(std::move(accept_ok.error()),
+    if (!record.has_value()) {
+        if (record.error().error_type == DatabaseError::ErrorType::EntityNotFound) {
+            co_return bxt::make_error<ReadError>(ReadError::EntityNotFound);
+        }
+        co_return bxt::make_error_with_source<ReadError>(std::move(record.error()),
                                                          ReadError::EntityFindError);
     }
 
-    co_return *result;
+    co_return RecordMapper::to_entity(*record);
 }
 
 coro::task<BoxRepository::TResult>
@@ -162,6 +170,7 @@ coro::task<BoxRepository::WriteResult<void>>
          entity | std::views::transform([](auto const& pkg) { return pkg.section(); })) {
         make_writeback_hook(section, uow);
     }
+    make_file_list_hook(entity, uow);
 
     co_return {};
 }
@@ -175,6 +184,7 @@ coro::task<BoxRepository::WriteResult<void>>
     }
 
     make_writeback_hook(entity.section(), uow);
+    make_file_list_hook({entity}, uow);
 
     co_return {};
 }
@@ -222,6 +232,29 @@ coro::task<BoxRepository::WriteResult<void>>
     co_return {};
 }
 
+coro::task<BoxRepository::WriteResult<void>>
+    BoxRepository::delete_location_async(std::vector<TId> const ids,
+                                         Core::Domain::PoolLocation const location,
+                                         std::shared_ptr<UnitOfWorkBase> uow) {
+    for (auto const& id : ids) {
+        auto result = co_await m_package_store.remove_location(
+            PackageRecord::Id {.section = SectionDTOMapper::to_dto(id.section),
+                               .name = id.package_name},
+            location, uow);
+
+        if (!result.has_value()) {
+            co_return bxt::make_error_with_source<WriteError>(std::move(result.error()),
+                                                              WriteError::OperationError);
+        }
+
+        if (*result) {
+            make_writeback_hook(id.section, uow);
+        }
+    }
+
+    co_return {};
+}
+
 coro::task<BoxRepository::WriteResult<void>>
     BoxRepository::update_async(std::vector<Package> const entity,
                                 std::shared_ptr<UnitOfWorkBase> uow) {
@@ -243,6 +276,7 @@ coro::task<BoxRepository::WriteResult<void>>
          entity | std::views::transform([](auto const& e) { return e.section(); })) {
         make_writeback_hook(section, uow);
     }
+    make_file_list_hook(entity, uow);
     co_return {};
 }
 
@@ -255,6 +289,7 @@ coro::task<BoxRepository::WriteResult<void>>
     }
 
     make_writeback_hook(entity.section(), uow);
+    make_file_list_hook({entity}, uow);
 
     co_return {};
 }
@@ -310,21 +345,47 @@ coro::task<BoxRepository::TResults>
 
 coro::task<BoxRepository::TResult> BoxRepository::find_by_section_async(
     Section const section, Name const name, std::shared_ptr<UnitOfWorkBase> uow) {
-    std::optional<Core::Domain::Package> result;
+    // A prefix scan would also match packages whose names merely start with
+    // `name`, the key has to match exactly
+    co_return co_await find_by_id_async(TId {section, name}, uow);
+}
 
-    co_await m_package_store.accept(
-        [&result](std::string_view key, auto const& record) {
-            result = RecordMapper::to_entity(record);
+coro::task<BoxRepository::ReadResult<BoxRepository::VersionSnapshot>>
+    BoxRepository::find_versions_by_section_async(Section const section,
+                                                  std::shared_ptr<UnitOfWorkBase> uow) {
+    VersionSnapshot result;
+
+    // Keys are "<section>/<name>", so the cursor yields the names in order
+    auto const accepted = co_await m_package_store.accept(
+        [&result](std::string_view, PackageRecord const& record) {
+            auto const location = Core::Domain::select_preferred_pool_location(record.descriptions);
+            if (!location.has_value()) {
+                return Utilities::NavigationAction::Next;
+            }
+
+            auto const version_field =
+                record.descriptions.at(*location).descfile.get("VERSION");
+            if (!version_field.has_value()) {
+                return Utilities::NavigationAction::Next;
+            }
+
+            auto version = Core::Domain::PackageVersion::from_string(*version_field);
+            if (version.has_value()) {
+                result.emplace_back(
+                    record.id.name, std::move(*version),
+                    record.descriptions.contains(Core::Domain::PoolLocation::Sync));
+            }
 
-            return Utilities::NavigationAction::Stop;
+            return Utilities::NavigationAction::Next;
         },
-        fmt::format("{}/{}", section.string(), name), uow);
+        fmt::format("{}/", section.string()), uow);
 
-    if (result.has_value()) {
-        co_return *result;
-    } else {
-        co_return bxt::make_error<ReadError>(ReadError::EntityNotFound);
+    if (!accepted.has_value()) {
+        co_return bxt::make_error_with_source<ReadError>(std::move(accepted.error()),
+                                                         ReadError::InvalidArgument);
     }
+
+    co_return result;
 }
 
 } // namespace bxt::Persistence::Box
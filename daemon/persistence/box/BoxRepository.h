@@ -14,6 +14,7 @@
 #include "coro/task.hpp"
 #include "persistence/box/BoxOptions.h"
 #include "persistence/box/export/ExporterBase.h"
+#include "persistence/box/files/FileListExtractor.h"
 #include "persistence/box/store/PackageStoreBase.h"
 #include "persistence/box/writeback/WritebackScheduler.h"
 #include "utilities/alpmdb/Database.h"
@@ -30,7 +31,8 @@ public:
     BoxRepository(BoxOptions options,
                   PackageStoreBase& package_store,
                   WritebackScheduler& writeback_sceduler,
-                  ExporterBase& exporter);
+                  ExporterBase& exporter,
+                  FileListExtractor& file_list_extractor);
 
     coro::task<TResult> find_by_id_async(TId id, std::shared_ptr<UnitOfWorkBase> uow) override;
     coro::task<TResult> find_first_async(std::function<bool(Package const&)>,
@@ -65,14 +67,26 @@ public:
                                               Name const name,
                                               std::shared_ptr<UnitOfWorkBase> uow) override;
 
+    coro::task<ReadResult<VersionSnapshot>>
+        find_versions_by_section_async(Section const section,
+                                       std::shared_ptr<UnitOfWorkBase> uow) override;
+
+    coro::task<WriteResult<void>>
+        delete_location_async(std::vector<TId> const ids,
+                              Core::Domain::PoolLocation const location,
+                              std::shared_ptr<UnitOfWorkBase> uow) override;
+
 private:
     void make_writeback_hook(Section const section, std::shared_ptr<UnitOfWorkBase> uow);
+    void make_file_list_hook(std::vector<Package> const& packages,
+                             std::shared_ptr<UnitOfWorkBase> uow);
     BoxOptions m_options;
 
     PackageStoreBase& m_package_store;
 
     ExporterBase& m_exporter;
     WritebackScheduler& m_scheduler;
+    FileListExtractor& m_file_list_extractor;
 
     std::filesystem::path m_root_path;
 };
@@ -76,7 +76,7 @@ AlpmDBExporter::AlpmDBExporter(BoxOptions& box_options,
 }
 
 coro::task<void> AlpmDBExporter::export_to_disk() {
-    phmap::parallel_flat_hash_map<PackageSectionDTO, Archive::Writer> writers;
+    phmap::parallel_flat_hash_map<PackageSectionDTO, Writers> writers;
 
     for (auto const& section : m_dirty_sections) {
         logi("Exporter: \"{}\" export into the package manager format started",
@@ -88,16 +88,17 @@ coro::task<void> AlpmDBExporter::export_to_disk() {
             co_return;
         }
 
-        auto writer = setup_alpmdb_writer(section);
+        auto db_writer = setup_alpmdb_writer(section, "db");
+        auto files_writer = setup_alpmdb_writer(section, "files");
 
-        if (!writer.has_value()) {
+        if (!db_writer.has_value() || !files_writer.has_value()) {
             logf("Exporter: Writer cannot be created, the error is \"{}\". "
                  "Stopping...",
-                 writer.error().what());
+                 (db_writer.has_value() ? files_writer : db_writer).error().what());
             co_return;
         }
 
-        writers.emplace(section, std::move(*writer));
+        writers.emplace(section, Writers {std::move(*db_writer), std::move(*files_writer)});
 
         co_await m_package_store.accept(
             [this, writer = &writers.at(section)](std::string_view key,
@@ -122,9 +123,9 @@ void AlpmDBExporter::add_dirty_sections(std::set<Core::Application::PackageSecti
     m_dirty_sections.insert(std::make_move_iterator(sections.begin()),
                             std::make_move_iterator(sections.end()));
 }
-// Factory function for ALPM .db archive writer
+// Factory function for ALPM .db and .files archive writers
 std::expected<Archive::Writer, bxt::Error>
-    AlpmDBExporter::setup_alpmdb_writer(PackageSectionDTO const& section) {
+    AlpmDBExporter::setup_alpmdb_writer(PackageSectionDTO const& section, std::string_view kind) {
     Archive::Writer writer;
 
     if (archive_write_add_filter_zstd(writer) < ARCHIVE_WARN) {
@@ -134,15 +135,15 @@ std::expected<Archive::Writer, bxt::Error>
         return bxt::make_error<Archive::LibArchiveError>(std::move(writer));
     }
 
-    auto const archive_path =
-        m_box_path / std::string(section) / fmt::format("{}.db.tar.zst", section.repository);
+    auto const archive_path = m_box_path / std::string(section)
+                              / fmt::format("{}.{}.tar.zst", section.repository, kind);
 
     if (auto open_ok = writer.open_filename(archive_path); !open_ok) {
         return std::unexpected(std::move(open_ok.error()));
     }
 
     auto const archive_link =
-        m_box_path / std::string(section) / fmt::format("{}.db", section.repository);
+        m_box_path / std::string(section) / fmt::format("{}.{}", section.repository, kind);
 
     if (auto link_created_ok = create_relative_symlink(archive_path, archive_link);
         !link_created_ok) {
@@ -217,20 +218,33 @@ std::expected<PackageDetails, std::string> validate_package_key(std::string_view
 }
 
 // Writes the contents of package description file to section's ALPM Database
-// archive
+// archive, and to the files archive along with the file list once it's known
 std::expected<void, std::string> write_package_description_to_alpmdb(Archive::Writer& alpmdb_writer,
+                                                                     Archive::Writer& files_writer,
                                                                      PackageDetails const& details,
                                                                      PackageRecord const& package) {
+    using Utilities::AlpmDb::DatabaseUtils::write_buffer_to_archive;
+
     auto const& [section, name, version, preferred_location] = details;
-    auto desc = package.descriptions.at(preferred_location).descfile.desc;
+    auto const& descfile = package.descriptions.at(preferred_location).descfile;
     auto desc_path = fmt::format("{}-{}/desc", name, version);
 
-    if (auto write_ok = Utilities::AlpmDb::DatabaseUtils::write_buffer_to_archive(alpmdb_writer,
-                                                                                  desc_path, desc);
-        !write_ok) {
+    if (!write_buffer_to_archive(alpmdb_writer, desc_path, descfile.desc)
+        || !write_buffer_to_archive(files_writer, desc_path, descfile.desc)) {
         return std::unexpected(fmt::format("Failed to write description for '{}/{}-{}'.",
                                            std::string(section), name, version));
     }
+
+    if (!descfile.has_files()) {
+        return {};
+    }
+
+    auto files_path = fmt::format("{}-{}/files", name, version);
+
+    if (!write_buffer_to_archive(files_writer, files_path, descfile.files)) {
+        return std::unexpected(fmt::format("Failed to write the file list for '{}/{}-{}'.",
+                                           std::string(section), name, version));
+    }
     return {};
 }
 
@@ -266,7 +280,7 @@ std::expected<void, std::string> symlink_package_files(PackageDetails const& det
 // Exports package into the ALPM repository format by writing it's description
 // into the .db file and symlinking package and signature files for specified
 // section
-std::expected<void, std::string> AlpmDBExporter::export_package(Archive::Writer& writer,
+std::expected<void, std::string> AlpmDBExporter::export_package(Writers& writers,
                                                                 std::string_view key,
                                                                 PackageRecord const& package) {
     auto validated_details = validate_package_key(key, package);
@@ -274,7 +288,8 @@ std::expected<void, std::string> AlpmDBExporter::export_package(Archive::Writer&
         return std::unexpected(validated_details.error());
     }
 
-    auto write_result = write_package_description_to_alpmdb(writer, *validated_details, package);
+    auto write_result =
+        write_package_description_to_alpmdb(writers.db, writers.files, *validated_details, package);
     if (!write_result.has_value()) {
         return std::unexpected(write_result.error());
     }
@@ -38,13 +38,19 @@ public:
     void add_dirty_sections(std::set<Core::Application::PackageSectionDTO>&& override) override;
 
 private:
+    // The package database of a section and the one with the file lists
+    struct Writers {
+        Archive::Writer db;
+        Archive::Writer files;
+    };
+
     std::expected<Archive::Writer, bxt::Error>
-        setup_alpmdb_writer(PackageSectionDTO const& section);
+        setup_alpmdb_writer(PackageSectionDTO const& section, std::string_view kind);
 
     std::expected<void, FsError> cleanup_section(PackageSectionDTO const& section);
 
     std::expected<void, std::string>
-        export_package(Archive::Writer& writer, std::string_view key, PackageRecord const& package);
+        export_package(Writers& writers, std::string_view key, PackageRecord const& package);
 
     std::filesystem::path m_box_path;
     std::set<Core::Application::PackageSectionDTO> m_sections;
@@ -0,0 +1,200 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "FileListExtractor.h"
+
+#include "utilities/alpmdb/Desc.h"
+#include "utilities/log/Logging.h"
+#include "utilities/NavigationAction.h"
+
+#include <algorithm>
+#include <span>
+#include <string_view>
+#include <utility>
+
+namespace bxt::Persistence::Box {
+
+namespace {
+    constexpr std::size_t ExtractionBatchSize = 16;
+} // namespace
+
+FileListExtractor::FileListExtractor(PackageStoreBase& package_store,
+                                     ExporterBase& exporter,
+                                     UnitOfWorkBaseFactory& uow_factory,
+                                     std::shared_ptr<coro::io_scheduler> scheduler)
+    : m_package_store(package_store)
+    , m_exporter(exporter)
+    , m_uow_factory(uow_factory)
+    , m_scheduler(std::move(scheduler)) {
+}
+
+void FileListExtractor::start() {
+    m_scheduler->schedule(scan());
+}
+
+void FileListExtractor::enqueue(std::vector<PackageRecord::Id> package_ids) {
+    {
+        std::lock_guard const lock(m_mutex);
+
+        std::ranges::move(package_ids, std::back_inserter(m_queue));
+
+        if (m_running || m_queue.empty()) {
+            return;
+        }
+        m_running = true;
+    }
+
+    m_scheduler->schedule(run());
+}
+
+coro::task<void> FileListExtractor::scan() {
+    co_await m_scheduler->schedule();
+
+    std::vector<PackageRecord::Id> package_ids;
+    {
+        auto uow = co_await m_uow_factory();
+
+        auto const visited = co_await m_package_store.accept(
+            [&](std::string_view, PackageRecord const& package) {
+                if (std::ranges::any_of(package.descriptions, [](auto const& description) {
+                        return !description.second.descfile.has_files();
+                    })) {
+                    package_ids.emplace_back(package.id);
+                }
+                return Utilities::NavigationAction::Next;
+            },
+            uow);
+
+        if (!visited.has_value()) {
+            loge("Box: Can't look up packages with pending file lists: \"{}\"",
+                 visited.error().what());
+            co_return;
+        }
+    }
+
+    if (!package_ids.empty()) {
+        logi("Box: {} packages have pending file lists", package_ids.size());
+    }
+
+    enqueue(std::move(package_ids));
+}
+
+coro::task<std::vector<FileListExtractor::Job>>
+    FileListExtractor::pending_jobs(std::vector<PackageRecord::Id> const& package_ids) {
+    std::vector<Job> jobs;
+
+    auto uow = co_await m_uow_factory();
+
+    for (auto const& package_id : package_ids) {
+        auto const key = package_id.to_string();
+
+        co_await m_package_store.accept(
+            [&](std::string_view record_key, PackageRecord const& package) {
+                if (record_key != key) {
+                    return Utilities::NavigationAction::Next;
+                }
+
+                for (auto const& [location, description] : package.descriptions) {
+                    if (!description.descfile.has_files()) {
+                        jobs.emplace_back(Job {.package_id = package_id,
+                                               .location = location,
+                                               .filepath = description.filepath});
+                    }
+                }
+                return Utilities::NavigationAction::Stop;
+            },
+            key, uow);
+    }
+
+    co_return jobs;
+}
+
+coro::task<void> FileListExtractor::run() {
+    co_await m_scheduler->schedule();
+
+    while (true) {
+        std::vector<PackageRecord::Id> package_ids;
+        {
+            std::lock_guard const lock(m_mutex);
+
+            if (m_queue.empty()) {
+                m_running = false;
+                co_return;
+            }
+            package_ids.swap(m_queue);
+        }
+
+        for (std::size_t offset = 0; offset < package_ids.size();
+             offset += ExtractionBatchSize) {
+            auto const batch_span = std::span(package_ids).subspan(
+                offset, std::min(ExtractionBatchSize, package_ids.size() - offset));
+
+            auto jobs = co_await pending_jobs({batch_span.begin(), batch_span.end()});
+
+            if (jobs.empty()) {
+                continue;
+            }
+
+            // The read transaction is released at this point, the archives are
+            // decompressed without holding any lock.
+            co_await m_thread_pool.schedule();
+
+            for (auto& job : jobs) {
+                auto files = Utilities::AlpmDb::Desc::extract_files(job.filepath);
+
+                if (!files.has_value()) {
+                    logw("Box: Can't extract the file list of {}: \"{}\"",
+                         job.filepath.string(), files.error().what());
+                    continue;
+                }
+                job.files = std::move(*files);
+            }
+
+            co_await m_scheduler->schedule();
+
+            auto uow = co_await m_uow_factory(true);
+
+            std::set<PackageSectionDTO> sections;
+            for (auto const& job : jobs) {
+                if (job.files.empty()) {
+                    continue;
+                }
+
+                auto const attached = co_await m_package_store.attach_files(
+                    job.package_id, job.location, job.filepath, job.files, uow);
+
+                if (!attached.has_value()) {
+                    if (attached.error().error_type != DatabaseError::ErrorType::EntityNotFound) {
+                        logw("Box: Can't attach the file list to {}: \"{}\"",
+                             job.package_id.to_string(), attached.error().what());
+                    }
+                    continue;
+                }
+
+                if (*attached) {
+                    sections.emplace(job.package_id.section);
+                }
+            }
+
+            if (auto const committed = co_await uow->commit_async(); !committed.has_value()) {
+                logw("Box: Failed to commit extracted file lists: \"{}\"",
+                     committed.error().what());
+                continue;
+            }
+
+            if (sections.empty()) {
+                continue;
+            }
+            logd("Box: Attached file lists in {} sections", sections.size());
+
+            // The .files databases are written by the export
+            m_exporter.add_dirty_sections(std::move(sections));
+            co_await m_exporter.export_to_disk();
+        }
+    }
+}
+
+} // namespace bxt::Persistence::Box
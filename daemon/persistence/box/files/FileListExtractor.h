@@ -0,0 +1,67 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "core/domain/repositories/UnitOfWorkBase.h"
+#include "persistence/box/export/ExporterBase.h"
+#include "persistence/box/record/PackageRecord.h"
+#include "persistence/box/store/PackageStoreBase.h"
+
+#include <coro/io_scheduler.hpp>
+#include <coro/task.hpp>
+#include <coro/thread_pool.hpp>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace bxt::Persistence::Box {
+
+// Fills the file lists of package records in the background. Packages are
+// accepted with the description only, so commit and deploy latency doesn't
+// depend on the package size. Records without a file list (see
+// Desc::has_files) are pending, the sections they got attached to are
+// exported again.
+class FileListExtractor {
+public:
+    FileListExtractor(PackageStoreBase& package_store,
+                      ExporterBase& exporter,
+                      UnitOfWorkBaseFactory& uow_factory,
+                      std::shared_ptr<coro::io_scheduler> scheduler);
+
+    // Enqueues records left pending by a previous run
+    void start();
+
+    void enqueue(std::vector<PackageRecord::Id> package_ids);
+
+private:
+    struct Job {
+        PackageRecord::Id package_id;
+        Core::Domain::PoolLocation location;
+        std::filesystem::path filepath;
+        std::string files;
+    };
+
+    coro::task<void> scan();
+    coro::task<void> run();
+
+    coro::task<std::vector<Job>> pending_jobs(std::vector<PackageRecord::Id> const& package_ids);
+
+    PackageStoreBase& m_package_store;
+    ExporterBase& m_exporter;
+    UnitOfWorkBaseFactory& m_uow_factory;
+    std::shared_ptr<coro::io_scheduler> m_scheduler;
+
+    // Decompression is CPU bound, keep it away from the io_scheduler
+    coro::thread_pool m_thread_pool {coro::thread_pool::options {.thread_count = 1}};
+
+    std::mutex m_mutex;
+    std::vector<PackageRecord::Id> m_queue;
+    bool m_running = false;
+};
+
+} // namespace bxt::Persistence::Box
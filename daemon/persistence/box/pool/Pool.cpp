@@ -16,40 +16,103 @@
 #include "utilities/to_string.h"
 
 #include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <expected>
+#include <fcntl.h>
 #include <filesystem>
 #include <fmt/core.h>
 #include <iterator>
 #include <string>
+#include <string_view>
+#include <sys/stat.h>
 #include <system_error>
+#include <unistd.h>
 #include <vector>
 
+namespace {
+
+// Creates the shard sub-directory of a relative pool path if there is one
+std::expected<void, std::error_code> create_shard_directory(int directory_fd,
+                                                            std::string_view relative_path) {
+    auto const separator = relative_path.rfind('/');
+    if (separator == std::string_view::npos) {
+        return {};
+    }
+
+    std::string const shard(relative_path.substr(0, separator));
+    if (::mkdirat(directory_fd, shard.c_str(), 0755) != 0 && errno != EEXIST) {
+        return std::unexpected(std::error_code(errno, std::system_category()));
+    }
+    return {};
+}
+
+// Moves a file into an open pool directory. Falls back to copy + remove when
+// the source is on another filesystem.
 std::expected<void, std::error_code> move_file(std::filesystem::path const& from,
+                                               int directory_fd,
+                                               std::string const& relative_to,
                                                std::filesystem::path const& to) {
-    std::error_code ec;
+    if (auto const created = create_shard_directory(directory_fd, relative_to); !created) {
+        return created;
+    }
 
-    std::filesystem::rename(from, to, ec);
+    if (::renameat(AT_FDCWD, from.c_str(), directory_fd, relative_to.c_str()) == 0) {
+        return {};
+    }
 
-    // try copy + remove original
-    if (ec) {
-        std::filesystem::copy_file(from.lexically_normal(), to.lexically_normal(),
-                                   std::filesystem::copy_options::overwrite_existing, ec);
-        if (!ec) {
-            std::filesystem::remove(from, ec);
-        }
+    std::error_code ec(errno, std::system_category());
+    if (ec != std::errc::cross_device_link) {
+        return std::unexpected(ec);
+    }
+
+    std::filesystem::copy_file(from.lexically_normal(), to,
+                               std::filesystem::copy_options::overwrite_existing, ec);
+    if (!ec) {
+        std::filesystem::remove(from, ec);
     }
     if (ec.value() != 0) {
         return std::unexpected(ec);
-    } else {
+    }
+    return {};
+}
+
+// Adds another name for a file inside of an open pool directory, the
+// original name is left in place. An already existing target is fine, it
+// happens when several records share the same pool file.
+std::expected<void, std::error_code> link_file(std::filesystem::path const& from,
+                                               int directory_fd,
+                                               std::string const& relative_to,
+                                               std::filesystem::path const& to) {
+    if (auto const created = create_shard_directory(directory_fd, relative_to); !created) {
+        return created;
+    }
+
+    if (::linkat(AT_FDCWD, from.c_str(), directory_fd, relative_to.c_str(), 0) == 0
+        || errno == EEXIST) {
         return {};
     }
+
+    std::error_code ec(errno, std::system_category());
+    if (ec != std::errc::cross_device_link) {
+        return std::unexpected(ec);
+    }
+
+    std::filesystem::copy_file(from, to, std::filesystem::copy_options::skip_existing, ec);
+    if (ec) {
+        return std::unexpected(ec);
+    }
+    return {};
 }
 
+} // namespace
+
 namespace bxt::Persistence::Box {
 
 std::string Pool::format_target_path(Core::Domain::PoolLocation location,
-                                     std::string const& arch,
-                                     std::optional<std::string> const& filename) const {
+                                     std::string const& arch) const {
     std::string template_string = "{location}/{arch}";
 
     if (m_options.templates.contains({arch})) {
@@ -62,12 +125,48 @@ std::string Pool::format_target_path(Core::Domain::PoolLocation location,
         fmt::format(fmt::runtime(template_string),
                     fmt::arg("location", std::string(location_path.data(), location_path.size())),
                     fmt::arg("arch", arch));
-    if (filename) {
-        return std::filesystem::absolute(
-            fmt::format("{}/{}/{}", m_pool_path.string(), prefix, *filename));
-    } else {
-        return std::filesystem::absolute(fmt::format("{}/{}", m_pool_path.string(), prefix));
+
+    return std::filesystem::absolute(fmt::format("{}/{}", m_pool_path.string(), prefix));
+}
+
+std::string Pool::relative_path_for(PoolSharding sharding, std::string_view filename) {
+    // Signatures always live next to their package
+    auto package_filename = filename;
+    if (package_filename.ends_with(".sig")) {
+        package_filename.remove_suffix(4);
+    }
+
+    switch (sharding) {
+    case PoolSharding::NamePrefix:
+        return fmt::format("{}/{}", package_filename.substr(0, 2), filename);
+    case PoolSharding::HashPrefix: {
+        // FNV-1a, the layout must not depend on the standard library used
+        uint32_t hash = 2166136261u;
+        for (auto const character : package_filename) {
+            hash ^= static_cast<uint8_t>(character);
+            hash *= 16777619u;
+        }
+        return fmt::format("{:02x}/{}", hash & 0xffu, filename);
+    }
+    case PoolSharding::None:
+        break;
     }
+    return std::string(filename);
+}
+
+Pool::Directory const* Pool::directory_for(Core::Domain::PoolLocation location,
+                                           std::string const& arch) const {
+    auto const location_it = m_directories.find(location);
+    if (location_it == m_directories.end()) {
+        return nullptr;
+    }
+
+    auto const directory_it = location_it->second.find(arch);
+    if (directory_it == location_it->second.end()) {
+        return nullptr;
+    }
+
+    return &directory_it->second;
 }
 
 Pool::Pool(BoxOptions& box_options,
@@ -104,48 +203,95 @@ Pool::Pool(BoxOptions& box_options,
                      ec.message());
                 exit(1);
             }
+
+            // Resolve the template once, every later path computation is a
+            // plain concatenation with the file name.
+            auto const canonical_target = std::filesystem::canonical(target, ec);
+            if (ec) {
+                loge("Pool: Cannot resolve directory {}, the error is \"{}\". "
+                     "Exiting.",
+                     target, ec.message());
+                exit(1);
+            }
+
+            auto const fd = ::open(canonical_target.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd < 0) {
+                loge("Pool: Cannot open directory {}, the error is \"{}\". "
+                     "Exiting.",
+                     canonical_target.string(), std::strerror(errno));
+                exit(1);
+            }
+
+            auto const sharding_it = m_options.sharding.find(architecture);
+
+            m_directories[location].emplace(
+                architecture,
+                Directory {.prefix = (canonical_target / "").string(),
+                           .fd = fd,
+                           .sharding = sharding_it != m_options.sharding.end()
+                                           ? sharding_it->second
+                                           : PoolSharding::None});
         }
     }
 }
+
+Pool::~Pool() {
+    for (auto const& [location, directories] : m_directories) {
+        for (auto const& [architecture, directory] : directories) {
+            ::close(directory.fd);
+        }
+    }
+}
+
 Pool::Result<PackageRecord> Pool::move_to(PackageRecord const& package) {
     PackageRecord result = package;
-    for (auto& [location, description] : result.descriptions) {
-        std::error_code ec;
-        auto canonical_path = std::filesystem::weakly_canonical(description.filepath, ec);
-        if (ec) {
-            return bxt::make_error<FsError>(ec);
+
+    // Links counted by this call are dropped again if a later file fails
+    std::vector<std::filesystem::path> counted;
+    auto const fail = [&](std::error_code ec) -> Result<PackageRecord> {
+        for (auto const& path : counted) {
+            uncount_link(path);
         }
+        return bxt::make_error<FsError>(ec);
+    };
 
-        std::filesystem::path target = std::filesystem::weakly_canonical(format_target_path(
-            location, package.id.section.architecture, canonical_path.filename().string()));
+    for (auto& [location, description] : result.descriptions) {
+        auto const* directory = directory_for(location, package.id.section.architecture);
+        if (!directory) {
+            return fail(std::make_error_code(std::errc::no_such_file_or_directory));
+        }
 
-        move_file(canonical_path, target);
-        logd("Pool: Moving file from {} to {}", canonical_path.string(), target.string());
+        auto const relative_target =
+            directory->relative_path_for(description.filepath.filename().native());
+        std::filesystem::path const target = directory->prefix + relative_target;
+
+        logd("Pool: Moving file from {} to {}", description.filepath.string(), target.string());
+        count_link(target);
+        counted.emplace_back(target);
+        if (auto const moved =
+                move_file(description.filepath, directory->fd, relative_target, target);
+            !moved) {
+            return fail(moved.error());
+        }
 
         description.filepath = target;
 
-        m_pool_package_link_counts.lazy_emplace_l(
-            target,
-            [&](auto& p) {
-                p.second += 1;
-                logd("Pool: Incrementing link count for {}", target.string());
-            },
-            [&](auto const& ctor) {
-                ctor(target, 1);
-                logd("Pool: Adding new link count for {}", target.string());
-            });
-
         if (!description.signature_path.has_value()) {
             continue;
         }
 
-        std::filesystem::path signature_target =
-            format_target_path(location, package.id.section.architecture,
-                               fmt::format("{}.sig", target.filename().string()));
+        auto const relative_signature_target =
+            directory->relative_path_for(fmt::format("{}.sig", target.filename().string()));
+        std::filesystem::path const signature_target =
+            directory->prefix + relative_signature_target;
 
-        move_file(*description.signature_path, signature_target);
         logd("Pool: Moving signature file from {} to {}", description.signature_path->string(),
              signature_target.string());
+        if (auto const moved = move_file(*description.signature_path, directory->fd,
+                                         relative_signature_target, signature_target);
+            !moved) {
+            return fail(moved.error());
+        }
 
         description.signature_path = signature_target;
     }
@@ -153,44 +299,55 @@ Pool::Result<PackageRecord> Pool::move_to(PackageRecord const& package) {
 }
 
 PoolBase::Result<void> Pool::remove(PackageRecord const& package) {
-    std::error_code ec;
     for (auto const& [location, description] : package.descriptions) {
-        std::error_code ec;
-        auto canonical_path = std::filesystem::weakly_canonical(description.filepath, ec);
-        if (ec) {
-            return bxt::make_error<FsError>(ec);
-        }
+        auto const* directory = directory_for(location, package.id.section.architecture);
+
+        // Paths stored in records are already canonical, files that live in
+        // the resolved pool directory are unlinked relative to it.
+        auto const remove_file = [directory](std::filesystem::path const& path,
+                                             std::error_code& ec) {
+            if (directory && path.native().starts_with(directory->prefix)) {
+                auto const relative_path = path.native().substr(directory->prefix.size());
+                if (::unlinkat(directory->fd, relative_path.c_str(), 0) != 0 && errno != ENOENT) {
+                    ec.assign(errno, std::system_category());
+                }
+                return;
+            }
+            std::filesystem::remove(path, ec);
+        };
 
-        auto has_value = m_pool_package_link_counts.modify_if(canonical_path, [&](auto& count) {
+        auto const& path = description.filepath;
+
+        auto has_value = m_pool_package_link_counts.modify_if(path, [&](auto& count) {
             if (count.second > 0) {
                 count.second -= 1;
-                logd("Pool: Decrementing link count for {}", canonical_path.string());
+                logd("Pool: Decrementing link count for {}", path.string());
             } else {
                 logw("Pool: {} is being removed but the link count already "
                      "was 0. "
                      "Removing anyway.",
-                     canonical_path.string());
+                     path.string());
             }
 
             if (count.second != 0) {
                 return;
             }
 
-            logd("Pool: No more links for {}, removing", canonical_path.string());
+            logd("Pool: No more links for {}, removing", path.string());
 
-            std::filesystem::remove(canonical_path, ec);
+            std::error_code ec;
+            remove_file(path, ec);
             if (ec) {
-                loge("Pool: Failed to remove file {}, error: {}", canonical_path.string(),
-                     ec.message());
+                loge("Pool: Failed to remove file {}, error: {}", path.string(), ec.message());
                 return;
             }
-            logd("Pool: Removed file {}", canonical_path.string());
+            logd("Pool: Removed file {}", path.string());
 
             if (!description.signature_path.has_value()) {
                 return;
             }
 
-            std::filesystem::remove(*description.signature_path, ec);
+            remove_file(*description.signature_path, ec);
             if (ec) {
                 loge("Pool: Failed to remove signature file {}, error: {}",
                      description.signature_path->string(), ec.message());
@@ -199,8 +356,9 @@ PoolBase::Result<void> Pool::remove(PackageRecord const& package) {
             logd("Pool: Removed signature file {}", description.signature_path->string());
         });
 
-        if (has_value && m_pool_package_link_counts[canonical_path] == 0) {
-            m_pool_package_link_counts.erase(canonical_path);
+        if (has_value) {
+            m_pool_package_link_counts.erase_if(path,
+                                                [](auto& count) { return count.second == 0; });
         }
     }
 
@@ -210,18 +368,79 @@ PoolBase::Result<void> Pool::remove(PackageRecord const& package) {
 PoolBase::Result<PackageRecord> Pool::path_for_package(PackageRecord const& package) const {
     PackageRecord result = package;
     for (auto& [location, description] : result.descriptions) {
-        description.filepath = std::filesystem::weakly_canonical(format_target_path(
-            location, package.id.section.architecture, description.filepath.filename().string()));
+        auto const* directory = directory_for(location, package.id.section.architecture);
+        if (!directory) {
+            return bxt::make_error<FsError>(
+                std::make_error_code(std::errc::no_such_file_or_directory));
+        }
+
+        description.filepath = directory->path_for(description.filepath.filename().native());
 
         if (description.signature_path.has_value()) {
-            description.signature_path = std::filesystem::weakly_canonical(format_target_path(
-                location, package.id.section.architecture,
-                fmt::format("{}.sig", description.filepath.filename().string())));
+            description.signature_path = directory->path_for(
+                fmt::format("{}.sig", description.filepath.filename().string()));
         }
     }
     return result;
 }
 
+PoolBase::Result<PackageRecord> Pool::relocate(PackageRecord const& package) {
+    PackageRecord result = package;
+    for (auto& [location, description] : result.descriptions) {
+        auto const* directory = directory_for(location, package.id.section.architecture);
+        if (!directory) {
+            return bxt::make_error<FsError>(
+                std::make_error_code(std::errc::no_such_file_or_directory));
+        }
+
+        auto const filename = description.filepath.filename().string();
+        auto const relative_target = directory->relative_path_for(filename);
+        std::filesystem::path const target = directory->prefix + relative_target;
+
+        if (target != description.filepath) {
+            logd("Pool: Relocating file from {} to {}", description.filepath.string(),
+                 target.string());
+            count_link(target);
+            if (auto const linked =
+                    link_file(description.filepath, directory->fd, relative_target, target);
+                !linked) {
+                uncount_link(target);
+                return bxt::make_error<FsError>(linked.error());
+            }
+
+            description.filepath = target;
+        }
+
+        if (!description.signature_path.has_value()) {
+            continue;
+        }
+
+        auto const relative_signature_target =
+            directory->relative_path_for(fmt::format("{}.sig", filename));
+        std::filesystem::path const signature_target =
+            directory->prefix + relative_signature_target;
+
+        if (signature_target == *description.signature_path) {
+            continue;
+        }
+
+        if (auto const linked = link_file(*description.signature_path, directory->fd,
+                                          relative_signature_target, signature_target);
+            !linked) {
+            return bxt::make_error<FsError>(linked.error());
+        }
+
+        description.signature_path = signature_target;
+    }
+    return result;
+}
+
+void Pool::release_links(PackageRecord const& package) {
+    for (auto const& [location, description] : package.descriptions) {
+        uncount_link(description.filepath);
+    }
+}
+
 void Pool::count_links(PackageRepositoryBase& package_repository) {
     auto packages = coro::sync_wait(package_repository.all_async(coro::sync_wait(m_uow_factory())));
 
@@ -248,4 +467,77 @@ void Pool::count_links(PackageRepositoryBase& package_repository) {
     logd("Pool: Counted links for {} paths", m_pool_package_link_counts.size());
 }
 
+void Pool::count_link(std::filesystem::path const& path) {
+    m_pool_package_link_counts.lazy_emplace_l(
+        path,
+        [&](auto& count) {
+            count.second += 1;
+            logd("Pool: Incrementing link count for {}", path.string());
+        },
+        [&](auto const& ctor) {
+            ctor(path, 1);
+            logd("Pool: Adding new link count for {}", path.string());
+        });
+}
+
+void Pool::uncount_link(std::filesystem::path const& path) {
+    m_pool_package_link_counts.modify_if(path, [](auto& count) {
+        if (count.second > 0) {
+            count.second -= 1;
+        }
+    });
+    m_pool_package_link_counts.erase_if(path, [](auto& count) { return count.second == 0; });
+}
+
+std::filesystem::path Pool::link_owner(std::filesystem::path const& path) {
+    // Signatures are not link counted, they live and die with their package
+    return path.extension() == ".sig" ? path.parent_path() / path.stem() : path;
+}
+
+std::expected<bool, std::error_code>
+    Pool::remove_if_unlinked(std::filesystem::path const& path, dev_t device, ino_t inode) {
+    std::expected<bool, std::error_code> result = false;
+
+    auto const remove_orphan = [&] {
+        struct stat status {};
+        if (::lstat(path.c_str(), &status) != 0 || status.st_dev != device
+            || status.st_ino != inode) {
+            return;
+        }
+
+        if (::unlink(path.c_str()) != 0) {
+            if (errno != ENOENT) {
+                result = std::unexpected(std::error_code(errno, std::system_category()));
+            }
+            return;
+        }
+        result = true;
+    };
+
+    // Both branches run under the submap lock of the owner. An absent owner
+    // gets a zero count for the duration, which is dropped right after.
+    auto const owner = link_owner(path);
+    m_pool_package_link_counts.lazy_emplace_l(
+        owner,
+        [&](auto const& count) {
+            if (count.second == 0) {
+                remove_orphan();
+            }
+        },
+        [&](auto const& ctor) {
+            remove_orphan();
+            ctor(owner, 0);
+        });
+    m_pool_package_link_counts.erase_if(owner, [](auto& count) { return count.second == 0; });
+
+    return result;
+}
+
+bool Pool::is_linked(std::filesystem::path const& path) {
+    bool linked = false;
+    m_pool_package_link_counts.if_contains(path,
+                                           [&](auto const& count) { linked = count.second > 0; });
+    return linked;
+}
+
 } // namespace bxt::Persistence::Box
@@ -15,9 +15,14 @@
 #include "persistence/box/pool/PoolBase.h"
 #include "PoolOptions.h"
 
+#include <expected>
 #include <filesystem>
+#include <mutex>
 #include <parallel_hashmap/phmap.h>
 #include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <system_error>
 
 namespace bxt::Persistence::Box {
 class PackageRecord;
@@ -29,25 +34,91 @@ public:
          ReadOnlyRepositoryBase<Section>& section_repository,
          UnitOfWorkBaseFactory& uow_factory);
 
+    ~Pool();
+
+    Pool(Pool const&) = delete;
+    Pool& operator=(Pool const&) = delete;
+
     PoolBase::Result<PackageRecord> move_to(PackageRecord const& package) override;
 
     PoolBase::Result<void> remove(PackageRecord const& package) override;
 
     PoolBase::Result<PackageRecord> path_for_package(PackageRecord const& package) const override;
 
+    PoolBase::Result<PackageRecord> relocate(PackageRecord const& package) override;
+
+    void release_links(PackageRecord const& package) override;
+
     void count_links(PackageRepositoryBase& package_repository);
 
+    // Returns true if at least one package record references the given
+    // canonical path. Safe to call concurrently with move_to/remove.
+    bool is_linked(std::filesystem::path const& path);
+
+    // Removes a pool file no record links to. The link count is checked and
+    // the file unlinked under the lock move_to counts links with, and only
+    // if it still is the inode the caller inspected. Signatures follow the
+    // count of their package. Returns whether the file was removed.
+    std::expected<bool, std::error_code>
+        remove_if_unlinked(std::filesystem::path const& path, dev_t device, ino_t inode);
+
+    // The path whose link count decides about the file
+    static std::filesystem::path link_owner(std::filesystem::path const& path);
+
+    // Path of a file relative to its pool directory, including the shard if any
+    static std::string relative_path_for(PoolSharding sharding, std::string_view filename);
+
+    std::filesystem::path const& pool_path() const {
+        return m_pool_path;
+    }
+
 private:
+    // Resolved pool directory of a (location, architecture) pair. The
+    // directory is kept open so files can be moved and removed relative to it.
+    struct Directory {
+        std::string prefix; // canonical path with a trailing separator
+        int fd = -1;
+        PoolSharding sharding = PoolSharding::None;
+
+        std::string relative_path_for(std::string_view filename) const {
+            return Pool::relative_path_for(sharding, filename);
+        }
+
+        std::filesystem::path path_for(std::string_view filename) const {
+            return prefix + relative_path_for(filename);
+        }
+    };
+
     std::string format_target_path(Core::Domain::PoolLocation location,
-                                   std::string const& arch,
-                                   std::optional<std::string> const& filename = {}) const;
+                                   std::string const& arch) const;
+
+    // Links are counted before the file is put in place, so the garbage
+    // collector never sees an uncounted file under a linked name
+    void count_link(std::filesystem::path const& path);
+    void uncount_link(std::filesystem::path const& path);
+
+    Directory const* directory_for(Core::Domain::PoolLocation location,
+                                   std::string const& arch) const;
 
     std::filesystem::path m_pool_path;
+    phmap::flat_hash_map<Core::Domain::PoolLocation, phmap::flat_hash_map<std::string, Directory>>
+        m_directories;
     std::set<std::string> m_architectures;
     PoolOptions& m_options;
     UnitOfWorkBaseFactory& m_uow_factory;
 
-    phmap::parallel_flat_hash_map<std::filesystem::path, size_t> m_pool_package_link_counts;
+    // Link counts are read by the background garbage collector, so the map
+    // is guarded by per-submap mutexes.
+    using LinkCountMap = phmap::parallel_flat_hash_map<
+        std::filesystem::path,
+        size_t,
+        phmap::priv::hash_default_hash<std::filesystem::path>,
+        phmap::priv::hash_default_eq<std::filesystem::path>,
+        phmap::priv::Allocator<phmap::priv::Pair<std::filesystem::path const, size_t>>,
+        4,
+        std::mutex>;
+
+    LinkCountMap m_pool_package_link_counts;
 };
 
 } // namespace bxt::Persistence::Box
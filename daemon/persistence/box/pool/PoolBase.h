@@ -25,5 +25,14 @@ struct PoolBase {
     virtual Result<void> remove(PackageRecord const& package) = 0;
 
     virtual Result<PackageRecord> path_for_package(PackageRecord const& package) const = 0;
+
+    // Links the package files under the paths the current layout computes for
+    // them and counts the new names. The previous names are kept, and stay
+    // counted until released, so already exported sections stay valid until
+    // they are re-exported.
+    virtual Result<PackageRecord> relocate(PackageRecord const& package) = 0;
+
+    // Drops the link counts of the package files without removing them
+    virtual void release_links(PackageRecord const& package) = 0;
 };
 } // namespace bxt::Persistence::Box
@@ -0,0 +1,60 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "utilities/configuration/Configuration.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace bxt::Persistence::Box {
+
+struct PoolGCOptions {
+    bool enabled = true;
+
+    // Files younger than this are never collected, so a package that is being
+    // moved into the pool can't be reclaimed before its link is counted.
+    std::chrono::seconds grace_period = std::chrono::hours(24);
+
+    // Delay between two full passes over the pool
+    std::chrono::seconds interval = std::chrono::hours(6);
+
+    // Number of directory entries inspected before yielding to the scheduler
+    std::size_t batch_size = 128;
+    std::chrono::milliseconds batch_delay = std::chrono::seconds(1);
+
+    // Directories that never hold linked files (e.g. the upload directory).
+    // Everything in them older than the grace period is an orphan.
+    std::vector<std::filesystem::path> staging_paths;
+
+    void serialize(Utilities::Configuration& config) {
+        config.set("pool-gc-enabled", enabled);
+        config.set("pool-gc-grace-period", static_cast<int64_t>(grace_period.count()));
+        config.set("pool-gc-interval", static_cast<int64_t>(interval.count()));
+        config.set("pool-gc-batch-size", static_cast<int64_t>(batch_size));
+        config.set("pool-gc-batch-delay", static_cast<int64_t>(batch_delay.count()));
+    }
+    void deserialize(Utilities::Configuration const& config) {
+        enabled = config.get<bool>("pool-gc-enabled").value_or(enabled);
+        grace_period = std::chrono::seconds(
+            config.get<int64_t>("pool-gc-grace-period").value_or(grace_period.count()));
+        interval = std::chrono::seconds(
+            config.get<int64_t>("pool-gc-interval").value_or(interval.count()));
+        batch_size = static_cast<std::size_t>(
+            config.get<int64_t>("pool-gc-batch-size").value_or(batch_size));
+        batch_delay = std::chrono::milliseconds(
+            config.get<int64_t>("pool-gc-batch-delay").value_or(batch_delay.count()));
+
+        if (batch_size == 0) {
+            batch_size = 1;
+        }
+    }
+};
+
+} // namespace bxt::Persistence::Box
@@ -0,0 +1,192 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "PoolGarbageCollector.h"
+
+#include "utilities/log/Logging.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace bxt::Persistence::Box {
+
+namespace {
+    // Renames update ctime but keep mtime, so a cached download that was just
+    // moved into the pool still counts as fresh.
+    bool is_fresh(struct stat const& status, std::chrono::seconds grace_period) {
+        auto const changed_at = std::chrono::system_clock::from_time_t(
+            std::max(status.st_mtim.tv_sec, status.st_ctim.tv_sec));
+
+        return std::chrono::system_clock::now() - changed_at < grace_period;
+    }
+} // namespace
+
+PoolGarbageCollector::PoolGarbageCollector(PoolGCOptions& options,
+                                           Pool& pool,
+                                           std::shared_ptr<coro::io_scheduler> scheduler)
+    : m_options(options)
+    , m_pool(pool)
+    , m_scheduler(std::move(scheduler)) {
+}
+
+PoolGarbageCollector::GarbageCollectionStats
+    PoolGarbageCollector::garbage_collection_stats() const {
+    return {.passes = m_stats.passes.load(),
+            .scanned_files = m_stats.scanned_files.load(),
+            .reclaimed_files = m_stats.reclaimed_files.load(),
+            .reclaimed_bytes = m_stats.reclaimed_bytes.load()};
+}
+
+void PoolGarbageCollector::start() {
+    if (!m_options.enabled) {
+        logi("Pool GC: Disabled by configuration");
+        return;
+    }
+
+    if (m_started.exchange(true)) {
+        return;
+    }
+
+    m_scheduler->schedule(run());
+}
+
+coro::task<void> PoolGarbageCollector::run() {
+    co_await m_scheduler->schedule();
+
+    while (true) {
+        auto const started_at = std::chrono::steady_clock::now();
+        auto const reclaimed_files = m_stats.reclaimed_files.load();
+        auto const reclaimed_bytes = m_stats.reclaimed_bytes.load();
+
+        co_await pass();
+
+        logi("Pool GC: Pass finished in {}s, reclaimed {} files ({} bytes). "
+             "Total: {} files scanned, {} files ({} bytes) reclaimed",
+             std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now()
+                                                              - started_at)
+                 .count(),
+             m_stats.reclaimed_files.load() - reclaimed_files,
+             m_stats.reclaimed_bytes.load() - reclaimed_bytes, m_stats.scanned_files.load(),
+             m_stats.reclaimed_files.load(), m_stats.reclaimed_bytes.load());
+
+        co_await m_scheduler->schedule_after(m_options.interval);
+    }
+}
+
+coro::task<void> PoolGarbageCollector::pass() {
+    co_await collect(m_pool.pool_path(), false);
+
+    for (auto const& staging_path : m_options.staging_paths) {
+        co_await collect(staging_path, true);
+    }
+
+    m_stats.passes += 1;
+}
+
+coro::task<void> PoolGarbageCollector::collect(std::filesystem::path const& root, bool staging) {
+    std::error_code ec;
+
+    // Link counts are keyed by canonical paths, walking from the canonical
+    // root yields comparable paths without resolving every entry.
+    auto const canonical_root = std::filesystem::canonical(root, ec);
+    if (ec) {
+        logd("Pool GC: Skipping {}, the reason is \"{}\"", root.string(), ec.message());
+        co_return;
+    }
+
+    std::filesystem::recursive_directory_iterator iterator(
+        canonical_root, std::filesystem::directory_options::skip_permission_denied, ec);
+
+    std::size_t batch_count = 0;
+    for (; !ec && iterator != std::filesystem::recursive_directory_iterator();
+         iterator.increment(ec)) {
+        if (++batch_count >= m_options.batch_size) {
+            batch_count = 0;
+            co_await m_scheduler->schedule_after(m_options.batch_delay);
+        }
+
+        std::error_code status_ec;
+        if (!iterator->is_regular_file(status_ec) || iterator->is_symlink(status_ec)) {
+            continue;
+        }
+
+        inspect(iterator->path(), staging);
+    }
+
+    if (ec) {
+        logw("Pool GC: Walking {} stopped early, the reason is \"{}\"", canonical_root.string(),
+             ec.message());
+    }
+
+    if (staging) {
+        remove_empty_directories(canonical_root);
+    }
+}
+
+void PoolGarbageCollector::remove_empty_directories(std::filesystem::path const& root) {
+    std::error_code ec;
+    for (auto const& entry : std::filesystem::directory_iterator(root, ec)) {
+        std::error_code status_ec;
+        if (!entry.is_directory(status_ec) || entry.is_symlink(status_ec)) {
+            continue;
+        }
+
+        struct stat status {};
+        if (::lstat(entry.path().c_str(), &status) != 0
+            || is_fresh(status, m_options.grace_period)) {
+            continue;
+        }
+
+        // Fails for directories that still have files in them
+        if (::rmdir(entry.path().c_str()) == 0) {
+            logd("Pool GC: Removed empty staging directory {}", entry.path().string());
+        }
+    }
+}
+
+void PoolGarbageCollector::inspect(std::filesystem::path const& path, bool staging) {
+    m_stats.scanned_files += 1;
+
+    struct stat status {};
+    if (::lstat(path.c_str(), &status) != 0) {
+        return;
+    }
+
+    if (is_fresh(status, m_options.grace_period)) {
+        return;
+    }
+
+    if (staging) {
+        std::error_code ec;
+        if (!std::filesystem::remove(path, ec) || ec) {
+            logw("Pool GC: Failed to remove orphan {}, the reason is \"{}\"", path.string(),
+                 ec.message());
+            return;
+        }
+    } else {
+        // A package moved onto this path since the lstat above keeps it
+        auto const removed = m_pool.remove_if_unlinked(path, status.st_dev, status.st_ino);
+        if (!removed.has_value()) {
+            logw("Pool GC: Failed to remove orphan {}, the reason is \"{}\"", path.string(),
+                 removed.error().message());
+            return;
+        }
+        if (!*removed) {
+            return;
+        }
+    }
+
+    m_stats.reclaimed_files += 1;
+    m_stats.reclaimed_bytes += static_cast<uint64_t>(status.st_size);
+
+    logd("Pool GC: Reclaimed orphan {} ({} bytes)", path.string(), status.st_size);
+}
+
+} // namespace bxt::Persistence::Box
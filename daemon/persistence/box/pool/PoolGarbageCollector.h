@@ -0,0 +1,69 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "core/application/services/PoolGarbageCollectionService.h"
+#include "persistence/box/pool/Pool.h"
+#include "persistence/box/pool/PoolGCOptions.h"
+
+#include <atomic>
+#include <coro/io_scheduler.hpp>
+#include <coro/task.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+namespace bxt::Persistence::Box {
+
+// Reclaims pool files that are not referenced by any package record anymore
+// (e.g. leftovers of failed moves, crashes between the LMDB commit and
+// Pool::remove or interrupted uploads). The pool is walked incrementally in
+// small batches on the io_scheduler so request handling is never stalled.
+class PoolGarbageCollector : public Core::Application::PoolGarbageCollectionService {
+public:
+    struct Stats {
+        std::atomic<uint64_t> passes = 0;
+        std::atomic<uint64_t> scanned_files = 0;
+        std::atomic<uint64_t> reclaimed_files = 0;
+        std::atomic<uint64_t> reclaimed_bytes = 0;
+    };
+
+    PoolGarbageCollector(PoolGCOptions& options,
+                         Pool& pool,
+                         std::shared_ptr<coro::io_scheduler> scheduler);
+
+    void start();
+
+    // One walk over the pool and the staging paths
+    coro::task<void> pass();
+
+    Stats const& stats() const {
+        return m_stats;
+    }
+
+    GarbageCollectionStats garbage_collection_stats() const override;
+
+private:
+    coro::task<void> run();
+
+    coro::task<void> collect(std::filesystem::path const& root, bool staging);
+
+    void inspect(std::filesystem::path const& path, bool staging);
+
+    // Uploads are staged in a directory per request, left empty once the
+    // files were moved into the pool
+    void remove_empty_directories(std::filesystem::path const& root);
+
+    PoolGCOptions& m_options;
+    Pool& m_pool;
+    std::shared_ptr<coro::io_scheduler> m_scheduler;
+
+    std::atomic<bool> m_started = false;
+    Stats m_stats;
+};
+
+} // namespace bxt::Persistence::Box
@@ -0,0 +1,190 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "PoolLayoutMigrator.h"
+
+#include "persistence/box/record/PackageRecord.h"
+#include "utilities/log/Logging.h"
+#include "utilities/NavigationAction.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <nonstd/scope.hpp>
+#include <optional>
+#include <set>
+#include <span>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+namespace bxt::Persistence::Box {
+
+namespace {
+    constexpr std::size_t RelocationBatchSize = 256;
+    constexpr auto RelocationBatchDelay = std::chrono::milliseconds(100);
+
+    void collect_paths(PackageRecord const& package, std::vector<std::filesystem::path>& paths) {
+        for (auto const& [location, description] : package.descriptions) {
+            paths.emplace_back(description.filepath);
+            if (description.signature_path.has_value()) {
+                paths.emplace_back(*description.signature_path);
+            }
+        }
+    }
+} // namespace
+
+PoolLayoutMigrator::PoolLayoutMigrator(PackageStoreBase& package_store,
+                                       Pool& pool,
+                                       ExporterBase& exporter,
+                                       UnitOfWorkBaseFactory& uow_factory,
+                                       std::shared_ptr<coro::io_scheduler> scheduler)
+    : m_package_store(package_store)
+    , m_pool(pool)
+    , m_exporter(exporter)
+    , m_uow_factory(uow_factory)
+    , m_scheduler(std::move(scheduler)) {
+}
+
+coro::task<PoolLayoutMigrator::Result<void>> PoolLayoutMigrator::migrate_layout() {
+    if (m_running.exchange(true)) {
+        co_return bxt::make_error<CrudError>(CrudError::ErrorType::EntityAlreadyExists);
+    }
+
+    m_finished.reset();
+    m_scheduler->schedule(run());
+
+    co_return {};
+}
+
+coro::task<void> PoolLayoutMigrator::run() {
+    co_await m_scheduler->schedule();
+
+    auto const running = nonstd::make_scope_exit([this] {
+        m_running = false;
+        m_finished.set();
+    });
+
+    std::vector<PackageRecord::Id> package_ids;
+    std::set<PackageSectionDTO> sections;
+    {
+        auto uow = co_await m_uow_factory();
+
+        auto const visited = co_await m_package_store.accept(
+            [&](std::string_view key, PackageRecord const&) {
+                if (auto id = PackageRecord::Id::from_string(key); id.has_value()) {
+                    sections.emplace(id->section);
+                    package_ids.emplace_back(std::move(*id));
+                }
+                return Utilities::NavigationAction::Next;
+            },
+            uow);
+
+        if (!visited.has_value()) {
+            loge("Pool: Layout migration failed, can't list packages: \"{}\"",
+                 visited.error().what());
+            co_return;
+        }
+    }
+
+    logi("Pool: Layout migration started for {} packages", package_ids.size());
+
+    // The previous names stay linked until every section is exported against
+    // the new layout, so downloads keep working during the migration.
+    std::vector<std::filesystem::path> previous_paths;
+    std::size_t relocated_count = 0;
+
+    for (std::size_t offset = 0; offset < package_ids.size(); offset += RelocationBatchSize) {
+        auto const batch = std::span(package_ids).subspan(
+            offset, std::min(RelocationBatchSize, package_ids.size() - offset));
+
+        auto uow = co_await m_uow_factory(true);
+
+        std::vector<PackageStoreBase::Relocation> relocations;
+        for (auto const& package_id : batch) {
+            auto relocated = co_await m_package_store.relocate(package_id, uow);
+
+            if (!relocated.has_value()) {
+                // Packages deleted since the listing are simply skipped
+                if (relocated.error().error_type != DatabaseError::ErrorType::EntityNotFound) {
+                    logw("Pool: Can't relocate {}: \"{}\"", package_id.to_string(),
+                         relocated.error().what());
+                }
+                continue;
+            }
+
+            if (relocated->has_value()) {
+                relocations.emplace_back(std::move(**relocated));
+            }
+        }
+
+        std::optional<std::string> commit_error;
+        try {
+            if (auto const committed = co_await uow->commit_async(); !committed.has_value()) {
+                commit_error = committed.error().what();
+            }
+        } catch (std::exception const& e) {
+            commit_error = e.what();
+        }
+
+        // The records keep their previous names, the new ones go again
+        if (commit_error.has_value()) {
+            logw("Pool: Layout migration batch at {} failed to commit: \"{}\"", offset,
+                 *commit_error);
+
+            std::vector<std::filesystem::path> linked_paths;
+            for (auto const& relocation : relocations) {
+                m_pool.release_links(relocation.linked);
+                collect_paths(relocation.linked, linked_paths);
+            }
+            remove_unlinked(linked_paths);
+            continue;
+        }
+
+        relocated_count += relocations.size();
+        for (auto const& relocation : relocations) {
+            collect_paths(relocation.previous, previous_paths);
+        }
+
+        logd("Pool: Layout migration progress {}/{}", offset + batch.size(), package_ids.size());
+
+        co_await m_scheduler->schedule_after(RelocationBatchDelay);
+    }
+
+    // Exporting every section also repairs symlinks left by an interrupted
+    // earlier migration.
+    m_exporter.add_dirty_sections(std::move(sections));
+    co_await m_exporter.export_to_disk();
+
+    auto const removed_count = remove_unlinked(previous_paths);
+
+    logi("Pool: Layout migration finished, {} packages relocated, {} old files removed",
+         relocated_count, removed_count);
+}
+
+std::size_t PoolLayoutMigrator::remove_unlinked(std::vector<std::filesystem::path> const& paths) {
+    std::size_t removed_count = 0;
+    for (auto const& path : paths) {
+        struct stat status {};
+        if (::lstat(path.c_str(), &status) != 0) {
+            continue;
+        }
+
+        // Another record may have moved a package onto the name meanwhile
+        auto const removed = m_pool.remove_if_unlinked(path, status.st_dev, status.st_ino);
+        if (!removed.has_value()) {
+            logw("Pool: Can't remove {}: \"{}\"", path.string(), removed.error().message());
+            continue;
+        }
+        if (*removed) {
+            removed_count += 1;
+        }
+    }
+    return removed_count;
+}
+
+} // namespace bxt::Persistence::Box
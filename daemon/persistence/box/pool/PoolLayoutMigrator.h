@@ -0,0 +1,62 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "core/application/services/PoolMaintenanceService.h"
+#include "core/domain/repositories/UnitOfWorkBase.h"
+#include "persistence/box/export/ExporterBase.h"
+#include "persistence/box/pool/Pool.h"
+#include "persistence/box/store/PackageStoreBase.h"
+
+#include <atomic>
+#include <coro/event.hpp>
+#include <coro/io_scheduler.hpp>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace bxt::Persistence::Box {
+
+// Moves existing pool files to the configured layout (e.g. after sharding
+// was enabled). Records are relocated in small write transactions, so regular
+// commits interleave with the migration.
+class PoolLayoutMigrator : public Core::Application::PoolMaintenanceService {
+public:
+    PoolLayoutMigrator(PackageStoreBase& package_store,
+                       Pool& pool,
+                       ExporterBase& exporter,
+                       UnitOfWorkBaseFactory& uow_factory,
+                       std::shared_ptr<coro::io_scheduler> scheduler);
+
+    coro::task<Result<void>> migrate_layout() override;
+
+    bool is_running() const {
+        return m_running;
+    }
+
+    // Completes once the running migration, if any, has finished
+    coro::task<void> wait_until_finished() {
+        co_await m_finished;
+    }
+
+private:
+    coro::task<void> run();
+
+    // Removes the files no record links anymore, returns their count
+    std::size_t remove_unlinked(std::vector<std::filesystem::path> const& paths);
+
+    PackageStoreBase& m_package_store;
+    Pool& m_pool;
+    ExporterBase& m_exporter;
+    UnitOfWorkBaseFactory& m_uow_factory;
+    std::shared_ptr<coro::io_scheduler> m_scheduler;
+
+    std::atomic<bool> m_running = false;
+    coro::event m_finished {true};
+};
+
+} // namespace bxt::Persistence::Box
@@ -8,14 +8,26 @@
 #pragma once
 
 #include "parallel_hashmap/phmap.h"
+#include "utilities/log/Logging.h"
 #include "utilities/repo-schema/SchemaExtension.h"
 
 #include <string>
 #include <yaml-cpp/yaml.h>
 
 namespace bxt::Persistence::Box {
+
+// Optional sub-directory layout inside of a pool directory. Large flat
+// directories are slow to look up and list, sharding spreads the files over
+// up to 256 sub-directories.
+enum class PoolSharding {
+    None,
+    NamePrefix, // first two characters of the package name
+    HashPrefix // hash bucket of the package file name
+};
+
 struct PoolOptions : public Utilities::RepoSchema::Extension {
     phmap::flat_hash_map<std::string, std::string> templates;
+    phmap::flat_hash_map<std::string, PoolSharding> sharding;
 
     void parse(const YAML::Node& root_node) override {
         constexpr char Tag[] = "(box.pool)";
@@ -35,6 +47,19 @@ struct PoolOptions : public Utilities::RepoSchema::Extension {
             auto const template_string = pool_options["template"].as<std::string>();
 
             templates.emplace(architecture, template_string);
+
+            if (pool_options["sharding"].IsDefined() && pool_options["sharding"].IsScalar()) {
+                auto const sharding_string = pool_options["sharding"].as<std::string>();
+
+                if (sharding_string == "name") {
+                    sharding.emplace(architecture, PoolSharding::NamePrefix);
+                } else if (sharding_string == "hash") {
+                    sharding.emplace(architecture, PoolSharding::HashPrefix);
+                } else if (sharding_string != "none") {
+                    logw("Pool: Unknown sharding \"{}\" for {}, the pool stays flat",
+                         sharding_string, architecture);
+                }
+            }
         }
     }
 };
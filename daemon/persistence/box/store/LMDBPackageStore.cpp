@@ -11,14 +11,32 @@
 #include "persistence/box/pool/PoolBase.h"
 #include "persistence/box/record/PackageRecord.h"
 #include "persistence/lmdb/LmdbUnitOfWork.h"
+#include "utilities/log/Logging.h"
 #include "utilities/to_string.h"
 
+#include <algorithm>
 #include <filesystem>
 #include <memory>
 #include <string>
 
 namespace bxt::Persistence::Box {
 
+namespace {
+    // The descriptions of `package` whose file is not the one of `other`
+    PackageRecord changed_descriptions(PackageRecord const& package, PackageRecord const& other) {
+        PackageRecord result {.id = package.id,
+                              .is_any_architecture = package.is_any_architecture};
+        for (auto const& [location, description] : package.descriptions) {
+            auto const other_description = other.descriptions.find(location);
+            if (other_description == other.descriptions.end()
+                || other_description->second.filepath != description.filepath) {
+                result.descriptions.emplace(location, description);
+            }
+        }
+        return result;
+    }
+} // namespace
+
 LMDBPackageStore::LMDBPackageStore(BoxOptions& box_options,
                                    std::shared_ptr<Utilities::LMDB::Environment> env,
                                    PoolBase& pool,
@@ -66,8 +84,12 @@ coro::task<std::expected<void, DatabaseError>>
             std::move(result.error()), DatabaseError::ErrorType::InvalidArgument);
     }
 
-    lmdb_uow->pre_hook(
-        [this, package = std::move(package)] { m_pool.move_to(std::move(package)); });
+    lmdb_uow->pre_hook([this, package = std::move(package)] {
+        if (auto const moved = m_pool.move_to(package); !moved.has_value()) {
+            loge("Box: Failed to move {} to the pool, the reason is \"{}\"",
+                 package.id.to_string(), moved.error().what());
+        }
+    });
 
     co_return {};
 }
@@ -107,6 +129,52 @@ coro::task<std::expected<void, DatabaseError>>
     co_return {};
 }
 
+coro::task<std::expected<bool, DatabaseError>>
+    LMDBPackageStore::remove_location(PackageRecord::Id const package_id,
+                                      Core::Domain::PoolLocation const location,
+                                      std::shared_ptr<UnitOfWorkBase> uow) {
+    auto lmdb_uow = std::dynamic_pointer_cast<LmdbUnitOfWork>(uow);
+    if (!lmdb_uow) {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    auto const key = package_id.to_string();
+
+    // A package removed meanwhile doesn't have the location either
+    auto package = co_await m_db.get(lmdb_uow->txn().value, key);
+    if (!package.has_value()) {
+        if (package.error().error_type == DatabaseError::ErrorType::EntityNotFound) {
+            co_return false;
+        }
+        co_return std::unexpected(std::move(package.error()));
+    }
+
+    auto const description = package->descriptions.find(location);
+    if (description == package->descriptions.end()) {
+        co_return false;
+    }
+
+    PackageRecord removed {.id = package->id,
+                           .is_any_architecture = package->is_any_architecture,
+                           .descriptions = {*description}};
+    package->descriptions.erase(description);
+
+    auto result = package->descriptions.empty()
+                      ? co_await m_db.del(lmdb_uow->txn().value, key)
+                      : co_await m_db.put(lmdb_uow->txn().value, key, *package);
+
+    if (!result.has_value()) {
+        co_return bxt::make_error_with_source<DatabaseError>(
+            std::move(result.error()), DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    lmdb_uow->pre_hook([this, removed = std::move(removed)] {
+        return m_pool.remove(removed).has_value();
+    });
+
+    co_return true;
+}
+
 coro::task<std::expected<void, DatabaseError>>
     LMDBPackageStore::update(PackageRecord const package, std::shared_ptr<UnitOfWorkBase> uow) {
     auto section =
@@ -158,12 +226,122 @@ coro::task<std::expected<void, DatabaseError>>
             }
         }
 
-        m_pool.move_to(std::move(tmp_package));
+        if (auto const moved = m_pool.move_to(tmp_package); !moved.has_value()) {
+            loge("Box: Failed to move {} to the pool, the reason is \"{}\"",
+                 package.id.to_string(), moved.error().what());
+        }
     });
 
     co_return {};
 }
 
+coro::task<std::expected<std::optional<PackageStoreBase::Relocation>, DatabaseError>>
+    LMDBPackageStore::relocate(PackageRecord::Id const package_id,
+                               std::shared_ptr<UnitOfWorkBase> uow) {
+    auto lmdb_uow = std::dynamic_pointer_cast<LmdbUnitOfWork>(uow);
+    if (!lmdb_uow) {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    auto const key = package_id.to_string();
+
+    auto existing_package = co_await m_db.get(lmdb_uow->txn().value, key);
+    if (!existing_package.has_value()) {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::EntityNotFound);
+    }
+
+    auto relocated_package = m_pool.path_for_package(*existing_package);
+    if (!relocated_package.has_value()) {
+        co_return bxt::make_error_with_source<DatabaseError>(
+            std::move(relocated_package.error()), DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    auto const unchanged =
+        std::ranges::all_of(relocated_package->descriptions, [&](auto const& entry) {
+            auto const& existing = existing_package->descriptions.at(entry.first);
+            return existing.filepath == entry.second.filepath
+                   && existing.signature_path == entry.second.signature_path;
+        });
+
+    if (unchanged) {
+        co_return std::nullopt;
+    }
+
+    // The record only points to the new names once they exist
+    auto linked_package = m_pool.relocate(*existing_package);
+    if (!linked_package.has_value()) {
+        co_return bxt::make_error_with_source<DatabaseError>(
+            std::move(linked_package.error()), DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    auto linked = changed_descriptions(*linked_package, *existing_package);
+
+    auto result = co_await m_db.put(lmdb_uow->txn().value, key, *linked_package);
+
+    if (!result.has_value()) {
+        m_pool.release_links(linked);
+        co_return bxt::make_error_with_source<DatabaseError>(
+            std::move(result.error()), DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    // The previous names stay counted until nothing can read them anymore
+    lmdb_uow->post_hook(
+        [this, previous = changed_descriptions(*existing_package, *linked_package)] {
+            m_pool.release_links(previous);
+        });
+
+    co_return Relocation {.previous = std::move(*existing_package), .linked = std::move(linked)};
+}
+
+coro::task<std::expected<bool, DatabaseError>>
+    LMDBPackageStore::attach_files(PackageRecord::Id const package_id,
+                                   Core::Domain::PoolLocation const location,
+                                   std::filesystem::path const filepath,
+                                   std::string const files,
+                                   std::shared_ptr<UnitOfWorkBase> uow) {
+    auto lmdb_uow = std::dynamic_pointer_cast<LmdbUnitOfWork>(uow);
+    if (!lmdb_uow) {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    auto const key = package_id.to_string();
+
+    // EntityNotFound for a package removed while the list was extracted
+    auto package = co_await m_db.get(lmdb_uow->txn().value, key);
+    if (!package.has_value()) {
+        co_return std::unexpected(std::move(package.error()));
+    }
+
+    // The package might have been replaced while the list was extracted
+    auto description = package->descriptions.find(location);
+    if (description == package->descriptions.end()
+        || description->second.filepath != filepath) {
+        co_return false;
+    }
+
+    description->second.descfile.files = files;
+
+    auto result = co_await m_db.put(lmdb_uow->txn().value, key, *package);
+
+    if (!result.has_value()) {
+        co_return bxt::make_error_with_source<DatabaseError>(
+            std::move(result.error()), DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    co_return true;
+}
+
+coro::task<std::expected<PackageRecord, DatabaseError>>
+    LMDBPackageStore::find_by_id(PackageRecord::Id const package_id,
+                                 std::shared_ptr<UnitOfWorkBase> uow) {
+    auto lmdb_uow = std::dynamic_pointer_cast<LmdbUnitOfWork>(uow);
+    if (!lmdb_uow) {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+
+    co_return co_await m_db.get(lmdb_uow->txn().value, package_id.to_string());
+}
+
 coro::task<std::expected<std::vector<PackageRecord>, DatabaseError>>
     LMDBPackageStore::find_by_section(PackageSectionDTO section,
                                       std::shared_ptr<UnitOfWorkBase> uow) {
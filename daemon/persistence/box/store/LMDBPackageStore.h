@@ -47,6 +47,26 @@ public:
     coro::task<std::expected<void, DatabaseError>>
         update(PackageRecord const package, std::shared_ptr<UnitOfWorkBase> uow) override;
 
+    coro::task<std::expected<bool, DatabaseError>>
+        remove_location(PackageRecord::Id const package_id,
+                        Core::Domain::PoolLocation const location,
+                        std::shared_ptr<UnitOfWorkBase> uow) override;
+
+    coro::task<std::expected<std::optional<Relocation>, DatabaseError>>
+        relocate(PackageRecord::Id const package_id,
+                 std::shared_ptr<UnitOfWorkBase> uow) override;
+
+    coro::task<std::expected<bool, DatabaseError>>
+        attach_files(PackageRecord::Id const package_id,
+                     Core::Domain::PoolLocation const location,
+                     std::filesystem::path const filepath,
+                     std::string const files,
+                     std::shared_ptr<UnitOfWorkBase> uow) override;
+
+    coro::task<std::expected<PackageRecord, DatabaseError>>
+        find_by_id(PackageRecord::Id const package_id,
+                   std::shared_ptr<UnitOfWorkBase> uow) override;
+
     coro::task<std::expected<std::vector<PackageRecord>, DatabaseError>>
         find_by_section(PackageSectionDTO section, std::shared_ptr<UnitOfWorkBase> uow) override;
 
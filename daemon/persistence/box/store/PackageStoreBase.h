@@ -15,9 +15,18 @@
 #include "utilities/NavigationAction.h"
 
 #include <coro/task.hpp>
+#include <optional>
 
 namespace bxt::Persistence::Box {
 struct PackageStoreBase {
+    // A record pointed to the current pool layout
+    struct Relocation {
+        PackageRecord previous;
+        // The descriptions under their new names, counted by the pool until
+        // the record is committed or they are released
+        PackageRecord linked;
+    };
+
     virtual ~PackageStoreBase() = default;
 
     virtual coro::task<std::expected<void, DatabaseError>>
@@ -29,6 +38,32 @@ struct PackageStoreBase {
     virtual coro::task<std::expected<void, DatabaseError>>
         delete_by_id(PackageRecord::Id const package_id, std::shared_ptr<UnitOfWorkBase> uow) = 0;
 
+    // Drops a single location from the record, the record itself goes away
+    // with its last location. Returns whether the location was there.
+    virtual coro::task<std::expected<bool, DatabaseError>>
+        remove_location(PackageRecord::Id const package_id,
+                        Core::Domain::PoolLocation const location,
+                        std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
+    // Points the record to the pool paths of the current pool layout. Returns
+    // nothing if the record is in place already.
+    virtual coro::task<std::expected<std::optional<Relocation>, DatabaseError>>
+        relocate(PackageRecord::Id const package_id, std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
+    // Attaches the file list to the description at the given location, as
+    // long as it still refers to the same pool file. Returns whether the
+    // record was changed.
+    virtual coro::task<std::expected<bool, DatabaseError>>
+        attach_files(PackageRecord::Id const package_id,
+                     Core::Domain::PoolLocation const location,
+                     std::filesystem::path const filepath,
+                     std::string const files,
+                     std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
+    // Point lookup of a single record, EntityNotFound if there is none
+    virtual coro::task<std::expected<PackageRecord, DatabaseError>>
+        find_by_id(PackageRecord::Id const package_id, std::shared_ptr<UnitOfWorkBase> uow) = 0;
+
     virtual coro::task<std::expected<std::vector<PackageRecord>, DatabaseError>>
         find_by_section(PackageSectionDTO section, std::shared_ptr<UnitOfWorkBase> uow) = 0;
 
@@ -0,0 +1,195 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "UploadStaging.h"
+
+#include "utilities/Digest.h"
+#include "utilities/log/Logging.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace bxt::Presentation {
+
+namespace {
+    // Small enough to still be in cache when it's hashed after being written
+    constexpr std::size_t StagingChunkSize = 1024 * 1024;
+
+    std::span<uint8_t const> contents_of(drogon::HttpFile const& file) {
+        return {reinterpret_cast<uint8_t const*>(file.fileData()), file.fileLength()};
+    }
+} // namespace
+
+UploadStaging::UploadStaging(Persistence::Box::BoxOptions& box_options,
+                             Infrastructure::HashingService& hashing_service)
+    : m_staging_path(box_options.box_path / StagingDirectory)
+    , m_hashing_service(hashing_service) {
+    std::error_code ec;
+    std::filesystem::create_directories(m_staging_path, ec);
+
+    if (ec) {
+        loge("Upload staging: Can't create {}, the reason is \"{}\"", m_staging_path.string(),
+             ec.message());
+    }
+}
+
+coro::task<UploadStaging::Result<UploadStaging::StagedPackage>>
+    UploadStaging::stage(drogon::HttpFile const& package, drogon::HttpFile const* signature) {
+    // Writing, hashing and parsing a package takes a while, keep it off the
+    // request threads
+    co_return co_await m_hashing_service.offload(
+        [this, &package, signature] { return stage_files(package, signature); });
+}
+
+void UploadStaging::discard(std::filesystem::path const& filepath) {
+    auto const directory = filepath.parent_path();
+    if (directory.parent_path() != m_staging_path) {
+        return;
+    }
+
+    std::error_code ec;
+    std::filesystem::remove_all(directory, ec);
+
+    if (ec) {
+        logw("Upload staging: Can't remove {}, the reason is \"{}\"", directory.string(),
+             ec.message());
+    }
+}
+
+UploadStaging::Result<UploadStaging::StagedPackage>
+    UploadStaging::stage_files(drogon::HttpFile const& package,
+                               drogon::HttpFile const* signature) {
+    auto directory = fmt::format("{}/XXXXXX", m_staging_path.string());
+    if (!::mkdtemp(directory.data())) {
+        return std::unexpected(
+            StagingError(fmt::format("Can't create a staging directory for {}: {}",
+                                     package.getFileName(), std::strerror(errno))));
+    }
+
+    auto result = stage_files(directory, package, signature);
+
+    if (!result.has_value()) {
+        std::error_code ec;
+        std::filesystem::remove_all(directory, ec);
+    }
+
+    return result;
+}
+
+UploadStaging::Result<UploadStaging::StagedPackage>
+    UploadStaging::stage_files(std::filesystem::path const& directory,
+                               drogon::HttpFile const& package,
+                               drogon::HttpFile const* signature) {
+    StagedPackage result;
+
+    std::string signature_data;
+    if (signature) {
+        auto signature_path =
+            write(directory, signature->getFileName(), contents_of(*signature));
+        if (!signature_path.has_value()) {
+            return std::unexpected(std::move(signature_path.error()));
+        }
+        result.signature_path = std::move(*signature_path);
+        signature_data.assign(signature->fileData(), signature->fileLength());
+    }
+
+    auto md5 = Utilities::Digest::md5();
+    auto sha256 = Utilities::Digest::sha256();
+
+    auto const contents = contents_of(package);
+    auto package_path = write(directory, package.getFileName(), contents,
+                              [&](uint8_t const* data, std::size_t size) {
+                                  md5.update(data, size);
+                                  sha256.update(data, size);
+                              });
+
+    if (!package_path.has_value()) {
+        return std::unexpected(std::move(package_path.error()));
+    }
+    result.filepath = std::move(*package_path);
+
+    auto desc = Utilities::AlpmDb::Desc::parse_package(
+        contents, result.filepath,
+        Utilities::AlpmDb::DescFormatter::Checksums {
+            .size = contents.size(), .md5 = md5.hex_digest(), .sha256 = sha256.hex_digest()},
+        signature_data, false);
+
+    if (!desc.has_value()) {
+        return std::unexpected(StagingError(
+            fmt::format("Invalid package {}: {}", package.getFileName(), desc.error().what())));
+    }
+    result.desc = std::move(*desc);
+
+    return result;
+}
+
+UploadStaging::Result<std::filesystem::path>
+    UploadStaging::write(std::filesystem::path const& directory,
+                         std::string_view filename,
+                         std::span<uint8_t const> contents,
+                         Observer const& observer) {
+    // Only the file name of the upload is used, it must not escape staging
+    auto const name = std::filesystem::path(filename).filename();
+    if (name.empty() || name == "." || name == "..") {
+        return std::unexpected(StagingError(fmt::format("Invalid file name \"{}\"", filename)));
+    }
+
+    auto const target = directory / name;
+
+    // The directory belongs to this upload alone, nobody else sees the file
+    // while it's written
+    auto const fd = ::open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+
+    if (fd < 0) {
+        return std::unexpected(StagingError(fmt::format(
+            "Can't create a staging file for {}: {}", name.string(), std::strerror(errno))));
+    }
+
+    auto const fail = [&](std::string_view action) {
+        auto error = StagingError(fmt::format("Can't {} {}: {}", action, name.string(),
+                                              std::strerror(errno)));
+        ::close(fd);
+        ::unlink(target.c_str());
+        return std::unexpected(std::move(error));
+    };
+
+    for (std::size_t offset = 0; offset < contents.size(); offset += StagingChunkSize) {
+        auto const chunk = contents.subspan(offset, std::min(StagingChunkSize,
+                                                             contents.size() - offset));
+
+        for (std::size_t written = 0; written < chunk.size();) {
+            auto const size = ::write(fd, chunk.data() + written, chunk.size() - written);
+            if (size < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return fail("write");
+            }
+            written += static_cast<std::size_t>(size);
+        }
+
+        if (observer) {
+            observer(chunk.data(), chunk.size());
+        }
+    }
+
+    if (::close(fd) != 0) {
+        auto error = StagingError(
+            fmt::format("Can't write {}: {}", name.string(), std::strerror(errno)));
+        ::unlink(target.c_str());
+        return std::unexpected(std::move(error));
+    }
+
+    return target;
+}
+
+} // namespace bxt::Presentation
@@ -0,0 +1,83 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include "infrastructure/HashingService.h"
+#include "persistence/box/BoxOptions.h"
+#include "utilities/alpmdb/Desc.h"
+#include "utilities/Error.h"
+#include "utilities/errors/Macro.h"
+
+#include <coro/task.hpp>
+#include <cstdint>
+#include <drogon/MultiPart.h>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace bxt::Presentation {
+
+// Writes uploaded packages next to the pool, so moving them into the pool
+// later is a rename on the same filesystem. Checksums are computed from the
+// same chunks that are written and the description is parsed from the
+// uploaded bytes, the staged file is never read back. Every upload gets a
+// directory of its own, so uploads of the same file name never collide.
+class UploadStaging {
+public:
+    struct StagingError : public bxt::Error {
+        explicit StagingError(std::string error_message) {
+            message = std::move(error_message);
+        }
+    };
+    BXT_DECLARE_RESULT(StagingError);
+
+    struct StagedPackage {
+        std::filesystem::path filepath;
+        std::optional<std::filesystem::path> signature_path;
+        Utilities::AlpmDb::Desc desc;
+    };
+
+    static constexpr auto StagingDirectory = "staging";
+
+    UploadStaging(Persistence::Box::BoxOptions& box_options,
+                  Infrastructure::HashingService& hashing_service);
+
+    // Runs on the hashing pool, the files must outlive the returned task
+    coro::task<Result<StagedPackage>> stage(drogon::HttpFile const& package,
+                                            drogon::HttpFile const* signature);
+
+    // Removes the staging directory of a staged file with whatever is left in
+    // it, e.g. after a failed commit
+    void discard(std::filesystem::path const& filepath);
+
+    std::filesystem::path const& staging_path() const {
+        return m_staging_path;
+    }
+
+private:
+    using Observer = std::function<void(uint8_t const* data, std::size_t size)>;
+
+    Result<StagedPackage> stage_files(drogon::HttpFile const& package,
+                                      drogon::HttpFile const* signature);
+
+    Result<StagedPackage> stage_files(std::filesystem::path const& directory,
+                                      drogon::HttpFile const& package,
+                                      drogon::HttpFile const* signature);
+
+    Result<std::filesystem::path> write(std::filesystem::path const& directory,
+                                        std::string_view filename,
+                                        std::span<uint8_t const> contents,
+                                        Observer const& observer = {});
+
+    std::filesystem::path m_staging_path;
+    Infrastructure::HashingService& m_hashing_service;
+};
+
+} // namespace bxt::Presentation
@@ -117,10 +117,13 @@ drogon::Task<drogon::HttpResponsePtr>
     auto const section = PackageSectionDTO {
         .branch = branch->second, .repository = repo->second, .architecture = arch->second};
 
-    file->second.save();
-    signature->second.save();
+    auto staged = co_await m_upload_staging.stage(file->second, &signature->second);
 
-    auto const name = file->second.getFileName();
+    if (!staged.has_value()) {
+        result->setBody(staged.error().message);
+        result->setStatusCode(drogon::k400BadRequest);
+        co_return result;
+    }
 
     auto dto = PackageDTO {section,
                            "",
@@ -128,8 +131,9 @@ drogon::Task<drogon::HttpResponsePtr>
                            {{Core::Domain::PoolLocation::Automated,
                              {
                                  "",
-                                 app().getUploadPath() + "/" + name,
-                                 app().getUploadPath() + "/" + signature->second.getFileName(),
+                                 std::move(staged->filepath),
+                                 std::move(staged->signature_path),
+                                 std::move(staged->desc),
                              }}}
 
     };
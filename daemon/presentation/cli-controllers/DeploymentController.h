@@ -11,6 +11,7 @@
 #include "drogon/utils/coroutine.h"
 #include "drogon/utils/FunctionTraits.h"
 #include "presentation/cli-controllers/DeploymentOptions.h"
+#include "presentation/UploadStaging.h"
 #include "utilities/drogon/Macro.h"
 
 #include <drogon/drogon.h>
@@ -21,9 +22,12 @@ namespace bxt::Presentation {
 
 class DeploymentController : public drogon::HttpController<DeploymentController, false> {
 public:
-    DeploymentController(DeploymentOptions& options, Core::Application::DeploymentService& service)
+    DeploymentController(DeploymentOptions& options,
+                         Core::Application::DeploymentService& service,
+                         UploadStaging& upload_staging)
         : m_options(options)
-        , m_service(service) {};
+        , m_service(service)
+        , m_upload_staging(upload_staging) {};
 
     METHOD_LIST_BEGIN
 
@@ -40,6 +44,7 @@ public:
 private:
     DeploymentOptions& m_options;
     Core::Application::DeploymentService& m_service;
+    UploadStaging& m_upload_staging;
 };
 
 } // namespace bxt::Presentation
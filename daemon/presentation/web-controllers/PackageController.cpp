@@ -22,8 +22,10 @@
 #include <drogon/HttpResponse.h>
 #include <drogon/MultiPart.h>
 #include <drogon/utils/FunctionTraits.h>
+#include <filesystem>
 #include <json/value.h>
 #include <map>
+#include <nonstd/scope.hpp>
 #include <ranges>
 #include <rfl/as.hpp>
 #include <rfl/json/read.hpp>
@@ -58,7 +60,11 @@ drogon::Task<drogon::HttpResponsePtr>
         co_return drogon_helpers::make_error_response("Empty request");
     }
 
-    std::map<int, PackageDTO> packages;
+    struct UploadedFiles {
+        drogon::HttpFile const* package = nullptr;
+        drogon::HttpFile const* signature = nullptr;
+    };
+    std::map<int, UploadedFiles> uploads;
 
     for (auto const& [name, file] : files_map) {
         if (!name.starts_with("package")) {
@@ -74,24 +80,14 @@ drogon::Task<drogon::HttpResponsePtr>
         auto file_number_str = parts[0].substr(7);
         auto const file_number = std::stoi(file_number_str);
 
-        if (!packages.contains(file_number)) {
-            packages.emplace(file_number, PackageDTO {});
-        }
-
-        file.save();
-
-        auto location = Core::Domain::PoolLocation::Overlay;
-
-        PackagePoolEntryDTO& pool_entry = packages[file_number].pool_entries[location];
-
         if (parts.size() == 1 || parts[1] != "signature") {
-            pool_entry.filepath = app().getUploadPath() + "/" + file.getFileName();
-
+            uploads[file_number].package = &file;
         } else if (parts[1] == "signature") {
-            pool_entry.signature_path = app().getUploadPath() + "/" + file.getFileName();
+            uploads[file_number].signature = &file;
         }
     }
 
+    std::map<int, PackageSectionDTO> sections;
     for (auto const& [name, param] : params_map) {
         if (!name.starts_with("package")) {
             continue;
@@ -107,7 +103,7 @@ drogon::Task<drogon::HttpResponsePtr>
         auto file_number_str = parts[0].substr(7);
         auto const file_number = std::stoi(file_number_str);
 
-        if (!packages.contains(file_number)) {
+        if (!uploads.contains(file_number) || !uploads[file_number].package) {
             continue;
         }
 
@@ -118,21 +114,55 @@ drogon::Task<drogon::HttpResponsePtr>
                 co_return drogon_helpers::make_error_response(
                     fmt::format("Invalid section format: {}", section.error()->what()));
             }
-            packages[file_number].section = *section;
+            sections[file_number] = *section;
         }
     }
 
-    PackageService::Transaction transaction;
-    for (auto& package : packages) {
-        auto const& [branch, repository, architecture] = package.second.section;
+    // Nothing is written to disk before the permissions are checked
+    for (auto const& [file_number, upload] : uploads) {
+        if (!upload.package) {
+            continue;
+        }
+
+        auto const& [branch, repository, architecture] = sections[file_number];
 
         BXT_JWT_CHECK_PERMISSIONS(
             (std::vector<std::string_view> {
                 fmt::format("packages.commit.{}.{}.{}", branch, repository, architecture),
                 fmt::format("sections.{}.{}.{}", branch, repository, architecture)}),
             req)
+    }
+
+    // Whatever wasn't moved into the pool when the request ends is dropped
+    std::vector<std::filesystem::path> staged_files;
+    auto const discard_staged = nonstd::make_scope_exit([this, &staged_files] {
+        for (auto const& staged_file : staged_files) {
+            m_upload_staging.discard(staged_file);
+        }
+    });
+
+    PackageService::Transaction transaction;
+    for (auto const& [file_number, upload] : uploads) {
+        if (!upload.package) {
+            continue;
+        }
 
-        transaction.to_add.emplace_back(std::move(package.second));
+        auto staged = co_await m_upload_staging.stage(*upload.package, upload.signature);
+
+        if (!staged.has_value()) {
+            co_return drogon_helpers::make_error_response(staged.error().what());
+        }
+        staged_files.emplace_back(staged->filepath);
+
+        PackageDTO package {.section = sections[file_number]};
+
+        auto& pool_entry = package.pool_entries[Core::Domain::PoolLocation::Overlay];
+
+        pool_entry.filepath = std::move(staged->filepath);
+        pool_entry.signature_path = std::move(staged->signature_path);
+        pool_entry.desc = std::move(staged->desc);
+
+        transaction.to_add.emplace_back(std::move(package));
     }
 
     auto to_delete_it = params_map.find("to_delete");
@@ -340,4 +370,24 @@ drogon::Task<drogon::HttpResponsePtr> PackageController::snap_branch(drogon::Htt
 
     co_return drogon_helpers::make_ok_response();
 }
+
+drogon::Task<drogon::HttpResponsePtr> PackageController::migrate_pool(drogon::HttpRequestPtr req) {
+    BXT_JWT_CHECK_PERMISSIONS("advanced.pool.migrate", req)
+
+    auto const migration_ok = co_await m_pool_maintenance_service.migrate_layout();
+
+    if (!migration_ok.has_value()) {
+        co_return drogon_helpers::make_error_response(
+            fmt::format("Pool migration failed to start: {}", migration_ok.error().what()));
+    }
+
+    co_return drogon_helpers::make_ok_response();
+}
+
+drogon::Task<drogon::HttpResponsePtr>
+    PackageController::pool_gc_stats(drogon::HttpRequestPtr req) {
+    BXT_JWT_CHECK_PERMISSIONS("advanced.pool.gc", req)
+
+    co_return drogon_helpers::make_json_response(m_pool_gc_service.garbage_collection_stats());
+}
 } // namespace bxt::Presentation
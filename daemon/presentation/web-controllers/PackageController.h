@@ -9,9 +9,12 @@
 #include "core/application/services/DeploymentService.h"
 #include "core/application/services/PackageService.h"
 #include "core/application/services/PermissionService.h"
+#include "core/application/services/PoolGarbageCollectionService.h"
+#include "core/application/services/PoolMaintenanceService.h"
 #include "core/application/services/SyncService.h"
 #include "drogon/utils/coroutine.h"
 #include "drogon/utils/FunctionTraits.h"
+#include "presentation/UploadStaging.h"
 #include "utilities/drogon/Macro.h"
 
 #include <drogon/drogon.h>
@@ -24,10 +27,16 @@ class PackageController : public drogon::HttpController<PackageController, false
 public:
     PackageController(Core::Application::PackageService& package_service,
                       Core::Application::SyncService& sync_service,
-                      Core::Application::PermissionService& permission_service)
+                      Core::Application::PoolMaintenanceService& pool_maintenance_service,
+                      Core::Application::PoolGarbageCollectionService& pool_gc_service,
+                      Core::Application::PermissionService& permission_service,
+                      UploadStaging& upload_staging)
         : m_package_service(package_service)
         , m_sync_service(sync_service)
-        , m_permission_service(permission_service) {};
+        , m_pool_maintenance_service(pool_maintenance_service)
+        , m_pool_gc_service(pool_gc_service)
+        , m_permission_service(permission_service)
+        , m_upload_staging(upload_staging) {};
 
     METHOD_LIST_BEGIN
 
@@ -47,6 +56,12 @@ public:
 
     // Methods for advanced operations. These are not exposed to the frontend.
     BXT_JWT_ADD_METHOD_TO(PackageController::snap, "/api/advanced/packages/snap", drogon::Post);
+    BXT_JWT_ADD_METHOD_TO(PackageController::migrate_pool,
+                          "/api/advanced/pool/migrate",
+                          drogon::Post);
+    BXT_JWT_ADD_METHOD_TO(PackageController::pool_gc_stats,
+                          "/api/advanced/pool/gc",
+                          drogon::Get);
     METHOD_LIST_END
 
     drogon::Task<drogon::HttpResponsePtr> sync(drogon::HttpRequestPtr req);
@@ -62,10 +77,17 @@ public:
 
     drogon::Task<drogon::HttpResponsePtr> snap_branch(drogon::HttpRequestPtr req);
 
+    drogon::Task<drogon::HttpResponsePtr> migrate_pool(drogon::HttpRequestPtr req);
+
+    drogon::Task<drogon::HttpResponsePtr> pool_gc_stats(drogon::HttpRequestPtr req);
+
 private:
     Core::Application::PackageService& m_package_service;
     Core::Application::SyncService& m_sync_service;
+    Core::Application::PoolMaintenanceService& m_pool_maintenance_service;
+    Core::Application::PoolGarbageCollectionService& m_pool_gc_service;
     Core::Application::PermissionService& m_permission_service;
+    UploadStaging& m_upload_staging;
 };
 
 } // namespace bxt::Presentation
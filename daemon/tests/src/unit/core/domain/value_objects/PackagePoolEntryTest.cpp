@@ -33,6 +33,19 @@ TEST_CASE("PackagePoolEntry", "[core][domain][value_objects]") {
         REQUIRE(entry.signature_path() == sig_path);
     }
 
+    SECTION("Parse defers the file list") {
+        std::filesystem::path file_path = "data/dummy-1-1-any.pkg.tar.zst";
+        auto result = PackagePoolEntry::parse_file_path(file_path, std::nullopt);
+        REQUIRE(result.has_value());
+        REQUIRE(result->desc().files.empty());
+
+        auto files = bxt::Utilities::AlpmDb::Desc::extract_files(file_path);
+        REQUIRE(files.has_value());
+        REQUIRE(files->starts_with(bxt::Utilities::AlpmDb::Desc::FilesHeader));
+        REQUIRE(files->find(".MTREE\n") != std::string::npos);
+        REQUIRE(files->find(".PKGINFO") == std::string::npos);
+    }
+
     SECTION("Parse invalid file path") {
         std::filesystem::path file_path = "invalid-package-name";
         auto result = PackagePoolEntry::parse_file_path(file_path, std::nullopt);
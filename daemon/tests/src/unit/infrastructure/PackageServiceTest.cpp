@@ -0,0 +1,247 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "infrastructure/PackageService.h"
+
+#include "core/application/dtos/PackageDTO.h"
+#include "core/domain/repositories/PackageRepositoryBase.h"
+#include "core/domain/repositories/UnitOfWorkBase.h"
+#include "infrastructure/HashingService.h"
+#include "utilities/alpmdb/Desc.h"
+#include "utilities/eventbus/EventBusDispatcher.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <coro/io_scheduler.hpp>
+#include <coro/sync_wait.hpp>
+#include <dexode/EventBus.hpp>
+#include <fmt/format.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace bxt::Core::Domain;
+using bxt::Core::Application::PackageDTO;
+using bxt::Core::Application::PackageDTOMapper;
+using bxt::Core::Application::PackagePoolEntryDTO;
+using bxt::Core::Application::PackageSectionDTO;
+using bxt::Utilities::AlpmDb::Desc;
+
+namespace {
+
+struct UnitOfWork : UnitOfWorkBase {
+    coro::task<Result<void>> commit_async() override {
+        co_return {};
+    }
+    coro::task<Result<void>> rollback_async() override {
+        co_return {};
+    }
+    coro::task<Result<void>> begin_async() override {
+        co_return {};
+    }
+    coro::task<Result<void>> begin_ro_async() override {
+        co_return {};
+    }
+    void pre_hook(std::function<void()>&&, std::string const&) override {
+    }
+    void post_hook(std::function<void()>&&, std::string const&) override {
+    }
+};
+
+struct UnitOfWorkFactory : UnitOfWorkBaseFactory {
+    coro::task<std::shared_ptr<UnitOfWorkBase>> operator()(bool) override {
+        co_return std::make_shared<UnitOfWork>();
+    }
+};
+
+struct SectionRepository : ReadOnlyRepositoryBase<Section> {
+    coro::task<TResult> find_by_id_async(TId, std::shared_ptr<UnitOfWorkBase>) override {
+        co_return bxt::make_error<ReadError>(ReadError::EntityNotFound);
+    }
+    coro::task<TResult> find_first_async(std::function<bool(Section const&)>,
+                                         std::shared_ptr<UnitOfWorkBase>) override {
+        co_return bxt::make_error<ReadError>(ReadError::EntityNotFound);
+    }
+    coro::task<TResults> find_async(std::function<bool(Section const&)>,
+                                    std::shared_ptr<UnitOfWorkBase>) override {
+        co_return std::vector<Section> {};
+    }
+    coro::task<TResults> all_async(std::shared_ptr<UnitOfWorkBase>) override {
+        co_return std::vector<Section> {};
+    }
+};
+
+// Keeps the packages in memory and counts the records handed out, the way
+// the box store has to decode them
+struct PackageRepository : PackageRepositoryBase {
+    std::map<std::string, Package> packages;
+    std::size_t decoded = 0;
+
+    coro::task<TResult> find_by_id_async(TId id, std::shared_ptr<UnitOfWorkBase>) override {
+        auto const it = packages.find(bxt::to_string(id));
+        if (it == packages.end()) {
+            co_return bxt::make_error<ReadError>(ReadError::EntityNotFound);
+        }
+        ++decoded;
+        co_return it->second;
+    }
+    coro::task<TResult> find_first_async(std::function<bool(Package const&)>,
+                                         std::shared_ptr<UnitOfWorkBase>) override {
+        co_return bxt::make_error<ReadError>(ReadError::EntityNotFound);
+    }
+    coro::task<TResults> find_async(std::function<bool(Package const&)> condition,
+                                    std::shared_ptr<UnitOfWorkBase>) override {
+        std::vector<Package> result;
+        for (auto const& [key, package] : packages) {
+            ++decoded;
+            if (condition(package)) {
+                result.emplace_back(package);
+            }
+        }
+        co_return result;
+    }
+    coro::task<TResults> all_async(std::shared_ptr<UnitOfWorkBase> uow) override {
+        co_return co_await find_async([](auto const&) { return true; }, uow);
+    }
+
+    coro::task<TResults> find_by_section_async(Section const section,
+                                               std::shared_ptr<UnitOfWorkBase> uow) override {
+        co_return co_await find_async(
+            [&section](Package const& package) { return package.section() == section; }, uow);
+    }
+    coro::task<TResults> find_by_section_async(Section const section,
+                                               std::function<bool(Package const&)> const predicate,
+                                               std::shared_ptr<UnitOfWorkBase> uow) override {
+        co_return co_await find_async(
+            [&](Package const& package) {
+                return package.section() == section && predicate(package);
+            },
+            uow);
+    }
+    coro::task<TResult> find_by_section_async(Section const section,
+                                              Name const name,
+                                              std::shared_ptr<UnitOfWorkBase> uow) override {
+        co_return co_await find_by_id_async(TId {section, name}, uow);
+    }
+    coro::task<ReadResult<VersionSnapshot>>
+        find_versions_by_section_async(Section const, std::shared_ptr<UnitOfWorkBase>) override {
+        co_return VersionSnapshot {};
+    }
+    coro::task<WriteResult<void>> delete_location_async(std::vector<TId> const,
+                                                        PoolLocation const,
+                                                        std::shared_ptr<UnitOfWorkBase>) override {
+        co_return {};
+    }
+
+    coro::task<WriteResult<void>> add_async(Package const entity,
+                                            std::shared_ptr<UnitOfWorkBase>) override {
+        packages.insert_or_assign(bxt::to_string(entity.id()), entity);
+        co_return {};
+    }
+    coro::task<WriteResult<void>> update_async(Package const entity,
+                                               std::shared_ptr<UnitOfWorkBase> uow) override {
+        co_return co_await add_async(entity, uow);
+    }
+    coro::task<WriteResult<void>> delete_async(TId const id,
+                                               std::shared_ptr<UnitOfWorkBase>) override {
+        packages.erase(bxt::to_string(id));
+        co_return {};
+    }
+};
+
+PackageSectionDTO const TestSection {
+    .branch = "unstable", .repository = "extra", .architecture = "x86_64"};
+
+PackageDTO package_dto(std::string const& name, std::string const& version) {
+    std::filesystem::path const filepath =
+        fmt::format("/nonexistent/{}-{}-x86_64.pkg.tar.zst", name, version);
+
+    return PackageDTO {
+        .section = TestSection,
+        .name = name,
+        .pool_entries = {{PoolLocation::Overlay,
+                          PackagePoolEntryDTO {
+                              .version = version, .filepath = filepath, .desc = Desc {}}}}};
+}
+
+struct Fixture {
+    PackageRepository repository;
+    SectionRepository section_repository;
+    UnitOfWorkFactory uow_factory;
+    bxt::Infrastructure::HashingService hashing_service {2};
+    bxt::Utilities::EventBusDispatcher dispatcher {std::make_shared<dexode::EventBus>()};
+    bxt::Infrastructure::PackageService service {dispatcher,
+                                                 repository,
+                                                 section_repository,
+                                                 uow_factory,
+                                                 hashing_service,
+                                                 coro::io_scheduler::make_shared()};
+
+    void seed(std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            auto package = PackageDTOMapper::to_entity(
+                package_dto(fmt::format("package{:05}", i), "1.0-1"));
+            repository.packages.insert_or_assign(bxt::to_string(package.id()), package);
+        }
+    }
+
+    auto commit(std::vector<PackageDTO> packages) {
+        return coro::sync_wait(service.commit_transaction({.to_add = std::move(packages)}));
+    }
+};
+
+} // namespace
+
+TEST_CASE("PackageService::commit_transaction version check", "[infrastructure]") {
+    Fixture fixture;
+    fixture.seed(100);
+
+    SECTION("Newer versions and new packages are added") {
+        REQUIRE(fixture.commit({package_dto("package00042", "1.0-2"), package_dto("new", "1-1")})
+                    .has_value());
+
+        REQUIRE(fixture.repository.packages.size() == 101);
+        REQUIRE(fixture.repository.packages.at("unstable/extra/x86_64/package00042").version()
+                == *PackageVersion::from_string("1.0-2"));
+    }
+
+    SECTION("Equal and older versions are rejected") {
+        REQUIRE_FALSE(fixture.commit({package_dto("package00042", "1.0-1")}).has_value());
+        REQUIRE_FALSE(fixture.commit({package_dto("package00042", "0.9-1")}).has_value());
+    }
+
+    SECTION("Only the added packages are looked up") {
+        fixture.repository.decoded = 0;
+        REQUIRE(fixture.commit({package_dto("package00001", "1.0-2"),
+                                package_dto("package00002", "1.0-2")})
+                    .has_value());
+
+        // The version check and the save of each package
+        REQUIRE(fixture.repository.decoded <= 4);
+    }
+}
+
+TEST_CASE("PackageService::commit_transaction into a large section",
+          "[.][benchmark][infrastructure]") {
+    // 50 packages committed into a section of 10k
+    constexpr std::size_t SectionSize = 10000;
+    constexpr std::size_t CommitSize = 50;
+
+    Fixture fixture;
+    fixture.seed(SectionSize);
+
+    std::size_t release = 1;
+    BENCHMARK("50 packages") {
+        ++release;
+        std::vector<PackageDTO> packages;
+        for (std::size_t i = 0; i < CommitSize; ++i) {
+            packages.emplace_back(package_dto(fmt::format("package{:05}", i * 200),
+                                              fmt::format("1.0-{}", release)));
+        }
+        return fixture.commit(std::move(packages)).has_value();
+    };
+}
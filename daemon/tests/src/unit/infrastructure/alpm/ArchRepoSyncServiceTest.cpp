@@ -0,0 +1,651 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "infrastructure/alpm/ArchRepoSyncService.h"
+
+#include "core/application/dtos/PackageSectionDTO.h"
+#include "infrastructure/HashingService.h"
+#include "LocalHttpServer.h"
+#include "persistence/lmdb/LmdbUnitOfWork.h"
+#include "utilities/alpmdb/Database.h"
+#include "utilities/alpmdb/Desc.h"
+#include "utilities/Digest.h"
+#include "utilities/eventbus/EventBusDispatcher.h"
+#include "utilities/libarchive/Writer.h"
+#include "utilities/lmdb/Database.h"
+#include "utilities/lmdb/Environment.h"
+
+#include <algorithm>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <coro/io_scheduler.hpp>
+#include <coro/sync_wait.hpp>
+#include <dexode/EventBus.hpp>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using bxt::Core::Application::PackageSectionDTO;
+using bxt::Core::Application::SectionDTOMapper;
+using bxt::Core::Domain::Package;
+using bxt::Core::Domain::PackagePoolEntry;
+using bxt::Core::Domain::PackageRepositoryBase;
+using bxt::Core::Domain::PackageVersion;
+using bxt::Core::Domain::PoolLocation;
+using bxt::Core::Domain::ReadError;
+using bxt::Core::Domain::UnitOfWorkBase;
+using bxt::Infrastructure::ArchRepoSyncService;
+
+namespace {
+
+PackageVersion version(std::string_view string) {
+    return *PackageVersion::from_string(string);
+}
+
+ArchRepoSyncService::PackageInfo upstream_package(std::string name, std::string_view ver) {
+    return {.name = name,
+            .filename = fmt::format("{}-{}-x86_64.pkg.tar.zst", name, ver),
+            .version = version(ver),
+            .hash = {}};
+}
+
+PackageSectionDTO const TestSection {
+    .branch = "unstable", .repository = "core", .architecture = "x86_64"};
+
+// Where the default repository structure puts the files of the section
+constexpr auto RepositoryPath = "/archlinux/core/os/x86_64";
+
+std::string read_file(std::filesystem::path const& path) {
+    std::ifstream stream(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+}
+
+// Keeps the packages in memory by name, the test section is the only one
+struct PackageRepository : PackageRepositoryBase {
+    std::map<std::string, Package> packages;
+    std::vector<std::string> removed;
+
+    void seed(std::string const& name, std::string_view ver) {
+        Package package(SectionDTOMapper::to_entity(TestSection), name, false);
+        package.pool_entries().emplace(
+            PoolLocation::Sync, PackagePoolEntry(fmt::format("/nonexistent/{}", name),
+                                                 std::nullopt, {}, version(ver)));
+        packages.insert_or_assign(name, std::move(package));
+    }
+
+    coro::task<TResult> find_by_id_async(TId id, std::shared_ptr<UnitOfWorkBase>) override {
+        auto const it = packages.find(id.package_name);
+        if (it == packages.end()) {
+            co_return bxt::make_error<ReadError>(ReadError::EntityNotFound);
+        }
+        co_return it->second;
+    }
+    coro::task<TResult> find_first_async(std::function<bool(Package const&)>,
+                                         std::shared_ptr<UnitOfWorkBase>) override {
+        co_return bxt::make_error<ReadError>(ReadError::EntityNotFound);
+    }
+    coro::task<TResults> find_async(std::function<bool(Package const&)> condition,
+                                    std::shared_ptr<UnitOfWorkBase>) override {
+        std::vector<Package> result;
+        for (auto const& [name, package] : packages) {
+            if (condition(package)) {
+                result.emplace_back(package);
+            }
+        }
+        co_return result;
+    }
+    coro::task<TResults> all_async(std::shared_ptr<UnitOfWorkBase> uow) override {
+        co_return co_await find_async([](auto const&) { return true; }, uow);
+    }
+
+    coro::task<TResults> find_by_section_async(bxt::Core::Domain::Section const,
+                                               std::shared_ptr<UnitOfWorkBase> uow) override {
+        co_return co_await all_async(uow);
+    }
+    coro::task<TResults> find_by_section_async(bxt::Core::Domain::Section const,
+                                               std::function<bool(Package const&)> const predicate,
+                                               std::shared_ptr<UnitOfWorkBase> uow) override {
+        co_return co_await find_async(predicate, uow);
+    }
+    coro::task<TResult> find_by_section_async(bxt::Core::Domain::Section const section,
+                                              bxt::Core::Domain::Name const name,
+                                              std::shared_ptr<UnitOfWorkBase> uow) override {
+        co_return co_await find_by_id_async(TId {section, name}, uow);
+    }
+    coro::task<ReadResult<VersionSnapshot>>
+        find_versions_by_section_async(bxt::Core::Domain::Section const,
+                                       std::shared_ptr<UnitOfWorkBase>) override {
+        VersionSnapshot result;
+        for (auto const& [name, package] : packages) {
+            result.emplace_back(name, package.version(),
+                                package.pool_entries().contains(PoolLocation::Sync));
+        }
+        co_return result;
+    }
+    coro::task<WriteResult<void>> delete_location_async(std::vector<TId> const ids,
+                                                        PoolLocation const location,
+                                                        std::shared_ptr<UnitOfWorkBase>) override {
+        for (auto const& id : ids) {
+            auto const it = packages.find(id.package_name);
+            if (it == packages.end() || !it->second.pool_entries().erase(location)) {
+                continue;
+            }
+            if (it->second.pool_entries().empty()) {
+                packages.erase(it);
+            }
+            removed.emplace_back(id.package_name);
+        }
+        co_return {};
+    }
+
+    coro::task<WriteResult<void>> add_async(Package const entity,
+                                            std::shared_ptr<UnitOfWorkBase>) override {
+        packages.insert_or_assign(entity.name(), entity);
+        co_return {};
+    }
+    coro::task<WriteResult<void>> update_async(Package const entity,
+                                               std::shared_ptr<UnitOfWorkBase> uow) override {
+        co_return co_await add_async(entity, uow);
+    }
+    coro::task<WriteResult<void>> delete_async(TId const id,
+                                               std::shared_ptr<UnitOfWorkBase>) override {
+        packages.erase(id.package_name);
+        co_return {};
+    }
+};
+
+// Serves files from memory like a mirror. Every file has an ETag, requests
+// carrying it are answered with Not Modified.
+struct Mirror {
+    Mirror() {
+        http.server.Get(".*", [this](httplib::Request const& request,
+                                     httplib::Response& response) {
+            std::shared_future<void> gate;
+            {
+                std::lock_guard lock(mutex);
+                ++requests[request.path];
+
+                if (request.path == held_path) {
+                    gate = released;
+                    if (!arrived) {
+                        arrived = true;
+                        held.set_value();
+                    }
+                }
+            }
+            if (gate.valid()) {
+                gate.wait();
+            }
+
+            std::lock_guard lock(mutex);
+            auto const file = files.find(request.path);
+            if (file == files.end()) {
+                response.status = httplib::StatusCode::NotFound_404;
+                return;
+            }
+
+            auto const etag = fmt::format("\"{:x}\"", std::hash<std::string> {}(file->second));
+            if (request.get_header_value("If-None-Match") == etag) {
+                ++not_modified[request.path];
+                response.status = httplib::StatusCode::NotModified_304;
+                return;
+            }
+
+            response.set_header("ETag", etag);
+            response.set_content(file->second, "application/octet-stream");
+        });
+        http.start();
+    }
+
+    ~Mirror() {
+        release();
+    }
+
+    // Requests of `path` wait for release(), the future is ready once the
+    // first one arrived
+    std::future<void> hold(std::string const& path) {
+        std::lock_guard lock(mutex);
+        held_path = path;
+        released = release_promise.get_future().share();
+        return held.get_future();
+    }
+    void release() {
+        std::lock_guard lock(mutex);
+        if (released.valid() && !is_released) {
+            is_released = true;
+            release_promise.set_value();
+        }
+    }
+
+    void put(std::string const& path, std::string contents) {
+        std::lock_guard lock(mutex);
+        files.insert_or_assign(path, std::move(contents));
+    }
+
+    std::size_t request_count(std::string const& path) {
+        std::lock_guard lock(mutex);
+        return requests[path];
+    }
+    std::size_t not_modified_count(std::string const& path) {
+        std::lock_guard lock(mutex);
+        return not_modified[path];
+    }
+
+    std::mutex mutex;
+    std::map<std::string, std::string> files;
+    std::map<std::string, std::size_t> requests;
+    std::map<std::string, std::size_t> not_modified;
+
+    std::string held_path;
+    std::promise<void> held;
+    bool arrived = false;
+    std::promise<void> release_promise;
+    std::shared_future<void> released;
+    bool is_released = false;
+
+    // Stopped before the files go
+    bxt::Tests::LocalHttpServer http;
+};
+
+// A sync service against a local mirror, with its own LMDB environment and
+// download cache
+struct SyncFixture {
+    explicit SyncFixture(std::string_view name)
+        : directory(std::filesystem::temp_directory_path()
+                    / fmt::format("bxt-{}-{}", name, ::getpid()))
+        , env(open_environment(directory / "lmdb"))
+        , uow_factory(env) {
+        options.download_path = directory / "cache";
+        // Failures are final unless a test wants retries
+        options.database_retries = 0;
+        options.package_retries = 0;
+        options.sources.emplace(
+            TestSection, bxt::Infrastructure::ArchRepoSource {.repo_urls = {mirror.http.url()}});
+    }
+
+    ~SyncFixture() {
+        m_service.reset();
+        std::error_code ec;
+        std::filesystem::remove_all(directory, ec);
+    }
+
+    // Created on first use, so tests can change the options before
+    ArchRepoSyncService& service() {
+        if (!m_service) {
+            m_service = std::make_unique<ArchRepoSyncService>(dispatcher, repository, options,
+                                                              uow_factory, hashing_service, env);
+        }
+        return *m_service;
+    }
+
+    auto sync() {
+        return coro::sync_wait(service().sync(TestSection, {.user_name = "test"}));
+    }
+
+    static std::string database_path() {
+        return fmt::format("{}/core.db", RepositoryPath);
+    }
+    static std::string package_path(std::string const& name, std::string_view ver = "1-1") {
+        return fmt::format("{}/{}-{}-any.pkg.tar.zst", RepositoryPath, name, ver);
+    }
+
+    // Serves the package of the test data under another name, returns its
+    // desc
+    std::string publish_package(std::string const& name, std::string_view ver = "1-1") {
+        auto contents = read_file("data/dummy-1-1-any.pkg.tar.zst");
+
+        auto digest = bxt::Utilities::Digest::sha256();
+        digest.update(contents.data(), contents.size());
+        auto result = desc(name, ver, digest.hex_digest(), contents.size());
+
+        mirror.put(package_path(name, ver) + ".sig",
+                   read_file("data/dummy-1-1-any.pkg.tar.zst.sig"));
+        mirror.put(package_path(name, ver), std::move(contents));
+        return result;
+    }
+
+    // The upstream state saved for the test section
+    std::optional<bxt::Infrastructure::UpstreamState> saved_state() {
+        bxt::Utilities::LMDB::Database<bxt::Infrastructure::UpstreamState> states(
+            env, "bxt::UpstreamStates");
+        auto txn = coro::sync_wait(env->begin_ro_txn());
+
+        auto state = coro::sync_wait(states.get(txn->value, bxt::to_string(TestSection)));
+        if (!state.has_value()) {
+            return std::nullopt;
+        }
+        return std::move(*state);
+    }
+
+    // The quarantine entry of a package of the test section
+    std::optional<bxt::Infrastructure::QuarantineEntry> quarantined(std::string const& name) {
+        bxt::Utilities::LMDB::Database<bxt::Infrastructure::QuarantineEntry> quarantine(
+            env, "bxt::SyncQuarantine");
+        auto txn = coro::sync_wait(env->begin_ro_txn());
+
+        auto entry = coro::sync_wait(
+            quarantine.get(txn->value, fmt::format("{}/{}", bxt::to_string(TestSection), name)));
+        if (!entry.has_value()) {
+            return std::nullopt;
+        }
+        return std::move(*entry);
+    }
+
+    static std::string desc(std::string const& name,
+                            std::string_view ver,
+                            std::string const& sha256 = "unknown",
+                            std::size_t size = 0) {
+        return fmt::format("%FILENAME%\n{0}-{1}-any.pkg.tar.zst\n\n%NAME%\n{0}\n\n"
+                           "%VERSION%\n{1}\n\n%SHA256SUM%\n{2}\n\n%CSIZE%\n{3}\n\n",
+                           name, ver, sha256, size);
+    }
+
+    // A plain tar with a header and a data block per desc, cut after
+    // `size` bytes if given
+    void publish_database(std::vector<std::pair<std::string, std::string>> const& descs,
+                          std::optional<std::size_t> size = std::nullopt) {
+        auto const path = directory / "core.db";
+        {
+            Archive::Writer writer;
+            archive_write_set_format_ustar(writer);
+            REQUIRE(writer.open_filename(path).has_value());
+
+            for (auto const& [name, contents] : descs) {
+                REQUIRE(bxt::Utilities::AlpmDb::DatabaseUtils::write_buffer_to_archive(
+                            writer, fmt::format("{}/desc", name), contents)
+                            .has_value());
+            }
+        }
+
+        auto contents = read_file(path);
+        if (size.has_value()) {
+            contents.resize(*size);
+        }
+        mirror.put(database_path(), std::move(contents));
+    }
+
+    std::filesystem::path directory;
+    Mirror mirror;
+    std::shared_ptr<bxt::Utilities::LMDB::Environment> env;
+    bxt::Persistence::LmdbUnitOfWorkFactory uow_factory;
+    PackageRepository repository;
+    bxt::Infrastructure::HashingService hashing_service {2};
+    std::shared_ptr<dexode::EventBus> bus = std::make_shared<dexode::EventBus>();
+    bxt::Utilities::EventBusDispatcher dispatcher {bus};
+    bxt::Infrastructure::ArchRepoOptions options;
+
+private:
+    static std::shared_ptr<bxt::Utilities::LMDB::Environment>
+        open_environment(std::filesystem::path const& path) {
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directories(path);
+
+        auto env =
+            std::make_shared<bxt::Utilities::LMDB::Environment>(coro::io_scheduler::make_shared());
+        env->env().set_mapsize(64UL * 1024 * 1024);
+        env->env().set_max_dbs(16);
+        env->env().open(path.c_str(), 0, 0664);
+        return env;
+    }
+
+    std::unique_ptr<ArchRepoSyncService> m_service;
+};
+
+} // namespace
+
+TEST_CASE("ArchRepoSyncService::is_outdated", "[infrastructure][alpm]") {
+    PackageRepositoryBase::VersionSnapshot const local {
+        {"bash", version("5.2-1")},
+        {"glibc", version("2.39-1")},
+        {"zlib", version("1.3-2")},
+    };
+
+    SECTION("Newer and missing packages are outdated") {
+        REQUIRE(ArchRepoSyncService::is_outdated(upstream_package("bash", "5.2-2"), local));
+        REQUIRE(ArchRepoSyncService::is_outdated(upstream_package("curl", "8.7-1"), local));
+        REQUIRE(ArchRepoSyncService::is_outdated(upstream_package("zstd", "1.5-1"), local));
+    }
+
+    SECTION("Equal and older packages are not") {
+        REQUIRE_FALSE(ArchRepoSyncService::is_outdated(upstream_package("zlib", "1.3-2"), local));
+        REQUIRE_FALSE(
+            ArchRepoSyncService::is_outdated(upstream_package("glibc", "2.38-1"), local));
+    }
+
+    SECTION("Prefixes of local names are distinct packages") {
+        REQUIRE(ArchRepoSyncService::is_outdated(upstream_package("bas", "1-1"), local));
+    }
+
+    SECTION("Everything is outdated against an empty section") {
+        REQUIRE(ArchRepoSyncService::is_outdated(upstream_package("bash", "5.2-1"), {}));
+    }
+}
+
+TEST_CASE("ArchRepoSyncService::find_removed", "[infrastructure][alpm]") {
+    PackageRepositoryBase::VersionSnapshot const local {
+        {"bash", version("5.2-1"), true},
+        {"glibc", version("2.39-1"), true},
+        {"linux", version("6.9-1"), false},
+        {"zlib", version("1.3-2"), true},
+    };
+
+    SECTION("Synced packages missing upstream are removed") {
+        REQUIRE(ArchRepoSyncService::find_removed({"zlib", "bash"}, local)
+                == std::vector<std::string> {"glibc"});
+    }
+
+    SECTION("Packages without a sync entry are kept") {
+        REQUIRE(ArchRepoSyncService::find_removed({"bash", "glibc", "zlib"}, local).empty());
+    }
+
+    SECTION("New upstream packages don't affect the result") {
+        REQUIRE(ArchRepoSyncService::find_removed({"curl", "glibc", "zstd", "bash"}, local)
+                == std::vector<std::string> {"zlib"});
+    }
+
+    SECTION("Prefixes of local names are distinct packages") {
+        REQUIRE(ArchRepoSyncService::find_removed({"bas", "glibc", "zlib"}, local)
+                == std::vector<std::string> {"bash"});
+    }
+}
+
+TEST_CASE("ArchRepoSyncService::is_outdated throughput", "[.][benchmark][infrastructure][alpm]") {
+    // Roughly the size of extra, with every tenth package updated upstream
+    constexpr std::size_t PackageCount = 15000;
+
+    PackageRepositoryBase::VersionSnapshot local;
+    std::vector<ArchRepoSyncService::PackageInfo> upstream;
+    for (std::size_t i = 0; i < PackageCount; ++i) {
+        auto name = fmt::format("package{:05}", i);
+        local.emplace_back(name, version("1.0-1"));
+        upstream.emplace_back(upstream_package(name, i % 10 == 0 ? "1.0-2" : "1.0-1"));
+    }
+    std::ranges::shuffle(upstream, std::mt19937 {42});
+
+    BENCHMARK("15k packages") {
+        return std::ranges::count_if(upstream, [&local](auto const& package) {
+            return ArchRepoSyncService::is_outdated(package, local);
+        });
+    };
+}
+
+TEST_CASE("ArchRepoSyncService::sync with a truncated database", "[infrastructure][alpm]") {
+    SyncFixture fixture("sync-truncated-test");
+
+    std::vector<std::pair<std::string, std::string>> descs;
+    for (auto const* name : {"aaa", "bbb", "ccc", "zzz"}) {
+        fixture.repository.seed(name, "1-1");
+        descs.emplace_back(fmt::format("{}-1-1", name), SyncFixture::desc(name, "1-1"));
+    }
+
+    SECTION("Packages after the cut aren't removed") {
+        // The header of the third entry is cut in half
+        fixture.publish_database(descs, 2 * 1024 + 256);
+
+        REQUIRE_FALSE(fixture.sync().has_value());
+        REQUIRE(fixture.repository.removed.empty());
+        REQUIRE(fixture.repository.packages.size() == 4);
+    }
+
+    SECTION("Packages missing from a complete database are removed") {
+        descs.pop_back();
+        fixture.publish_database(descs);
+
+        REQUIRE(fixture.sync().has_value());
+        REQUIRE(fixture.repository.removed == std::vector<std::string> {"zzz"});
+    }
+}
+
+TEST_CASE("ArchRepoSyncService::sync of a section that is being synced",
+          "[infrastructure][alpm]") {
+    SyncFixture fixture("sync-running-test");
+    fixture.publish_database({{"dummy-1-1", fixture.publish_package("dummy")}});
+
+    // The first sync has fetched the database and waits for the package
+    auto arrived = fixture.mirror.hold(SyncFixture::package_path("dummy"));
+    bool first_synced = false;
+    std::jthread first([&] { first_synced = fixture.sync().has_value(); });
+    arrived.wait();
+
+    // Checked without throwing, the first sync must be let go either way
+    SECTION("A skipped sync doesn't save the state of the running one") {
+        CHECK(fixture.sync().has_value());
+        CHECK_FALSE(fixture.saved_state().has_value());
+    }
+
+    SECTION("Neither does a skipped section of a full sync") {
+        CHECK(coro::sync_wait(fixture.service().sync_all({.user_name = "test"})).has_value());
+        CHECK_FALSE(fixture.saved_state().has_value());
+    }
+
+    fixture.mirror.release();
+    first.join();
+    REQUIRE(first_synced);
+
+    // Saved by the run the state belongs to, once its package is written
+    REQUIRE(fixture.saved_state().has_value());
+    REQUIRE(fixture.repository.packages.contains("dummy"));
+}
+
+TEST_CASE("ArchRepoSyncService::sync_scheduled events", "[infrastructure][alpm]") {
+    using namespace bxt::Core::Application::Events;
+
+    SyncFixture fixture("sync-scheduled-test");
+    fixture.publish_database({{"dummy-1-1", fixture.publish_package("dummy")}});
+
+    std::vector<std::string> events;
+    auto listener = dexode::EventBus::Listener::createNotOwning(*fixture.bus);
+    listener.listen<SyncStarted>([&](auto const&) { events.emplace_back("started"); });
+    listener.listen<SyncFinished>([&](auto const&) { events.emplace_back("finished"); });
+    listener.listen<ScheduledSyncFinished>([&](auto const&) { events.emplace_back("scheduled"); });
+
+    auto const changed = coro::sync_wait(fixture.service().sync_scheduled(TestSection));
+    REQUIRE(changed.has_value());
+    REQUIRE(*changed);
+
+    // Goes to the sync log without ending a sync someone else started
+    fixture.bus->process();
+    REQUIRE(events == std::vector<std::string> {"scheduled"});
+}
+
+TEST_CASE("ArchRepoSyncService::sync with an unchanged database", "[infrastructure][alpm]") {
+    SyncFixture fixture("sync-unchanged-test");
+    fixture.publish_database({{"dummy-1-1", fixture.publish_package("dummy")}});
+
+    REQUIRE(fixture.sync().has_value());
+    REQUIRE(fixture.repository.packages.contains("dummy"));
+
+    auto const state = fixture.saved_state();
+    REQUIRE(state.has_value());
+    REQUIRE_FALSE(state->etag.empty());
+
+    // Would be downloaded again if the database was read
+    fixture.repository.packages.clear();
+
+    SECTION("A Not Modified database skips the section") {
+        REQUIRE(fixture.sync().has_value());
+
+        REQUIRE(fixture.mirror.request_count(SyncFixture::database_path()) == 2);
+        REQUIRE(fixture.mirror.not_modified_count(SyncFixture::database_path()) == 1);
+        REQUIRE(fixture.mirror.request_count(SyncFixture::package_path("dummy")) == 1);
+        REQUIRE(fixture.repository.packages.empty());
+    }
+
+    SECTION("A changed database is read again") {
+        fixture.publish_database({{"dummy-1-1", fixture.publish_package("dummy")},
+                                  {"other-1-1", fixture.publish_package("other")}});
+
+        REQUIRE(fixture.sync().has_value());
+
+        REQUIRE(fixture.mirror.not_modified_count(SyncFixture::database_path()) == 0);
+        REQUIRE(fixture.repository.packages.contains("dummy"));
+        REQUIRE(fixture.repository.packages.contains("other"));
+
+        auto const updated = fixture.saved_state();
+        REQUIRE(updated.has_value());
+        REQUIRE(updated->etag != state->etag);
+    }
+}
+
+TEST_CASE("ArchRepoSyncService::sync with a failing package", "[infrastructure][alpm]") {
+    SyncFixture fixture("sync-failing-test");
+    // Listed, but the mirror doesn't have the file
+    fixture.publish_database({{"dummy-1-1", fixture.publish_package("dummy")},
+                              {"missing-1-1", SyncFixture::desc("missing", "1-1")}});
+
+    SECTION("The rest of the section is written") {
+        REQUIRE(fixture.sync().has_value());
+
+        REQUIRE(fixture.repository.packages.contains("dummy"));
+        REQUIRE_FALSE(fixture.repository.packages.contains("missing"));
+
+        // The next sync reads the database again to retry it
+        REQUIRE_FALSE(fixture.saved_state().has_value());
+    }
+
+    SECTION("Only the failed package is retried") {
+        fixture.options.package_retries = 1;
+
+        REQUIRE(fixture.sync().has_value());
+
+        REQUIRE(fixture.mirror.request_count(SyncFixture::package_path("dummy")) == 1);
+        REQUIRE(fixture.mirror.request_count(SyncFixture::package_path("missing")) >= 2);
+        REQUIRE(fixture.repository.packages.contains("dummy"));
+    }
+
+    SECTION("A package failing in consecutive syncs is quarantined") {
+        fixture.options.quarantine_after = 2;
+
+        REQUIRE(fixture.sync().has_value());
+        REQUIRE(fixture.quarantined("missing")->failures == 1);
+        REQUIRE(fixture.sync().has_value());
+        REQUIRE(fixture.quarantined("missing")->failures == 2);
+
+        auto const requested = fixture.mirror.request_count(SyncFixture::package_path("missing"));
+        REQUIRE(fixture.sync().has_value());
+        REQUIRE(fixture.mirror.request_count(SyncFixture::package_path("missing")) == requested);
+
+        // A new upstream version is downloaded and ends the streak
+        fixture.publish_database({{"dummy-1-1", SyncFixture::desc("dummy", "1-1")},
+                                  {"missing-1-2", fixture.publish_package("missing", "1-2")}});
+
+        REQUIRE(fixture.sync().has_value());
+        REQUIRE(fixture.repository.packages.contains("missing"));
+        REQUIRE_FALSE(fixture.quarantined("missing").has_value());
+    }
+}
@@ -0,0 +1,100 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "infrastructure/alpm/BatchWriter.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <coro/event.hpp>
+#include <coro/sync_wait.hpp>
+#include <coro/task.hpp>
+#include <deque>
+#include <expected>
+#include <optional>
+#include <string>
+#include <vector>
+
+using Writer = bxt::Infrastructure::BatchWriter<int, std::string>;
+
+TEST_CASE("BatchWriter", "[infrastructure][alpm]") {
+    std::vector<std::vector<int>> batches;
+    // Every write waits for its own gate
+    std::deque<coro::event> gates(8);
+    std::size_t calls = 0;
+    std::optional<std::size_t> fail_at;
+
+    auto const write = [&](std::vector<int> batch) -> coro::task<std::expected<void, std::string>> {
+        auto const call = calls++;
+        co_await gates[call];
+
+        if (fail_at == call) {
+            co_return std::unexpected<std::string>("disk full");
+        }
+        batches.emplace_back(std::move(batch));
+        co_return {};
+    };
+
+    std::vector<int> pushed;
+    auto push = [&](Writer& writer, int item) -> coro::task<void> {
+        if (co_await writer.push(item)) {
+            pushed.emplace_back(item);
+        }
+    };
+
+    SECTION("Producers wait while the queue is full") {
+        Writer writer({.batch_size = 3, .capacity = 6}, write);
+
+        std::vector<coro::task<void>> producers;
+        for (int item = 0; item < 10; ++item) {
+            producers.emplace_back(push(writer, item));
+        }
+        for (auto& producer : producers) {
+            producer.resume();
+        }
+
+        // The first batch is being written by the push of 2, 3 to 5 are
+        // queued and the rest waits for room
+        REQUIRE(calls == 1);
+        REQUIRE(pushed == std::vector {0, 1, 3, 4, 5});
+
+        gates[0].set();
+        REQUIRE(calls == 2);
+        REQUIRE(pushed == std::vector {0, 1, 3, 4, 5, 6, 7, 8});
+
+        gates[1].set();
+        gates[2].set();
+        REQUIRE(pushed.size() == 10);
+
+        gates[3].set();
+        REQUIRE(coro::sync_wait(writer.finish()).has_value());
+
+        REQUIRE(batches == std::vector<std::vector<int>> {{0, 1, 2}, {3, 4, 5}, {6, 7, 8}, {9}});
+        REQUIRE(writer.written() == 10);
+        REQUIRE(writer.batches() == 4);
+    }
+
+    SECTION("Nothing is written after a failed batch") {
+        for (auto& gate : gates) {
+            gate.set();
+        }
+        fail_at = 1;
+
+        Writer writer({.batch_size = 3, .capacity = 3}, write);
+        for (int item = 0; item < 8; ++item) {
+            coro::sync_wait(push(writer, item));
+        }
+
+        REQUIRE(writer.failed());
+        REQUIRE(pushed == std::vector {0, 1, 2, 3, 4});
+
+        auto const finished = coro::sync_wait(writer.finish());
+        REQUIRE_FALSE(finished.has_value());
+        REQUIRE(finished.error() == "disk full");
+
+        REQUIRE(batches == std::vector<std::vector<int>> {{0, 1, 2}});
+        REQUIRE(writer.written() == 3);
+        REQUIRE(calls == 2);
+    }
+}
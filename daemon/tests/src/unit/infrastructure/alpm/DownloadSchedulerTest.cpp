@@ -0,0 +1,80 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "infrastructure/alpm/DownloadScheduler.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <coro/sync_wait.hpp>
+#include <coro/task.hpp>
+#include <optional>
+#include <vector>
+
+using bxt::Infrastructure::DownloadScheduler;
+using Priority = DownloadScheduler::Priority;
+
+TEST_CASE("DownloadScheduler", "[infrastructure][alpm]") {
+    std::vector<int> order;
+    std::optional<DownloadScheduler::Ticket> held;
+
+    auto hold = [&](DownloadScheduler& scheduler,
+                    DownloadScheduler::Request const request) -> coro::task<void> {
+        held.emplace(co_await scheduler.acquire(request));
+    };
+
+    // Tasks are lazy: resume() runs one until it either finishes or waits
+    // for a slot, which keeps the admission order deterministic.
+    auto job = [&](DownloadScheduler& scheduler, int id,
+                   DownloadScheduler::Request const request) -> coro::task<void> {
+        auto ticket = co_await scheduler.acquire(request);
+        order.push_back(id);
+        ticket.succeed();
+    };
+
+    SECTION("Waiting downloads start by priority, then smallest first") {
+        DownloadScheduler scheduler({.max_concurrent_downloads = 1});
+        coro::sync_wait(hold(scheduler, {.mirror = "a"}));
+
+        std::vector<coro::task<void>> jobs;
+        jobs.emplace_back(job(scheduler, 1, {.mirror = "a", .size = 300}));
+        jobs.emplace_back(job(scheduler, 2, {.mirror = "a", .size = 100}));
+        jobs.emplace_back(job(scheduler, 3, {.mirror = "b", .priority = Priority::User}));
+        jobs.emplace_back(job(scheduler, 4, {.mirror = "a", .priority = Priority::Database}));
+        for (auto& pending : jobs) {
+            pending.resume();
+        }
+
+        REQUIRE(order.empty());
+        REQUIRE(scheduler.progress().queued == 4);
+        REQUIRE(scheduler.progress().bytes_expected == 400);
+
+        held.reset();
+
+        REQUIRE(order == std::vector {4, 3, 2, 1});
+
+        auto const progress = scheduler.progress();
+        REQUIRE(progress.completed == 4);
+        REQUIRE(progress.failed == 1);
+        REQUIRE(progress.active == 0);
+        REQUIRE(progress.queued == 0);
+    }
+
+    SECTION("A busy mirror doesn't block other mirrors") {
+        DownloadScheduler scheduler(
+            {.max_concurrent_downloads = 4, .max_downloads_per_mirror = 1});
+        coro::sync_wait(hold(scheduler, {.mirror = "a"}));
+
+        auto same_mirror = job(scheduler, 1, {.mirror = "a"});
+        auto other_mirror = job(scheduler, 2, {.mirror = "b"});
+        same_mirror.resume();
+        other_mirror.resume();
+
+        REQUIRE(order == std::vector {2});
+
+        held.reset();
+
+        REQUIRE(order == std::vector {2, 1});
+    }
+}
@@ -0,0 +1,94 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "infrastructure/alpm/ExclusionMatcher.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
+#include <regex>
+#include <string>
+#include <vector>
+
+using bxt::Infrastructure::ExclusionMatcher;
+using Match = ExclusionMatcher::Match;
+
+TEST_CASE("ExclusionMatcher", "[infrastructure][alpm]") {
+    ExclusionMatcher const matcher(std::vector<std::string> {
+        "linux", "^nvidia$", "lib32-.*", "python-(foo|bar)", "(a)\\1", "[", ""});
+
+    SECTION("Invalid and empty patterns are skipped") {
+        REQUIRE(matcher.size() == 5);
+    }
+
+    SECTION("Plain names match exactly") {
+        REQUIRE(matcher.match("linux") == Match::Literal);
+        REQUIRE(matcher.match("nvidia") == Match::Literal);
+        REQUIRE(matcher.match("linux-lts") == Match::None);
+    }
+
+    SECTION("Prefixes match the start of the name") {
+        REQUIRE(matcher.match("lib32-glibc") == Match::Prefix);
+        REQUIRE(matcher.match("lib32") == Match::None);
+    }
+
+    SECTION("Expressions match the whole name") {
+        REQUIRE(matcher.match("python-foo") == Match::Pattern);
+        REQUIRE(matcher.match("python-bar") == Match::Pattern);
+        REQUIRE(matcher.match("python-foobar") == Match::None);
+        REQUIRE(matcher.match("aa") == Match::Pattern);
+    }
+
+    SECTION("Statistics count every lookup") {
+        ExclusionMatcher::Stats stats;
+        for (auto const* name : {"linux", "lib32-gcc", "python-foo", "bash"}) {
+            stats.count(matcher.match(name));
+        }
+
+        REQUIRE(stats.checked == 4);
+        REQUIRE(stats.excluded() == 3);
+        REQUIRE(stats.literal == 1);
+        REQUIRE(stats.prefix == 1);
+        REQUIRE(stats.pattern == 1);
+    }
+}
+
+TEST_CASE("ExclusionMatcher throughput", "[.][benchmark][infrastructure][alpm]") {
+    std::vector<std::string> patterns;
+    for (int i = 0; i < 20; ++i) {
+        patterns.emplace_back(fmt::format("excluded{}", i));
+        patterns.emplace_back(fmt::format("prefix{}-.*", i));
+        patterns.emplace_back(fmt::format("pattern{}-(a|b)+", i));
+    }
+
+    std::vector<std::string> names;
+    for (int i = 0; i < 2000; ++i) {
+        names.emplace_back(fmt::format("package{}", i));
+    }
+
+    ExclusionMatcher const matcher(patterns);
+
+    BENCHMARK("Compiled matcher, 2000 names") {
+        std::size_t excluded = 0;
+        for (auto const& name : names) {
+            excluded += matcher.match(name) != Match::None;
+        }
+        return excluded;
+    };
+
+    BENCHMARK("Regex per pattern and name, 2000 names") {
+        std::size_t excluded = 0;
+        for (auto const& name : names) {
+            for (auto const& pattern : patterns) {
+                if (std::regex_match(name, std::regex(pattern))) {
+                    ++excluded;
+                    break;
+                }
+            }
+        }
+        return excluded;
+    };
+}
@@ -0,0 +1,124 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "LocalHttpServer.h"
+#include "infrastructure/alpm/HttpClientPool.h"
+
+#include <atomic>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <coro/sync_wait.hpp>
+#include <coro/thread_pool.hpp>
+#include <coro/when_all.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+using bxt::Infrastructure::HttpClientPool;
+using bxt::Tests::LocalHttpServer;
+
+namespace {
+
+std::string const Payload(64 * 1024, 'x');
+
+int fetch(HttpClientPool& pool, std::string const& url) {
+    auto client = coro::sync_wait(pool.acquire(url));
+    auto response = client->Get("/file");
+    return response ? response->status : -1;
+}
+
+} // namespace
+
+TEST_CASE("HttpClientPool", "[infrastructure][alpm]") {
+    LocalHttpServer server;
+
+    std::atomic<int> in_flight = 0;
+    std::atomic<int> max_in_flight = 0;
+
+    server.server.Get("/file", [&](httplib::Request const&, httplib::Response& response) {
+        auto const current = ++in_flight;
+        auto seen = max_in_flight.load();
+        while (current > seen && !max_in_flight.compare_exchange_weak(seen, current)) {
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        --in_flight;
+
+        response.set_content(Payload, "application/octet-stream");
+    });
+    server.start();
+
+    SECTION("Sequential requests reuse one connection") {
+        HttpClientPool pool({});
+
+        for (int i = 0; i < 10; ++i) {
+            REQUIRE(fetch(pool, server.url()) == 200);
+        }
+
+        REQUIRE(pool.stats().created == 1);
+        REQUIRE(pool.stats().reused == 9);
+        REQUIRE(server.connection_count() == 1);
+    }
+
+    SECTION("Connections per host are bounded") {
+        HttpClientPool pool({.max_connections_per_host = 2});
+        coro::thread_pool workers {coro::thread_pool::options {.thread_count = 8}};
+
+        auto request = [&]() -> coro::task<int> {
+            co_await workers.schedule();
+            auto client = co_await pool.acquire(server.url());
+            auto response = client->Get("/file");
+            co_return response ? response->status : -1;
+        };
+
+        std::vector<coro::task<int>> tasks;
+        for (int i = 0; i < 16; ++i) {
+            tasks.emplace_back(request());
+        }
+
+        for (auto& status : coro::sync_wait(coro::when_all(std::move(tasks)))) {
+            REQUIRE(status.return_value() == 200);
+        }
+
+        REQUIRE(max_in_flight <= 2);
+        REQUIRE(pool.stats().created <= 2);
+        REQUIRE(server.connection_count() <= 2);
+    }
+
+    SECTION("URLs without a scheme default to https") {
+        REQUIRE(HttpClientPool::normalize("repo.manjaro.org") == "https://repo.manjaro.org");
+        REQUIRE(HttpClientPool::normalize("http://127.0.0.1:80/") == "http://127.0.0.1:80");
+    }
+}
+
+TEST_CASE("HttpClientPool throughput", "[.][benchmark][infrastructure][alpm]") {
+    LocalHttpServer server;
+    server.server.Get("/file", [](httplib::Request const&, httplib::Response& response) {
+        response.set_content(Payload, "application/octet-stream");
+    });
+    server.start();
+
+    constexpr int RequestCount = 100;
+
+    BENCHMARK("New client per request") {
+        int ok = 0;
+        for (int i = 0; i < RequestCount; ++i) {
+            httplib::Client client(server.url());
+            auto response = client.Get("/file");
+            ok += response && response->status == 200;
+        }
+        return ok;
+    };
+
+    HttpClientPool pool({});
+    BENCHMARK("Pooled keep-alive client") {
+        int ok = 0;
+        for (int i = 0; i < RequestCount; ++i) {
+            ok += fetch(pool, server.url()) == 200;
+        }
+        return ok;
+    };
+}
@@ -0,0 +1,70 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <fmt/format.h>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include <httplib.h>
+
+namespace bxt::Tests {
+
+// Plain HTTP server on the loopback interface, so the sync code can be
+// exercised and benchmarked without a mirror. Routes are registered on
+// `server` before start().
+struct LocalHttpServer {
+    LocalHttpServer() {
+        server.set_keep_alive_max_count(1000);
+        server.set_pre_routing_handler([this](auto const& request, auto&) {
+            std::lock_guard lock(mutex);
+            client_ports.insert(request.remote_port);
+            return httplib::Server::HandlerResponse::Unhandled;
+        });
+    }
+
+    ~LocalHttpServer() {
+        server.stop();
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    void start() {
+        port = server.bind_to_any_port("127.0.0.1");
+        REQUIRE(port > 0);
+
+        thread = std::thread([this] { server.listen_after_bind(); });
+        server.wait_until_ready();
+    }
+
+    std::string url() const {
+        return fmt::format("http://127.0.0.1:{}", port);
+    }
+
+    // Every distinct client port is a separate TCP connection
+    std::size_t connection_count() {
+        std::lock_guard lock(mutex);
+        return client_ports.size();
+    }
+
+    httplib::Server server;
+    int port = 0;
+
+    std::mutex mutex;
+    std::set<int> client_ports;
+
+    std::thread thread;
+};
+
+} // namespace bxt::Tests
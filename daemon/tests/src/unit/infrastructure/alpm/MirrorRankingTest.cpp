@@ -0,0 +1,98 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "LocalHttpServer.h"
+#include "infrastructure/alpm/MirrorRanking.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using bxt::Infrastructure::MirrorRanking;
+using bxt::Tests::LocalHttpServer;
+using namespace std::chrono_literals;
+
+TEST_CASE("MirrorRanking", "[infrastructure][alpm]") {
+    std::vector<std::string> const mirrors {"a", "b", "c"};
+    MirrorRanking ranking({});
+
+    SECTION("Unmeasured mirrors keep the configured order") {
+        REQUIRE(ranking.rank(mirrors) == mirrors);
+    }
+
+    SECTION("Faster mirrors rank first") {
+        ranking.record_transfer("b", 1024 * 1024, 100ms);
+        ranking.record_transfer("a", 1024 * 1024, 200ms);
+
+        REQUIRE(ranking.rank(mirrors) == std::vector<std::string> {"b", "a", "c"});
+    }
+
+    SECTION("Failing mirrors are benched until they succeed again") {
+        ranking.record_transfer("a", 1024 * 1024, 100ms);
+        for (int i = 0; i < 3; ++i) {
+            ranking.record_failure("a");
+        }
+
+        REQUIRE_FALSE(ranking.mirror("a").healthy);
+        REQUIRE(ranking.rank(mirrors) == std::vector<std::string> {"b", "c", "a"});
+
+        ranking.record_latency("a", 10ms);
+        REQUIRE(ranking.mirror("a").healthy);
+    }
+
+    SECTION("Files are striped over the healthy mirrors") {
+        for (int i = 0; i < 3; ++i) {
+            ranking.record_failure("c");
+        }
+
+        REQUIRE(ranking.candidates(mirrors, 0) == std::vector<std::string> {"a", "b", "c"});
+        REQUIRE(ranking.candidates(mirrors, 1) == std::vector<std::string> {"b", "a", "c"});
+        REQUIRE(ranking.candidates(mirrors, 2) == std::vector<std::string> {"a", "b", "c"});
+    }
+
+    SECTION("Much slower mirrors are only used for failover") {
+        ranking.record_transfer("a", 1024 * 1024, 10ms);
+        ranking.record_transfer("b", 1024 * 1024, 1s);
+
+        REQUIRE(ranking.candidates(mirrors, 1) == std::vector<std::string> {"c", "a", "b"});
+    }
+}
+
+TEST_CASE("MirrorRanking with local mirrors", "[infrastructure][alpm]") {
+    std::string const payload(256 * 1024, 'x');
+
+    // The same file on two mirrors, one of them answering late
+    LocalHttpServer fast;
+    LocalHttpServer slow;
+    fast.server.Get("/file", [&payload](auto const&, httplib::Response& response) {
+        response.set_content(payload, "application/octet-stream");
+    });
+    slow.server.Get("/file", [&payload](auto const&, httplib::Response& response) {
+        std::this_thread::sleep_for(100ms);
+        response.set_content(payload, "application/octet-stream");
+    });
+    fast.start();
+    slow.start();
+
+    MirrorRanking ranking({});
+    std::vector<std::string> const mirrors {slow.url(), fast.url()};
+
+    for (auto const& url : mirrors) {
+        httplib::Client client(url);
+        for (int i = 0; i < 3; ++i) {
+            auto const started = MirrorRanking::Clock::now();
+            auto const response = client.Get("/file");
+            REQUIRE(response);
+            ranking.record_transfer(url, response->body.size(),
+                                    MirrorRanking::Clock::now() - started);
+        }
+    }
+
+    REQUIRE(ranking.rank(mirrors) == std::vector<std::string> {fast.url(), slow.url()});
+    REQUIRE(ranking.candidates(mirrors, 1).front() == fast.url());
+}
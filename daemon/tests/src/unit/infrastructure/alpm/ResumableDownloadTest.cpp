@@ -0,0 +1,132 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "LocalHttpServer.h"
+#include "infrastructure/alpm/ResumableDownload.h"
+#include "utilities/Digest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using bxt::Infrastructure::download_resumable;
+using bxt::Infrastructure::ResumableDownloadError;
+using bxt::Tests::LocalHttpServer;
+
+namespace {
+
+std::string make_payload(std::size_t size) {
+    std::string payload(size, '\0');
+    for (std::size_t i = 0; i < size; ++i) {
+        payload[i] = static_cast<char>((i * 31 + i / 7) & 0xff);
+    }
+    return payload;
+}
+
+std::string sha256(std::string const& data) {
+    auto digest = bxt::Utilities::Digest::sha256();
+    digest.update(data.data(), data.size());
+    return digest.hex_digest();
+}
+
+std::string read_file(std::filesystem::path const& path) {
+    std::ifstream stream(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+}
+
+} // namespace
+
+TEST_CASE("download_resumable", "[infrastructure][alpm]") {
+    auto const payload = make_payload(1024 * 1024);
+    auto const checksum = sha256(payload);
+
+    auto const directory = std::filesystem::temp_directory_path()
+                           / fmt::format("bxt-resumable-test-{}", ::getpid());
+    std::filesystem::create_directories(directory);
+    auto const target = directory / "package.pkg.tar.zst";
+    auto part = target;
+    part += ".part";
+
+    // Stand-in for a flaky mirror: the first `drops` responses break off in
+    // the middle of the body.
+    LocalHttpServer server;
+    std::atomic<int> drops = 0;
+    std::mutex mutex;
+    std::vector<std::string> ranges;
+
+    server.server.Get("/package", [&](httplib::Request const& request,
+                                      httplib::Response& response) {
+        {
+            std::lock_guard lock(mutex);
+            ranges.emplace_back(request.get_header_value("Range"));
+        }
+        bool const drop = drops-- > 0;
+
+        response.set_content_provider(
+            payload.size(), "application/octet-stream",
+            [&payload, drop](std::size_t offset, std::size_t length, httplib::DataSink& sink) {
+                if (drop && offset >= payload.size() / 2) {
+                    return false;
+                }
+                sink.write(payload.data() + offset, std::min<std::size_t>(length, 16 * 1024));
+                return true;
+            });
+    });
+    server.start();
+
+    httplib::Client client(server.url());
+
+    SECTION("An interrupted download continues from the part file") {
+        drops = 1;
+
+        auto const interrupted = download_resumable(client, "/package", target, checksum);
+        REQUIRE_FALSE(interrupted.has_value());
+        REQUIRE(interrupted.error().error_type
+                == ResumableDownloadError::ErrorType::NetworkError);
+        REQUIRE_FALSE(std::filesystem::exists(target));
+        REQUIRE(std::filesystem::exists(part));
+
+        auto const kept = std::filesystem::file_size(part);
+        REQUIRE(kept > 0);
+        REQUIRE(kept < payload.size());
+
+        auto const resumed = download_resumable(client, "/package", target, checksum);
+        REQUIRE(resumed.has_value());
+        REQUIRE(resumed->resumed_from == kept);
+        REQUIRE(resumed->received == payload.size() - kept);
+        REQUIRE(resumed->sha256 == checksum);
+
+        REQUIRE(ranges.back() == fmt::format("bytes={}-", kept));
+        REQUIRE_FALSE(std::filesystem::exists(part));
+        REQUIRE(read_file(target) == payload);
+    }
+
+    SECTION("A checksum mismatch discards the part") {
+        auto const result =
+            download_resumable(client, "/package", target, std::string(64, '0'));
+        REQUIRE_FALSE(result.has_value());
+        REQUIRE(result.error().error_type == ResumableDownloadError::ErrorType::HashMismatch);
+        REQUIRE_FALSE(std::filesystem::exists(target));
+        REQUIRE_FALSE(std::filesystem::exists(part));
+    }
+
+    SECTION("Missing files are reported as HTTP errors") {
+        auto const result = download_resumable(client, "/missing", target);
+        REQUIRE_FALSE(result.has_value());
+        REQUIRE(result.error().error_type == ResumableDownloadError::ErrorType::HttpError);
+        REQUIRE_FALSE(std::filesystem::exists(target));
+    }
+
+    std::filesystem::remove_all(directory);
+}
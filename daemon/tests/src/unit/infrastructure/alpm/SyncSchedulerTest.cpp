@@ -0,0 +1,38 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "infrastructure/alpm/SyncScheduler.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <random>
+#include <set>
+
+using bxt::Infrastructure::SyncScheduler;
+
+TEST_CASE("SyncScheduler::delay", "[infrastructure][alpm]") {
+    using namespace std::chrono_literals;
+
+    std::mt19937_64 random(42);
+
+    SECTION("Without jitter the interval is kept") {
+        REQUIRE(SyncScheduler::delay(3600s, 0s, random) == 3600s);
+        REQUIRE(SyncScheduler::delay(0s, 0s, random) == 0s);
+    }
+
+    SECTION("The jitter is added, up to its bound") {
+        std::set<std::chrono::milliseconds> delays;
+        for (int i = 0; i < 1000; ++i) {
+            auto const delay = SyncScheduler::delay(3600s, 300s, random);
+            REQUIRE(delay >= 3600s);
+            REQUIRE(delay <= 3900s);
+            delays.emplace(delay);
+        }
+
+        // Sections configured alike still get different delays
+        REQUIRE(delays.size() > 900);
+    }
+}
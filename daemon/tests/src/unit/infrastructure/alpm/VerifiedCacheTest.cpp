@@ -0,0 +1,226 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "infrastructure/alpm/VerifiedCache.h"
+
+#include "persistence/lmdb/LmdbUnitOfWork.h"
+#include "utilities/Digest.h"
+#include "utilities/lmdb/Database.h"
+#include "utilities/lmdb/Environment.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <coro/io_scheduler.hpp>
+#include <coro/sync_wait.hpp>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+using bxt::Infrastructure::VerifiedCache;
+using bxt::Infrastructure::VerifiedFile;
+
+namespace {
+
+void write_file(std::filesystem::path const& path, std::string const& contents) {
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    stream << contents;
+}
+
+std::string sha256(std::string const& contents) {
+    auto digest = bxt::Utilities::Digest::sha256();
+    digest.update(contents.data(), contents.size());
+    return digest.hex_digest();
+}
+
+// A cache directory with its entries in a temporary LMDB environment
+struct CacheFixture {
+    std::filesystem::path directory;
+    std::shared_ptr<bxt::Utilities::LMDB::Environment> env;
+    bxt::Persistence::LmdbUnitOfWorkFactory uow_factory;
+    bxt::Infrastructure::HashingService hashing_service {1};
+    std::shared_ptr<coro::io_scheduler> scheduler = coro::io_scheduler::make_shared();
+    bxt::Utilities::LMDB::Database<VerifiedFile> entries;
+
+    explicit CacheFixture(std::string_view name)
+        : directory(std::filesystem::temp_directory_path()
+                    / fmt::format("bxt-{}-{}", name, ::getpid()))
+        , env(open_environment(directory / "lmdb"))
+        , uow_factory(env)
+        , entries(env, "bxt::VerifiedCache") {
+    }
+
+    ~CacheFixture() {
+        std::error_code ec;
+        std::filesystem::remove_all(directory, ec);
+    }
+
+    VerifiedCache cache() {
+        return VerifiedCache({}, env, uow_factory, hashing_service, scheduler);
+    }
+
+    void save(VerifiedCache& cache) {
+        auto uow = coro::sync_wait(uow_factory(true));
+        REQUIRE(coro::sync_wait(cache.save(uow)).has_value());
+        REQUIRE(coro::sync_wait(uow->commit_async()).has_value());
+    }
+
+    // Stores the entry of a file as if it was verified long ago
+    void put_stale(std::filesystem::path const& path, std::string checksum) {
+        auto entry = VerifiedCache::examine(path);
+        REQUIRE(entry.has_value());
+        entry->sha256 = std::move(checksum);
+        entry->verified_at = 0;
+
+        auto txn = coro::sync_wait(env->begin_rw_txn());
+        REQUIRE(coro::sync_wait(entries.put(txn->value, path.string(), *entry)).has_value());
+        txn->value.commit();
+    }
+
+    std::optional<VerifiedFile> entry(std::filesystem::path const& path) {
+        auto txn = coro::sync_wait(env->begin_ro_txn());
+        auto entry = coro::sync_wait(entries.get(txn->value, path.string()));
+        if (!entry.has_value()) {
+            return std::nullopt;
+        }
+        return std::move(*entry);
+    }
+
+private:
+    static std::shared_ptr<bxt::Utilities::LMDB::Environment>
+        open_environment(std::filesystem::path const& path) {
+        std::filesystem::remove_all(path.parent_path());
+        std::filesystem::create_directories(path);
+
+        auto env =
+            std::make_shared<bxt::Utilities::LMDB::Environment>(coro::io_scheduler::make_shared());
+        env->env().set_mapsize(16UL * 1024 * 1024);
+        env->env().set_max_dbs(4);
+        env->env().open(path.c_str(), 0, 0664);
+        return env;
+    }
+};
+
+} // namespace
+
+TEST_CASE("VerifiedCache::matches", "[infrastructure][alpm]") {
+    auto const directory = std::filesystem::temp_directory_path()
+                           / fmt::format("bxt-verified-cache-test-{}", ::getpid());
+    std::filesystem::create_directories(directory);
+    auto const path = directory / "package.pkg.tar.zst";
+
+    write_file(path, "package contents");
+
+    auto entry = VerifiedCache::examine(path);
+    REQUIRE(entry.has_value());
+    REQUIRE(entry->size == 16);
+    entry->sha256 = "checksum";
+
+    SECTION("An untouched file matches its entry") {
+        auto const current = VerifiedCache::examine(path);
+        REQUIRE(current.has_value());
+        REQUIRE(VerifiedCache::matches(*entry, *current));
+    }
+
+    SECTION("A rewritten file doesn't") {
+        write_file(path, "other contents!!");
+        std::filesystem::last_write_time(
+            path, std::filesystem::last_write_time(path) + std::chrono::seconds(1));
+
+        auto const current = VerifiedCache::examine(path);
+        REQUIRE(current.has_value());
+        REQUIRE(current->size == entry->size);
+        REQUIRE_FALSE(VerifiedCache::matches(*entry, *current));
+    }
+
+    SECTION("A replaced file doesn't") {
+        auto const replacement = directory / "replacement";
+        write_file(replacement, "package contents");
+        std::filesystem::last_write_time(replacement, std::filesystem::last_write_time(path));
+        std::filesystem::rename(replacement, path);
+
+        auto const current = VerifiedCache::examine(path);
+        REQUIRE(current.has_value());
+        REQUIRE(current->mtime == entry->mtime);
+        REQUIRE_FALSE(VerifiedCache::matches(*entry, *current));
+    }
+
+    SECTION("Entries without a checksum never match") {
+        entry->sha256.clear();
+        REQUIRE_FALSE(VerifiedCache::matches(*entry, *VerifiedCache::examine(path)));
+    }
+
+    SECTION("Missing files can't be examined") {
+        REQUIRE_FALSE(VerifiedCache::examine(directory / "missing").has_value());
+        REQUIRE_FALSE(VerifiedCache::examine(directory).has_value());
+    }
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("VerifiedCache::sha256", "[infrastructure][alpm]") {
+    CacheFixture fixture("verified-cache-sha256-test");
+    auto const path = fixture.directory / "package.pkg.tar.zst";
+    write_file(path, "package contents");
+
+    auto cache = fixture.cache();
+
+    // A checksum the file doesn't have shows that it wasn't read
+    cache.remember(path, "recorded");
+
+    SECTION("A matching entry is trusted without hashing the file") {
+        REQUIRE(coro::sync_wait(cache.sha256(path)) == "recorded");
+    }
+
+    SECTION("So is a saved one") {
+        fixture.save(cache);
+
+        auto reopened = fixture.cache();
+        REQUIRE(coro::sync_wait(reopened.sha256(path)) == "recorded");
+    }
+
+    SECTION("A changed file is hashed again") {
+        write_file(path, "other package contents");
+
+        REQUIRE(coro::sync_wait(cache.sha256(path)) == sha256("other package contents"));
+    }
+}
+
+TEST_CASE("VerifiedCache::scrub", "[infrastructure][alpm]") {
+    CacheFixture fixture("verified-cache-scrub-test");
+
+    auto const intact = fixture.directory / "intact.pkg.tar.zst";
+    auto const corrupted = fixture.directory / "corrupted.pkg.tar.zst";
+    auto const gone = fixture.directory / "gone.pkg.tar.zst";
+
+    write_file(intact, "intact contents");
+    write_file(corrupted, "corrupted contents");
+    write_file(gone, "gone contents");
+
+    fixture.put_stale(intact, sha256("intact contents"));
+    fixture.put_stale(corrupted, sha256("contents before the corruption"));
+    fixture.put_stale(gone, sha256("gone contents"));
+    std::filesystem::remove(gone);
+
+    auto cache = fixture.cache();
+    auto const stats = coro::sync_wait(cache.scrub());
+
+    REQUIRE(stats.checked == 3);
+    REQUIRE(stats.dropped == 1);
+    REQUIRE(stats.corrupted == 1);
+
+    // Verified again
+    auto const entry = fixture.entry(intact);
+    REQUIRE(entry.has_value());
+    REQUIRE(entry->verified_at > 0);
+
+    // Corrupted files go along with their entries
+    REQUIRE_FALSE(std::filesystem::exists(corrupted));
+    REQUIRE_FALSE(fixture.entry(corrupted).has_value());
+    REQUIRE_FALSE(fixture.entry(gone).has_value());
+}
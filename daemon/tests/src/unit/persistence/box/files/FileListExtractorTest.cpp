@@ -0,0 +1,76 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "persistence/box/files/FileListExtractor.h"
+
+#include "../store/helpers.h"
+
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <coro/io_scheduler.hpp>
+#include <coro/sync_wait.hpp>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <set>
+#include <string>
+
+using namespace bxt::tests;
+using bxt::Utilities::AlpmDb::Desc;
+
+namespace {
+
+// Records the sections to export, `exported` is ready after the first export
+struct Exporter : ExporterBase {
+    std::set<PackageSectionDTO> dirty_sections;
+    std::atomic<int> exports = 0;
+    std::promise<void> first_export;
+    std::future<void> exported = first_export.get_future();
+
+    coro::task<void> export_to_disk() override {
+        if (exports++ == 0) {
+            first_export.set_value();
+        }
+        co_return;
+    }
+    void add_dirty_sections(std::set<PackageSectionDTO>&& sections) override {
+        dirty_sections.merge(sections);
+    }
+};
+
+} // namespace
+
+TEST_CASE("FileListExtractor", "[persistence][box]") {
+    StoreFixture fixture("file-list-extractor-test");
+
+    fixture.put(StoreFixture::record("pending", ""));
+    // Lists of records from before the header was stored
+    fixture.put(StoreFixture::record("legacy", ".MTREE\n"));
+    // Extracted already, the package has no files
+    fixture.put(StoreFixture::record("empty", std::string(Desc::FilesHeader)));
+
+    auto const expected = Desc::extract_files(StoreFixture::package_path());
+    REQUIRE(expected.has_value());
+    REQUIRE(expected->starts_with(Desc::FilesHeader));
+
+    Exporter exporter;
+    auto const scheduler = coro::io_scheduler::make_shared();
+    FileListExtractor extractor(fixture.store, exporter, fixture.uow_factory, scheduler);
+
+    extractor.start();
+    REQUIRE(exporter.exported.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+
+    REQUIRE(fixture.files("pending") == *expected);
+    REQUIRE(fixture.files("legacy") == *expected);
+    REQUIRE(fixture.files("empty") == Desc::FilesHeader);
+
+    // The section is exported once for the batch
+    REQUIRE(exporter.dirty_sections == std::set<PackageSectionDTO> {TestSection});
+    REQUIRE(exporter.exports == 1);
+
+    scheduler->shutdown();
+}
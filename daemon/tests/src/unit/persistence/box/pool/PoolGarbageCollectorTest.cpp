@@ -0,0 +1,159 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "persistence/box/pool/PoolGarbageCollector.h"
+
+#include "helpers.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <coro/io_scheduler.hpp>
+#include <coro/sync_wait.hpp>
+#include <filesystem>
+#include <sys/stat.h>
+
+using namespace bxt::tests;
+
+TEST_CASE("PoolGarbageCollector", "[persistence][box][pool]") {
+    PoolFixture fixture("pool-gc-test");
+    auto const scheduler = coro::io_scheduler::make_shared();
+
+    auto const staging_path = fixture.directory.path / "staging";
+    std::filesystem::create_directories(staging_path);
+
+    // Fresh files are old enough unless a test says otherwise
+    PoolGCOptions options {.grace_period = std::chrono::seconds(0),
+                           .batch_size = 1024,
+                           .staging_paths = {staging_path}};
+
+    auto const linked =
+        fixture.pool.move_to(fixture.incoming("linked-1-1-x86_64.pkg.tar.zst", true));
+    REQUIRE(linked.has_value());
+    auto const& linked_description = linked->descriptions.at(PoolLocation::Overlay);
+
+    auto const orphan = fixture.overlay_path() / "orphan-1-1-x86_64.pkg.tar.zst";
+    write_file(orphan, "orphan");
+    write_file(orphan.string() + ".sig", "signature");
+
+    auto const upload = staging_path / "upload-1-1-x86_64.pkg.tar.zst";
+    write_file(upload, "upload");
+
+    SECTION("Orphans and their signatures are reclaimed, linked files are kept") {
+        PoolGarbageCollector collector(options, fixture.pool, scheduler);
+        coro::sync_wait(collector.pass());
+
+        REQUIRE_FALSE(std::filesystem::exists(orphan));
+        REQUIRE_FALSE(std::filesystem::exists(orphan.string() + ".sig"));
+
+        REQUIRE(std::filesystem::exists(linked_description.filepath));
+        REQUIRE(std::filesystem::exists(*linked_description.signature_path));
+
+        REQUIRE(collector.stats().passes == 1);
+        REQUIRE(collector.stats().reclaimed_files == 3);
+        REQUIRE(collector.stats().reclaimed_bytes == 6 + 9 + 6);
+
+        // Served by GET /api/advanced/pool/gc
+        auto const served = collector.garbage_collection_stats();
+        REQUIRE(served.passes == 1);
+        REQUIRE(served.reclaimed_files == 3);
+        REQUIRE(served.reclaimed_bytes == 6 + 9 + 6);
+    }
+
+    SECTION("Everything in staging paths is an orphan") {
+        PoolGarbageCollector collector(options, fixture.pool, scheduler);
+        coro::sync_wait(collector.pass());
+
+        REQUIRE_FALSE(std::filesystem::exists(upload));
+        REQUIRE(std::filesystem::exists(staging_path));
+    }
+
+    SECTION("Emptied upload directories are removed") {
+        auto const upload_directory = staging_path / "Ab12Cd";
+        write_file(upload_directory / "upload-1-1-x86_64.pkg.tar.zst", "upload");
+        std::filesystem::create_directories(staging_path / "Ef34Gh");
+
+        PoolGarbageCollector collector(options, fixture.pool, scheduler);
+        coro::sync_wait(collector.pass());
+
+        REQUIRE_FALSE(std::filesystem::exists(upload_directory));
+        REQUIRE_FALSE(std::filesystem::exists(staging_path / "Ef34Gh"));
+    }
+
+    SECTION("Files younger than the grace period are kept") {
+        options.grace_period = std::chrono::hours(1);
+        PoolGarbageCollector collector(options, fixture.pool, scheduler);
+        coro::sync_wait(collector.pass());
+
+        REQUIRE(std::filesystem::exists(orphan));
+        REQUIRE(std::filesystem::exists(orphan.string() + ".sig"));
+        REQUIRE(std::filesystem::exists(upload));
+        REQUIRE(collector.stats().reclaimed_files == 0);
+
+        std::filesystem::create_directories(staging_path / "Ab12Cd");
+        coro::sync_wait(collector.pass());
+        REQUIRE(std::filesystem::exists(staging_path / "Ab12Cd"));
+    }
+
+    SECTION("A removed package becomes an orphan") {
+        REQUIRE(fixture.pool.remove(*linked).has_value());
+        write_file(linked_description.filepath, "leftover");
+
+        PoolGarbageCollector collector(options, fixture.pool, scheduler);
+        coro::sync_wait(collector.pass());
+
+        REQUIRE_FALSE(std::filesystem::exists(linked_description.filepath));
+    }
+}
+
+TEST_CASE("Pool::remove_if_unlinked", "[persistence][box][pool]") {
+    PoolFixture fixture("pool-remove-if-unlinked-test");
+
+    auto const stat_of = [](std::filesystem::path const& path) {
+        struct stat status {};
+        REQUIRE(::lstat(path.c_str(), &status) == 0);
+        return status;
+    };
+
+    SECTION("Linked files and their signatures are kept") {
+        auto const linked =
+            fixture.pool.move_to(fixture.incoming("linked-1-1-x86_64.pkg.tar.zst", true));
+        REQUIRE(linked.has_value());
+        auto const& description = linked->descriptions.at(PoolLocation::Overlay);
+
+        auto const status = stat_of(description.filepath);
+        REQUIRE(fixture.pool.remove_if_unlinked(description.filepath, status.st_dev,
+                                                status.st_ino)
+                == false);
+
+        auto const signature_status = stat_of(*description.signature_path);
+        REQUIRE(fixture.pool.remove_if_unlinked(*description.signature_path,
+                                                signature_status.st_dev, signature_status.st_ino)
+                == false);
+
+        REQUIRE(std::filesystem::exists(description.filepath));
+        REQUIRE(std::filesystem::exists(*description.signature_path));
+        REQUIRE(fixture.pool.is_linked(description.filepath));
+    }
+
+    SECTION("A file replaced since it was inspected is kept") {
+        auto const path = fixture.overlay_path() / "orphan-1-1-x86_64.pkg.tar.zst";
+        write_file(path, "orphan");
+        auto const inspected = stat_of(path);
+
+        auto const replacement = fixture.directory.path / "replacement";
+        write_file(replacement, "replacement");
+        std::filesystem::rename(replacement, path);
+
+        REQUIRE(fixture.pool.remove_if_unlinked(path, inspected.st_dev, inspected.st_ino)
+                == false);
+        REQUIRE(std::filesystem::exists(path));
+
+        auto const current = stat_of(path);
+        REQUIRE(fixture.pool.remove_if_unlinked(path, current.st_dev, current.st_ino) == true);
+        REQUIRE_FALSE(std::filesystem::exists(path));
+        REQUIRE_FALSE(fixture.pool.is_linked(path));
+    }
+}
@@ -0,0 +1,232 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "persistence/box/pool/PoolLayoutMigrator.h"
+
+#include "helpers.h"
+
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <coro/io_scheduler.hpp>
+#include <coro/sync_wait.hpp>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+using namespace bxt::tests;
+using bxt::DatabaseError;
+
+namespace {
+
+// Runs the hooks the way the LMDB unit of work does, or throws on commit
+struct HookedUnitOfWork : UnitOfWork {
+    bool fail_commit = false;
+    std::vector<std::function<void()>> pre_hooks;
+    std::vector<std::function<void()>> post_hooks;
+
+    coro::task<Result<void>> commit_async() override {
+        for (auto const& hook : pre_hooks) {
+            hook();
+        }
+        if (fail_commit) {
+            throw std::runtime_error("MDB_MAP_FULL");
+        }
+        for (auto const& hook : post_hooks) {
+            hook();
+        }
+        co_return {};
+    }
+    void pre_hook(std::function<void()>&& hook, std::string const&) override {
+        pre_hooks.emplace_back(std::move(hook));
+    }
+    void post_hook(std::function<void()>&& hook, std::string const&) override {
+        post_hooks.emplace_back(std::move(hook));
+    }
+};
+
+struct HookedUnitOfWorkFactory : UnitOfWorkBaseFactory {
+    bool fail_commit = false;
+
+    coro::task<std::shared_ptr<UnitOfWorkBase>> operator()(bool) override {
+        auto uow = std::make_shared<HookedUnitOfWork>();
+        uow->fail_commit = fail_commit;
+        co_return uow;
+    }
+};
+
+// Relocates records the way the LMDB store does, without a database
+struct PackageStore : PackageStoreBase {
+    Pool& pool;
+    std::map<std::string, PackageRecord> records;
+
+    explicit PackageStore(Pool& pool)
+        : pool(pool) {
+    }
+
+    coro::task<std::expected<void, DatabaseError>> add(PackageRecord const,
+                                                       std::shared_ptr<UnitOfWorkBase>) override {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+    coro::task<std::expected<void, DatabaseError>>
+        update(PackageRecord const, std::shared_ptr<UnitOfWorkBase>) override {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+    coro::task<std::expected<void, DatabaseError>>
+        delete_by_id(PackageRecord::Id const, std::shared_ptr<UnitOfWorkBase>) override {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+    }
+    coro::task<std::expected<bool, DatabaseError>>
+        remove_location(PackageRecord::Id const,
+                        PoolLocation const,
+                        std::shared_ptr<UnitOfWorkBase>) override {
+        co_return false;
+    }
+
+    coro::task<std::expected<std::optional<Relocation>, DatabaseError>>
+        relocate(PackageRecord::Id const package_id,
+                 std::shared_ptr<UnitOfWorkBase> uow) override {
+        auto const record = records.find(package_id.to_string());
+        if (record == records.end()) {
+            co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::EntityNotFound);
+        }
+
+        auto relocated = pool.relocate(record->second);
+        if (!relocated.has_value()) {
+            co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidArgument);
+        }
+
+        auto previous = record->second;
+        uow->post_hook(
+            [this, previous, relocated = *relocated] {
+                records.insert_or_assign(relocated.id.to_string(), relocated);
+                pool.release_links(previous);
+            },
+            "");
+        // The test records have a single description, all of it is relocated
+        co_return Relocation {.previous = std::move(previous), .linked = *relocated};
+    }
+
+    coro::task<std::expected<bool, DatabaseError>>
+        attach_files(PackageRecord::Id const,
+                     PoolLocation const,
+                     std::filesystem::path const,
+                     std::string const,
+                     std::shared_ptr<UnitOfWorkBase>) override {
+        co_return false;
+    }
+    coro::task<std::expected<PackageRecord, DatabaseError>>
+        find_by_id(PackageRecord::Id const, std::shared_ptr<UnitOfWorkBase>) override {
+        co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::EntityNotFound);
+    }
+    coro::task<std::expected<std::vector<PackageRecord>, DatabaseError>>
+        find_by_section(PackageSectionDTO, std::shared_ptr<UnitOfWorkBase>) override {
+        co_return std::vector<PackageRecord> {};
+    }
+
+    coro::task<std::expected<void, DatabaseError>> accept(
+        std::function<bxt::Utilities::NavigationAction(std::string_view, PackageRecord const&)>
+            visitor,
+        std::string_view,
+        std::shared_ptr<UnitOfWorkBase> uow) override {
+        co_return co_await accept(std::move(visitor), uow);
+    }
+    coro::task<std::expected<void, DatabaseError>> accept(
+        std::function<bxt::Utilities::NavigationAction(std::string_view, PackageRecord const&)>
+            visitor,
+        std::shared_ptr<UnitOfWorkBase>) override {
+        for (auto const& [key, record] : records) {
+            visitor(key, record);
+        }
+        co_return {};
+    }
+};
+
+struct Exporter : ExporterBase {
+    std::atomic<int> exports = 0;
+
+    coro::task<void> export_to_disk() override {
+        exports += 1;
+        co_return;
+    }
+    void add_dirty_sections(std::set<PackageSectionDTO>&&) override {
+    }
+};
+
+void wait_until_finished(PoolLayoutMigrator& migrator) {
+    coro::sync_wait(migrator.wait_until_finished());
+    REQUIRE_FALSE(migrator.is_running());
+}
+
+} // namespace
+
+TEST_CASE("PoolLayoutMigrator", "[persistence][box][pool]") {
+    PoolFixture fixture("pool-migrator-test");
+
+    auto const moved =
+        fixture.pool.move_to(fixture.incoming("package-1-1-x86_64.pkg.tar.zst", true));
+    REQUIRE(moved.has_value());
+    auto const& previous = moved->descriptions.at(PoolLocation::Overlay);
+
+    // The same box opened again after hash sharding was enabled
+    PoolOptions sharded_options;
+    sharded_options.sharding.emplace("x86_64", PoolSharding::HashPrefix);
+    Pool pool(fixture.box_options, sharded_options, fixture.section_repository,
+              fixture.uow_factory);
+
+    PackageStore store(pool);
+    store.records.emplace(moved->id.to_string(), *moved);
+
+    auto const scheduler = coro::io_scheduler::make_shared();
+    Exporter exporter;
+    HookedUnitOfWorkFactory uow_factory;
+
+    auto const target = fixture.overlay_path() / "71" / "package-1-1-x86_64.pkg.tar.zst";
+
+    SECTION("Records are moved to the new layout and the old names removed") {
+        PoolLayoutMigrator migrator(store, pool, exporter, uow_factory, scheduler);
+        REQUIRE(coro::sync_wait(migrator.migrate_layout()).has_value());
+        wait_until_finished(migrator);
+
+        auto const& description = store.records.begin()->second.descriptions.at(
+            PoolLocation::Overlay);
+        REQUIRE(description.filepath == target);
+        REQUIRE(std::filesystem::exists(target));
+        REQUIRE(std::filesystem::exists(*description.signature_path));
+        REQUIRE(pool.is_linked(target));
+
+        REQUIRE(exporter.exports == 1);
+        REQUIRE_FALSE(std::filesystem::exists(previous.filepath));
+        REQUIRE_FALSE(std::filesystem::exists(*previous.signature_path));
+    }
+
+    SECTION("A batch that fails to commit keeps its records and ends the migration") {
+        uow_factory.fail_commit = true;
+
+        PoolLayoutMigrator migrator(store, pool, exporter, uow_factory, scheduler);
+        REQUIRE(coro::sync_wait(migrator.migrate_layout()).has_value());
+        wait_until_finished(migrator);
+
+        REQUIRE(store.records.begin()->second.descriptions.at(PoolLocation::Overlay).filepath
+                == previous.filepath);
+        REQUIRE(std::filesystem::exists(previous.filepath));
+        REQUIRE(std::filesystem::exists(*previous.signature_path));
+
+        // The names linked for the batch are released and removed
+        REQUIRE_FALSE(pool.is_linked(target));
+        REQUIRE_FALSE(std::filesystem::exists(target));
+        REQUIRE_FALSE(std::filesystem::exists(target.string() + ".sig"));
+
+        // Another migration can be started
+        uow_factory.fail_commit = false;
+        REQUIRE(coro::sync_wait(migrator.migrate_layout()).has_value());
+        wait_until_finished(migrator);
+        REQUIRE(std::filesystem::exists(target));
+    }
+}
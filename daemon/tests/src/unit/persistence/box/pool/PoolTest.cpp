@@ -0,0 +1,143 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "persistence/box/pool/Pool.h"
+
+#include "helpers.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fmt/format.h>
+
+using namespace bxt::tests;
+
+TEST_CASE("Pool::move_to", "[persistence][box][pool]") {
+    PoolFixture fixture("pool-move-test");
+
+    SECTION("Files are moved into the resolved pool directory") {
+        auto const package = fixture.incoming("package-1-1-x86_64.pkg.tar.zst", true);
+        auto const& source = package.descriptions.at(PoolLocation::Overlay);
+
+        auto const expected = fixture.pool.path_for_package(package);
+        REQUIRE(expected.has_value());
+
+        auto const moved = fixture.pool.move_to(package);
+        REQUIRE(moved.has_value());
+
+        auto const& description = moved->descriptions.at(PoolLocation::Overlay);
+        REQUIRE(description.filepath
+                == fixture.overlay_path() / "package-1-1-x86_64.pkg.tar.zst");
+        REQUIRE(description.filepath
+                == expected->descriptions.at(PoolLocation::Overlay).filepath);
+        REQUIRE(description.signature_path
+                == expected->descriptions.at(PoolLocation::Overlay).signature_path);
+
+        REQUIRE(std::filesystem::exists(description.filepath));
+        REQUIRE(std::filesystem::exists(*description.signature_path));
+        REQUIRE_FALSE(std::filesystem::exists(source.filepath));
+        REQUIRE_FALSE(std::filesystem::exists(*source.signature_path));
+        REQUIRE(fixture.pool.is_linked(description.filepath));
+    }
+
+    SECTION("A failed signature move drops the link count") {
+        auto package = fixture.incoming("package-1-1-x86_64.pkg.tar.zst");
+        package.descriptions.at(PoolLocation::Overlay).signature_path =
+            fixture.directory.path / "missing.sig";
+
+        REQUIRE_FALSE(fixture.pool.move_to(package).has_value());
+        REQUIRE_FALSE(fixture.pool.is_linked(fixture.overlay_path()
+                                             / "package-1-1-x86_64.pkg.tar.zst"));
+    }
+}
+
+TEST_CASE("Pool::remove", "[persistence][box][pool]") {
+    PoolFixture fixture("pool-remove-test");
+
+    auto const moved =
+        fixture.pool.move_to(fixture.incoming("package-1-1-x86_64.pkg.tar.zst", true));
+    REQUIRE(moved.has_value());
+    auto const& description = moved->descriptions.at(PoolLocation::Overlay);
+
+    SECTION("The file and its signature are unlinked") {
+        REQUIRE(fixture.pool.remove(*moved).has_value());
+
+        REQUIRE_FALSE(std::filesystem::exists(description.filepath));
+        REQUIRE_FALSE(std::filesystem::exists(*description.signature_path));
+        REQUIRE_FALSE(fixture.pool.is_linked(description.filepath));
+    }
+
+    SECTION("Files shared by several records are kept until the last one is removed") {
+        REQUIRE(fixture.pool.move_to(fixture.incoming("package-1-1-x86_64.pkg.tar.zst", true))
+                    .has_value());
+
+        REQUIRE(fixture.pool.remove(*moved).has_value());
+        REQUIRE(std::filesystem::exists(description.filepath));
+        REQUIRE(fixture.pool.is_linked(description.filepath));
+
+        REQUIRE(fixture.pool.remove(*moved).has_value());
+        REQUIRE_FALSE(std::filesystem::exists(description.filepath));
+    }
+}
+
+TEST_CASE("Pool::relative_path_for", "[persistence][box][pool]") {
+    constexpr auto Filename = "package-1-1-x86_64.pkg.tar.zst";
+
+    SECTION("Flat pools use the file name") {
+        REQUIRE(Pool::relative_path_for(PoolSharding::None, Filename) == Filename);
+    }
+
+    SECTION("Name prefix shards by the first two characters") {
+        REQUIRE(Pool::relative_path_for(PoolSharding::NamePrefix, Filename)
+                == "pa/package-1-1-x86_64.pkg.tar.zst");
+        REQUIRE(Pool::relative_path_for(PoolSharding::NamePrefix, "x") == "x/x");
+    }
+
+    SECTION("Hash prefix shards by the low byte of the FNV-1a hash") {
+        REQUIRE(Pool::relative_path_for(PoolSharding::HashPrefix, Filename)
+                == "71/package-1-1-x86_64.pkg.tar.zst");
+        REQUIRE(
+            Pool::relative_path_for(PoolSharding::HashPrefix, "linux-6.6.1-1-x86_64.pkg.tar.zst")
+            == "03/linux-6.6.1-1-x86_64.pkg.tar.zst");
+    }
+
+    SECTION("Signatures are sharded with their package") {
+        REQUIRE(Pool::relative_path_for(PoolSharding::NamePrefix, "package.sig")
+                == "pa/package.sig");
+        REQUIRE(Pool::relative_path_for(PoolSharding::HashPrefix, fmt::format("{}.sig", Filename))
+                == "71/package-1-1-x86_64.pkg.tar.zst.sig");
+    }
+}
+
+TEST_CASE("Pool::relocate", "[persistence][box][pool]") {
+    PoolFixture fixture("pool-relocate-test");
+
+    auto const moved =
+        fixture.pool.move_to(fixture.incoming("package-1-1-x86_64.pkg.tar.zst", true));
+    REQUIRE(moved.has_value());
+    auto const& previous = moved->descriptions.at(PoolLocation::Overlay);
+
+    PoolOptions sharded_options;
+    sharded_options.sharding.emplace("x86_64", PoolSharding::HashPrefix);
+    Pool sharded(fixture.box_options, sharded_options, fixture.section_repository,
+                 fixture.uow_factory);
+
+    auto const relocated = sharded.relocate(*moved);
+    REQUIRE(relocated.has_value());
+    auto const& description = relocated->descriptions.at(PoolLocation::Overlay);
+
+    REQUIRE(description.filepath
+            == fixture.overlay_path() / "71" / "package-1-1-x86_64.pkg.tar.zst");
+    REQUIRE(std::filesystem::exists(description.filepath));
+    REQUIRE(std::filesystem::exists(*description.signature_path));
+    REQUIRE(sharded.is_linked(description.filepath));
+
+    // The previous names are left for the sections exported before
+    REQUIRE(std::filesystem::exists(previous.filepath));
+    REQUIRE(std::filesystem::exists(*previous.signature_path));
+
+    sharded.release_links(*relocated);
+    REQUIRE_FALSE(sharded.is_linked(description.filepath));
+}
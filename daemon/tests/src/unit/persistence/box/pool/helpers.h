@@ -0,0 +1,147 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+#pragma once
+#include "core/domain/entities/Section.h"
+#include "core/domain/repositories/ReadOnlyRepositoryBase.h"
+#include "core/domain/repositories/UnitOfWorkBase.h"
+#include "persistence/box/BoxOptions.h"
+#include "persistence/box/pool/Pool.h"
+#include "persistence/box/pool/PoolOptions.h"
+#include "persistence/box/record/PackageRecord.h"
+
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace bxt::tests {
+using namespace bxt::Core::Domain;
+using namespace bxt::Persistence::Box;
+using Core::Application::PackageSectionDTO;
+
+struct UnitOfWork : UnitOfWorkBase {
+    coro::task<Result<void>> commit_async() override {
+        co_return {};
+    }
+    coro::task<Result<void>> rollback_async() override {
+        co_return {};
+    }
+    coro::task<Result<void>> begin_async() override {
+        co_return {};
+    }
+    coro::task<Result<void>> begin_ro_async() override {
+        co_return {};
+    }
+    void pre_hook(std::function<void()>&&, std::string const&) override {
+    }
+    void post_hook(std::function<void()>&&, std::string const&) override {
+    }
+};
+
+struct UnitOfWorkFactory : UnitOfWorkBaseFactory {
+    coro::task<std::shared_ptr<UnitOfWorkBase>> operator()(bool) override {
+        co_return std::make_shared<UnitOfWork>();
+    }
+};
+
+struct SectionRepository : ReadOnlyRepositoryBase<Section> {
+    std::vector<Section> sections {Section {Name {"unstable"}, Name {"core"}, Name {"x86_64"}}};
+
+    coro::task<TResult> find_by_id_async(TId, std::shared_ptr<UnitOfWorkBase>) override {
+        co_return bxt::make_error<ReadError>(ReadError::EntityNotFound);
+    }
+    coro::task<TResult> find_first_async(std::function<bool(Section const&)>,
+                                         std::shared_ptr<UnitOfWorkBase>) override {
+        co_return bxt::make_error<ReadError>(ReadError::EntityNotFound);
+    }
+    coro::task<TResults> find_async(std::function<bool(Section const&)>,
+                                    std::shared_ptr<UnitOfWorkBase>) override {
+        co_return sections;
+    }
+    coro::task<TResults> all_async(std::shared_ptr<UnitOfWorkBase>) override {
+        co_return sections;
+    }
+};
+
+// A directory that is removed with everything in it
+struct TemporaryDirectory {
+    std::filesystem::path path;
+
+    explicit TemporaryDirectory(std::string_view name)
+        : path(std::filesystem::temp_directory_path()
+               / fmt::format("bxt-{}-{}", name, ::getpid())) {
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directories(path);
+    }
+
+    ~TemporaryDirectory() {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    }
+};
+
+inline void write_file(std::filesystem::path const& path, std::string const& contents) {
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    stream << contents;
+}
+
+// A pool in a temporary box with the sections of `SectionRepository`
+struct PoolFixture {
+    TemporaryDirectory directory;
+    BoxOptions box_options;
+    PoolOptions pool_options;
+    SectionRepository section_repository;
+    UnitOfWorkFactory uow_factory;
+    Pool pool;
+
+    explicit PoolFixture(std::string_view name, PoolSharding sharding = PoolSharding::None)
+        : directory(name)
+        , box_options {.box_path = directory.path / "box"}
+        , pool_options(make_options(sharding))
+        , pool(box_options, pool_options, section_repository, uow_factory) {
+    }
+
+    // Canonical directory of the overlay pool for x86_64
+    std::filesystem::path overlay_path() const {
+        return std::filesystem::canonical(pool.pool_path() / "overlay" / "x86_64");
+    }
+
+    // Record of a package file written to the incoming directory
+    PackageRecord incoming(std::string const& filename, bool signed_package = false) const {
+        auto const path = directory.path / "incoming" / filename;
+        write_file(path, filename);
+
+        PackageRecord::Description description {.filepath = path};
+        if (signed_package) {
+            description.signature_path = fmt::format("{}.sig", path.string());
+            write_file(*description.signature_path, "signature");
+        }
+
+        PackageSectionDTO const section {
+            .branch = "unstable", .repository = "core", .architecture = "x86_64"};
+
+        return PackageRecord {.id = {.section = section,
+                                     .name = filename.substr(0, filename.find('-'))},
+                              .descriptions = {{PoolLocation::Overlay, std::move(description)}}};
+    }
+
+private:
+    static PoolOptions make_options(PoolSharding sharding) {
+        PoolOptions options;
+        if (sharding != PoolSharding::None) {
+            options.sharding.emplace("x86_64", sharding);
+        }
+        return options;
+    }
+};
+
+} // namespace bxt::tests
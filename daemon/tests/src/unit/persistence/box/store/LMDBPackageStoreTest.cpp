@@ -0,0 +1,122 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "persistence/box/store/LMDBPackageStore.h"
+
+#include "helpers.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <coro/sync_wait.hpp>
+#include <filesystem>
+#include <string>
+
+using namespace bxt::tests;
+using bxt::DatabaseError;
+using bxt::Utilities::AlpmDb::Desc;
+
+TEST_CASE("LMDBPackageStore::attach_files", "[persistence][box]") {
+    StoreFixture fixture("attach-files-test");
+    fixture.put(StoreFixture::record("dummy", ""));
+
+    std::string const files = fmt::format("{}usr/\n", Desc::FilesHeader);
+    PackageRecord::Id const id {TestSection, "dummy"};
+
+    auto attach = [&](PackageRecord::Id const& package_id, std::filesystem::path const& path) {
+        auto uow = coro::sync_wait(fixture.uow_factory(true));
+        auto attached = coro::sync_wait(
+            fixture.store.attach_files(package_id, PoolLocation::Sync, path, files, uow));
+        REQUIRE(coro::sync_wait(uow->commit_async()).has_value());
+        return attached;
+    };
+
+    SECTION("The list goes to the description of the same file") {
+        auto const attached = attach(id, StoreFixture::package_path());
+
+        REQUIRE(attached.has_value());
+        REQUIRE(*attached);
+        REQUIRE(fixture.files("dummy") == files);
+    }
+
+    SECTION("A description that was replaced in the meantime is kept") {
+        auto const attached = attach(id, "/nonexistent/dummy-2-1-any.pkg.tar.zst");
+
+        REQUIRE(attached.has_value());
+        REQUIRE_FALSE(*attached);
+        REQUIRE(fixture.files("dummy").empty());
+    }
+
+    SECTION("Records removed in the meantime are not found") {
+        auto const attached = attach({TestSection, "removed"}, StoreFixture::package_path());
+
+        REQUIRE_FALSE(attached.has_value());
+        REQUIRE(attached.error().error_type == DatabaseError::ErrorType::EntityNotFound);
+    }
+
+    SECTION("Records that can't be read are reported as such") {
+        fixture.put_malformed("malformed");
+
+        auto const attached = attach({TestSection, "malformed"}, StoreFixture::package_path());
+
+        REQUIRE_FALSE(attached.has_value());
+        REQUIRE(attached.error().error_type == DatabaseError::ErrorType::DatabaseMalformedError);
+    }
+}
+
+TEST_CASE("LMDBPackageStore::remove_location", "[persistence][box]") {
+    StoreFixture fixture("remove-location-test");
+
+    // The removed location's file goes with the commit
+    auto const sync_path = fixture.pool_fixture.directory.path / "dummy-1-1-any.pkg.tar.zst";
+    write_file(sync_path, "package");
+
+    auto record = StoreFixture::record("dummy", "", sync_path);
+    record.descriptions.emplace(PoolLocation::Overlay,
+                                record.descriptions.at(PoolLocation::Sync));
+    record.descriptions.at(PoolLocation::Overlay).filepath = StoreFixture::package_path();
+    fixture.put(record);
+
+    auto remove = [&](std::string const& name) {
+        auto uow = coro::sync_wait(fixture.uow_factory(true));
+        auto removed = coro::sync_wait(fixture.store.remove_location(
+            {TestSection, name}, PoolLocation::Sync, uow));
+        REQUIRE(coro::sync_wait(uow->commit_async()).has_value());
+        return removed;
+    };
+
+    SECTION("The location is removed, the rest of the record kept") {
+        auto const removed = remove("dummy");
+
+        REQUIRE(removed.has_value());
+        REQUIRE(*removed);
+        REQUIRE_FALSE(std::filesystem::exists(sync_path));
+
+        auto const kept = fixture.find("dummy");
+        REQUIRE(kept.has_value());
+        REQUIRE(kept->descriptions.size() == 1);
+        REQUIRE(kept->descriptions.contains(PoolLocation::Overlay));
+
+        // Gone already
+        auto const again = remove("dummy");
+        REQUIRE(again.has_value());
+        REQUIRE_FALSE(*again);
+    }
+
+    SECTION("Records removed in the meantime have nothing to remove") {
+        auto const removed = remove("removed");
+
+        REQUIRE(removed.has_value());
+        REQUIRE_FALSE(*removed);
+    }
+
+    SECTION("Records that can't be read fail the removal") {
+        fixture.put_malformed("malformed");
+
+        auto const removed = remove("malformed");
+
+        REQUIRE_FALSE(removed.has_value());
+        REQUIRE(removed.error().error_type == DatabaseError::ErrorType::DatabaseMalformedError);
+    }
+}
@@ -0,0 +1,114 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+#pragma once
+#include "../pool/helpers.h"
+#include "persistence/box/store/LMDBPackageStore.h"
+#include "persistence/lmdb/LmdbUnitOfWork.h"
+#include "utilities/lmdb/Database.h"
+#include "utilities/lmdb/Environment.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <coro/io_scheduler.hpp>
+#include <coro/sync_wait.hpp>
+#include <filesystem>
+#include <fmt/format.h>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace bxt::tests {
+
+inline PackageSectionDTO const TestSection {
+    .branch = "unstable", .repository = "core", .architecture = "x86_64"};
+
+// The LMDB store of a temporary box, records are written to its database
+// directly
+struct StoreFixture {
+    PoolFixture pool_fixture;
+    std::shared_ptr<Utilities::LMDB::Environment> env;
+    Persistence::LmdbUnitOfWorkFactory uow_factory;
+    LMDBPackageStore store;
+    Utilities::LMDB::Database<PackageRecord> records;
+
+    explicit StoreFixture(std::string_view name)
+        : pool_fixture(name)
+        , env(open_environment(pool_fixture.directory.path / "lmdb"))
+        , uow_factory(env)
+        , store(pool_fixture.box_options,
+                env,
+                pool_fixture.pool,
+                pool_fixture.section_repository,
+                "bxt::Box")
+        , records(env, "bxt::Box") {
+    }
+
+    static std::filesystem::path package_path() {
+        return std::filesystem::absolute("data/dummy-1-1-any.pkg.tar.zst");
+    }
+
+    // A record of the test data package with the given file list
+    static PackageRecord record(std::string const& name,
+                                std::string files,
+                                std::filesystem::path const& path = package_path()) {
+        PackageRecord::Description description {
+            .filepath = path,
+            .descfile = Utilities::AlpmDb::Desc(
+                fmt::format("%NAME%\n{}\n\n%VERSION%\n1-1\n", name), std::move(files))};
+
+        return PackageRecord {.id = {.section = TestSection, .name = name},
+                              .descriptions = {{PoolLocation::Sync, std::move(description)}}};
+    }
+
+    void put(PackageRecord const& record) {
+        auto txn = coro::sync_wait(env->begin_rw_txn());
+        REQUIRE(coro::sync_wait(records.put(txn->value, record.id.to_string(), record))
+                    .has_value());
+        txn->value.commit();
+    }
+
+    // Stores bytes that aren't a record
+    void put_malformed(std::string const& name) {
+        auto txn = coro::sync_wait(env->begin_rw_txn());
+        auto dbi = lmdb::dbi::open(txn->value, "bxt::Box");
+        dbi.put(txn->value, PackageRecord::Id {TestSection, name}.to_string(),
+                std::string_view("garbage"));
+        txn->value.commit();
+    }
+
+    std::optional<PackageRecord> find(std::string const& name) {
+        auto txn = coro::sync_wait(env->begin_ro_txn());
+        auto record = coro::sync_wait(
+            records.get(txn->value, PackageRecord::Id {TestSection, name}.to_string()));
+        if (!record.has_value()) {
+            return std::nullopt;
+        }
+        return std::move(*record);
+    }
+
+    std::string files(std::string const& name) {
+        auto const record = find(name);
+        REQUIRE(record.has_value());
+        return record->descriptions.at(PoolLocation::Sync).descfile.files;
+    }
+
+private:
+    static std::shared_ptr<Utilities::LMDB::Environment>
+        open_environment(std::filesystem::path const& path) {
+        std::filesystem::create_directories(path);
+
+        auto env =
+            std::make_shared<Utilities::LMDB::Environment>(coro::io_scheduler::make_shared());
+        env->env().set_mapsize(64UL * 1024 * 1024);
+        env->env().set_max_dbs(16);
+        env->env().open(path.c_str(), 0, 0664);
+        return env;
+    }
+};
+
+} // namespace bxt::tests
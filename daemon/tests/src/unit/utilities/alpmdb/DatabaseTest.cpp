@@ -0,0 +1,35 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "utilities/alpmdb/Database.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <coro/sync_wait.hpp>
+#include <coro/thread_pool.hpp>
+
+using namespace bxt::Utilities::AlpmDb;
+
+TEST_CASE("DatabaseUtils::parse_packages", "[utilities][alpmdb]") {
+    coro::thread_pool pool {coro::thread_pool::options {.thread_count = 2}};
+
+    SECTION("Parses valid packages and reports invalid ones") {
+        auto const parsed = coro::sync_wait(DatabaseUtils::parse_packages(
+            pool, {"data/dummy-1-1-any.pkg.tar.zst", "data/missing-1-1-any.pkg.tar.zst"}));
+
+        REQUIRE(parsed.descriptions.size() == 1);
+        REQUIRE(parsed.descriptions.contains("dummy-1-1"));
+
+        REQUIRE(parsed.errors.size() == 1);
+        REQUIRE(parsed.errors.front().filepath == "data/missing-1-1-any.pkg.tar.zst");
+    }
+
+    SECTION("Empty input") {
+        auto const parsed = coro::sync_wait(DatabaseUtils::parse_packages(pool, {}));
+
+        REQUIRE(parsed.descriptions.empty());
+        REQUIRE(parsed.errors.empty());
+    }
+}
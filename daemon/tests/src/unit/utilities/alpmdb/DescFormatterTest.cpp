@@ -0,0 +1,80 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "utilities/alpmdb/DescFormatter.h"
+
+#include "utilities/alpmdb/Desc.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using namespace bxt::Utilities::AlpmDb;
+
+namespace {
+
+std::string read_file(std::filesystem::path const& path) {
+    std::ifstream stream(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+}
+
+} // namespace
+
+TEST_CASE("DescFormatter", "[utilities][alpmdb]") {
+    SECTION("The desc of a package matches the one of repo-add") {
+        std::filesystem::path const path = "data/dummy-1-1-any.pkg.tar.zst";
+        auto const signature = read_file("data/dummy-1-1-any.pkg.tar.zst.sig");
+
+        auto const desc = Desc::parse_package(path, signature, false);
+        REQUIRE(desc.has_value());
+
+        // The empty "url = " of the package is left out
+        REQUIRE(desc->desc
+                == "%FILENAME%\ndummy-1-1-any.pkg.tar.zst\n\n"
+                   "%NAME%\ndummy\n\n"
+                   "%BASE%\ndummy\n\n"
+                   "%VERSION%\n1-1\n\n"
+                   "%DESC%\nTest dummy package\n\n"
+                   "%CSIZE%\n19459\n\n"
+                   "%ISIZE%\n0\n\n"
+                   "%MD5SUM%\na63647944d6ad9071e25a6faa0461cf6\n\n"
+                   "%SHA256SUM%\n"
+                   "5bfac5734e0adfafc30bf1a7f346112b5d4a310b8a690900de6e890590fdb66c\n\n"
+                   "%PGPSIG%\n"
+                   "iIoEABYKADIWIQSDbgfAmJHsU0DFhtnG7oBEmscG0gUCZvLauRQcYWdyaW5ldkBtYW5qYXJvLm9y"
+                   "ZwAKCRDG7oBEmscG0jSCAQDXAaf0al/To5NL6l+z9HPXFMUfZZIjyzGPOnupo3EAbwD/U1JokGsp"
+                   "sFZSULmhfaLH8dAfnOJbWROKwkzuDS4FhQw=\n\n"
+                   "%ARCH%\nany\n\n"
+                   "%BUILDDATE%\n1727191436\n\n"
+                   "%PACKAGER%\nUnknown Packager\n\n");
+    }
+
+    SECTION("Repeated keys become multi-value fields, unknown keys are left out") {
+        PkgInfo pkg_info;
+        pkg_info.parse("pkgname = package\n"
+                       "pkgver = 1.0-1\n"
+                       "license = GPL-2.0-or-later\n"
+                       "license = MIT\n"
+                       "depend = glibc\n"
+                       "custom = value\n"
+                       "depend = bash\n");
+
+        DescFormatter const formatter(pkg_info, "package-1.0-1-x86_64.pkg.tar.zst", "",
+                                      {.size = 1, .md5 = "md5", .sha256 = "sha256"});
+
+        REQUIRE(formatter.format()
+                == "%FILENAME%\npackage-1.0-1-x86_64.pkg.tar.zst\n\n"
+                   "%NAME%\npackage\n\n"
+                   "%VERSION%\n1.0-1\n\n"
+                   "%CSIZE%\n1\n\n"
+                   "%MD5SUM%\nmd5\n\n"
+                   "%SHA256SUM%\nsha256\n\n"
+                   "%LICENSE%\nGPL-2.0-or-later\nMIT\n\n"
+                   "%DEPENDS%\nglibc\nbash\n\n");
+    }
+}
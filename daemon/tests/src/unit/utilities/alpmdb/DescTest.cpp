@@ -0,0 +1,170 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "utilities/alpmdb/Desc.h"
+#include "utilities/Digest.h"
+#include "utilities/libarchive/Reader.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cstdlib>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <iterator>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace bxt::Utilities::AlpmDb;
+
+namespace {
+
+std::string make_desc(std::size_t index) {
+    return fmt::format("%FILENAME%\npackage{0}-1.0-1-x86_64.pkg.tar.zst\n\n"
+                       "%NAME%\npackage{0}\n\n"
+                       "%BASE%\npackage{0}\n\n"
+                       "%VERSION%\n1.0-1\n\n"
+                       "%DESC%\nSynthetic package number {0}\n\n"
+                       "%CSIZE%\n123456\n\n"
+                       "%ISIZE%\n654321\n\n"
+                       "%MD5SUM%\n0123456789abcdef0123456789abcdef\n\n"
+                       "%SHA256SUM%\n"
+                       "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef\n\n"
+                       "%PGPSIG%\niHUEABYKAB0WIQQ=\n\n"
+                       "%URL%\nhttps://example.org/package{0}\n\n"
+                       "%LICENSE%\nGPL-3.0-or-later\n\n"
+                       "%ARCH%\nx86_64\n\n"
+                       "%BUILDDATE%\n1700000000\n\n"
+                       "%PACKAGER%\nPackager <packager@example.org>\n\n"
+                       "%DEPENDS%\nglibc\nbash\nzstd\nlibarchive\n\n"
+                       "%MAKEDEPENDS%\ncmake\nninja\n\n",
+                       index);
+}
+
+// Reads the desc entries of the databases listed in BXT_BENCHMARK_DATABASES
+// (e.g. "core.db:extra.db"), falls back to a synthetic database of a similar
+// size.
+std::vector<std::string> load_benchmark_descs() {
+    std::vector<std::string> descs;
+
+    if (auto const* databases = std::getenv("BXT_BENCHMARK_DATABASES")) {
+        std::istringstream database_list(databases);
+        for (std::string path; std::getline(database_list, path, ':');) {
+            Archive::Reader reader;
+            archive_read_support_format_all(reader);
+            archive_read_support_filter_all(reader);
+
+            if (!reader.open_filename(path).has_value()) {
+                continue;
+            }
+
+            for (auto& [header, entry] : reader) {
+                std::string_view const pathname = archive_entry_pathname(*header);
+                if (!pathname.ends_with("/desc")) {
+                    continue;
+                }
+                if (auto contents = entry.read_all(); contents.has_value()) {
+                    descs.emplace_back(contents->begin(), contents->end());
+                }
+            }
+        }
+    }
+
+    if (descs.empty()) {
+        constexpr std::size_t CoreAndExtraSize = 15000;
+        for (std::size_t i = 0; i < CoreAndExtraSize; ++i) {
+            descs.emplace_back(make_desc(i));
+        }
+    }
+
+    return descs;
+}
+
+} // namespace
+
+TEST_CASE("Desc", "[utilities][alpmdb]") {
+    Desc const desc(make_desc(42));
+
+    SECTION("Single value fields") {
+        REQUIRE(desc.get("NAME") == "package42");
+        REQUIRE(desc.get("VERSION") == "1.0-1");
+        REQUIRE(desc.get("FILENAME") == "package42-1.0-1-x86_64.pkg.tar.zst");
+    }
+
+    SECTION("Multi value fields") {
+        auto const depends = desc.values("DEPENDS") | std::ranges::to<std::vector<std::string>>();
+
+        REQUIRE(depends == std::vector<std::string> {"glibc", "bash", "zstd", "libarchive"});
+        REQUIRE(desc.get("DEPENDS") == "glibc");
+    }
+
+    SECTION("Missing fields") {
+        REQUIRE_FALSE(desc.get("OPTDEPENDS").has_value());
+        REQUIRE(std::ranges::empty(desc.values("OPTDEPENDS")));
+    }
+
+    SECTION("Empty and trailing fields") {
+        Desc const partial("%EMPTY%\n\n%LAST%\nvalue");
+
+        REQUIRE(partial.get("EMPTY") == "");
+        REQUIRE(partial.get("LAST") == "value");
+    }
+
+    SECTION("Copies keep the index") {
+        Desc const copy = desc;
+
+        REQUIRE(copy.get("NAME") == "package42");
+    }
+}
+
+TEST_CASE("Desc::parse_package", "[utilities][alpmdb]") {
+    std::filesystem::path const path = "data/dummy-1-1-any.pkg.tar.zst";
+
+    // Computed from the whole file independently of the parser
+    std::ifstream stream(path, std::ios::binary);
+    std::string const contents {std::istreambuf_iterator<char>(stream),
+                                std::istreambuf_iterator<char>()};
+    REQUIRE_FALSE(contents.empty());
+
+    auto md5 = bxt::Utilities::Digest::md5();
+    md5.update(contents.data(), contents.size());
+    auto sha256 = bxt::Utilities::Digest::sha256();
+    sha256.update(contents.data(), contents.size());
+
+    auto const md5sum = md5.hex_digest();
+    auto const sha256sum = sha256.hex_digest();
+    auto const csize = std::to_string(contents.size());
+
+    // Without the file list the parser stops after .PKGINFO, the rest of the
+    // file is only drained for the checksums
+    for (bool const create_files : {false, true}) {
+        auto const desc = Desc::parse_package(path, "", create_files);
+        REQUIRE(desc.has_value());
+
+        REQUIRE(desc->get("MD5SUM") == md5sum);
+        REQUIRE(desc->get("SHA256SUM") == sha256sum);
+        REQUIRE(desc->get("CSIZE") == csize);
+        REQUIRE(desc->has_files() == create_files);
+    }
+}
+
+TEST_CASE("Desc database parsing", "[.][benchmark][utilities][alpmdb]") {
+    auto const descs = load_benchmark_descs();
+
+    BENCHMARK("Index and look up sync fields") {
+        std::size_t found = 0;
+        for (auto const& contents : descs) {
+            Desc const desc(contents);
+
+            for (auto const key : {"FILENAME", "NAME", "VERSION", "SHA256SUM", "PGPSIG"}) {
+                found += desc.get(key).has_value();
+            }
+        }
+        return found;
+    };
+}
@@ -0,0 +1,65 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "utilities/alpmdb/PkgInfo.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <ranges>
+#include <string>
+#include <vector>
+
+using namespace bxt::Utilities::AlpmDb;
+
+namespace {
+
+template<typename TValues> std::vector<std::string> to_strings(TValues&& values) {
+    return values | std::views::transform([](auto const value) { return std::string(value); })
+           | std::ranges::to<std::vector>();
+}
+
+} // namespace
+
+TEST_CASE("PkgInfo", "[utilities][alpmdb]") {
+    PkgInfo pkg_info;
+    pkg_info.parse("# Generated by makepkg 7.0.0\n"
+                   "pkgname = package\n"
+                   "url = \n"
+                   "license = GPL-2.0-or-later\n"
+                   "depend = glibc\n"
+                   "not a key value line\n"
+                   "license = MIT\n"
+                   "custom = first\n"
+                   "depend = bash\n"
+                   "custom = second\n");
+
+    SECTION("Repeated keys keep their values in order") {
+        REQUIRE(to_strings(pkg_info.values<pkginfo_key_index("depend")>())
+                == std::vector<std::string> {"glibc", "bash"});
+        REQUIRE(to_strings(pkg_info.values("license"))
+                == std::vector<std::string> {"GPL-2.0-or-later", "MIT"});
+    }
+
+    SECTION("Unknown keys are found by name") {
+        REQUIRE(pkginfo_key_index("custom") == UnknownPkgInfoKey);
+        REQUIRE(to_strings(pkg_info.values("custom"))
+                == std::vector<std::string> {"first", "second"});
+    }
+
+    SECTION("Empty values are kept, missing keys have none") {
+        REQUIRE(to_strings(pkg_info.values<pkginfo_key_index("url")>())
+                == std::vector<std::string> {""});
+        REQUIRE(std::ranges::empty(pkg_info.values<pkginfo_key_index("conflict")>()));
+        REQUIRE(std::ranges::empty(pkg_info.values("missing")));
+    }
+
+    SECTION("Parsing again replaces the previous contents") {
+        pkg_info.parse("pkgname = other\n");
+
+        REQUIRE(to_strings(pkg_info.values<pkginfo_key_index("pkgname")>())
+                == std::vector<std::string> {"other"});
+        REQUIRE(std::ranges::empty(pkg_info.values("custom")));
+    }
+}
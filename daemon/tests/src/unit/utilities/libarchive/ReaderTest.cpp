@@ -0,0 +1,265 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "utilities/alpmdb/Database.h"
+#include "utilities/libarchive/PushSource.h"
+#include "utilities/libarchive/Reader.h"
+#include "utilities/libarchive/Writer.h"
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+#include <cerrno>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+std::string make_desc(std::size_t index) {
+    return fmt::format("%FILENAME%\npackage{0}-1.0-1-x86_64.pkg.tar.zst\n\n"
+                       "%NAME%\npackage{0}\n\n"
+                       "%VERSION%\n1.0-1\n\n"
+                       "%DESC%\nSynthetic package number {0}\n\n"
+                       "%DEPENDS%\nglibc\nbash\n\n",
+                       index);
+}
+
+// Database in the repo-add layout ("name-version/desc"), zstd compressed
+// unless it is a plain tar
+struct TemporaryDatabase {
+    explicit TemporaryDatabase(std::size_t package_count, bool compressed = true)
+        : path(std::filesystem::temp_directory_path()
+               / fmt::format("bxt-reader-test-{}.db.tar{}", ::getpid(),
+                             compressed ? ".zst" : "")) {
+        Archive::Writer writer;
+        if (compressed) {
+            archive_write_add_filter_zstd(writer);
+            archive_write_set_format_pax_restricted(writer);
+        } else {
+            // A header and a data block per entry, without extended headers
+            archive_write_set_format_ustar(writer);
+        }
+        REQUIRE(writer.open_filename(path).has_value());
+
+        for (std::size_t i = 0; i < package_count; ++i) {
+            REQUIRE(bxt::Utilities::AlpmDb::DatabaseUtils::write_buffer_to_archive(
+                        writer, fmt::format("package{}-1.0-1/desc", i), make_desc(i))
+                        .has_value());
+        }
+    }
+
+    ~TemporaryDatabase() {
+        std::filesystem::remove(path);
+    }
+
+    std::filesystem::path path;
+};
+
+std::size_t read_descs(Archive::Reader& reader) {
+    std::size_t total_size = 0;
+    for (auto& [header, entry] : reader) {
+        auto contents = entry.read_all();
+        REQUIRE(contents.has_value());
+        total_size += contents->size();
+    }
+    return total_size;
+}
+
+} // namespace
+
+TEST_CASE("Archive::Reader", "[utilities][libarchive]") {
+    constexpr std::size_t PackageCount = 100;
+    TemporaryDatabase const database(PackageCount);
+
+    std::size_t expected_size = 0;
+    for (std::size_t i = 0; i < PackageCount; ++i) {
+        expected_size += make_desc(i).size();
+    }
+
+    SECTION("Reads entries from a file") {
+        Archive::Reader reader;
+        archive_read_support_filter_all(reader);
+        archive_read_support_format_all(reader);
+        REQUIRE(reader.open_filename(database.path).has_value());
+
+        REQUIRE(read_descs(reader) == expected_size);
+        REQUIRE(reader.finished().has_value());
+    }
+
+    SECTION("Reads entries from a mapped file") {
+        Archive::Reader reader;
+        archive_read_support_filter_all(reader);
+        archive_read_support_format_all(reader);
+        REQUIRE(reader.open_mapped(database.path).has_value());
+
+        REQUIRE(read_descs(reader) == expected_size);
+    }
+
+    SECTION("Reads entries pushed from another thread") {
+        // A small capacity keeps the producer blocked most of the time, like
+        // a download that is ahead of the parser
+        Archive::PushSource source(4096);
+        std::jthread producer([&source, &database] {
+            std::ifstream stream(database.path, std::ios::binary);
+            std::vector<char> block(1000);
+            while (stream.read(block.data(), static_cast<std::streamsize>(block.size()))
+                   || stream.gcount() > 0) {
+                if (!source.write(reinterpret_cast<uint8_t const*>(block.data()),
+                                  static_cast<std::size_t>(stream.gcount()))) {
+                    return;
+                }
+            }
+            source.finish();
+        });
+
+        REQUIRE(source.wait());
+
+        Archive::Reader reader;
+        archive_read_support_filter_all(reader);
+        archive_read_support_format_all(reader);
+        REQUIRE(reader.open_source([&source] { return source.read(); }).has_value());
+
+        REQUIRE(read_descs(reader) == expected_size);
+    }
+
+    SECTION("A failed push source fails the reader") {
+        Archive::PushSource source;
+        std::jthread producer([&source, &database] {
+            std::ifstream stream(database.path, std::ios::binary);
+            std::vector<char> block(512);
+            stream.read(block.data(), static_cast<std::streamsize>(block.size()));
+            source.write(reinterpret_cast<uint8_t const*>(block.data()),
+                         static_cast<std::size_t>(stream.gcount()));
+            source.finish(false);
+        });
+
+        Archive::Reader reader;
+        archive_read_support_filter_all(reader);
+        archive_read_support_format_all(reader);
+
+        // Depending on how much format detection needs, either opening or
+        // reading runs into the failure
+        bool failed = !reader.open_source([&source] { return source.read(); }).has_value();
+        for (auto it = reader.begin(); !failed && it != reader.end(); ++it) {
+            auto& [header, entry] = *it;
+            failed = !entry.read_all().has_value();
+        }
+        REQUIRE((failed || archive_errno(reader) == EIO));
+    }
+
+    SECTION("Closing a push source releases the producer") {
+        Archive::PushSource source(16);
+        uint8_t const data[16] {};
+        REQUIRE(source.write(data, sizeof(data)));
+
+        bool written = true;
+        std::jthread producer([&source, &data, &written] { written = source.write(data, 1); });
+        source.close();
+        producer.join();
+
+        REQUIRE_FALSE(written);
+    }
+
+    SECTION("Reads the entry contents") {
+        Archive::Reader reader;
+        archive_read_support_filter_all(reader);
+        archive_read_support_format_all(reader);
+        REQUIRE(reader.open_mapped(database.path).has_value());
+
+        auto it = reader.begin();
+        auto& [header, entry] = *it;
+        auto const contents = entry.read_all();
+        REQUIRE(contents.has_value());
+        REQUIRE(std::string(contents->begin(), contents->end()) == make_desc(0));
+    }
+
+    SECTION("A truncated archive stops the iteration with an error") {
+        TemporaryDatabase const plain(PackageCount, false);
+        std::filesystem::resize_file(plain.path, 3 * 1024 + 256);
+
+        Archive::Reader reader;
+        archive_read_support_filter_all(reader);
+        archive_read_support_format_all(reader);
+        REQUIRE(reader.open_filename(plain.path).has_value());
+
+        std::size_t entries = 0;
+        for (auto& [header, entry] : reader) {
+            REQUIRE(entry.read_all().has_value());
+            ++entries;
+        }
+        REQUIRE(entries == 3);
+        REQUIRE_FALSE(reader.finished().has_value());
+    }
+
+    SECTION("An observer sees every byte of the file once drained") {
+        TemporaryDatabase const plain(PackageCount, false);
+
+        std::string observed;
+        Archive::Reader reader;
+        archive_read_support_filter_all(reader);
+        archive_read_support_format_all(reader);
+        REQUIRE(reader
+                    .open_filename(plain.path,
+                                   [&observed](uint8_t const* data, std::size_t size) {
+                                       observed.append(reinterpret_cast<char const*>(data), size);
+                                   },
+                                   1024)
+                    .has_value());
+
+        // Only the first entry is needed, like .PKGINFO of a package
+        auto it = reader.begin();
+        auto& [header, entry] = *it;
+        REQUIRE(entry.read_all().has_value());
+
+        auto const file_size = std::filesystem::file_size(plain.path);
+        REQUIRE(observed.size() < file_size);
+
+        REQUIRE(reader.drain().has_value());
+
+        std::ifstream stream(plain.path, std::ios::binary);
+        std::string const contents {std::istreambuf_iterator<char>(stream),
+                                    std::istreambuf_iterator<char>()};
+        REQUIRE(observed == contents);
+    }
+
+    SECTION("Fails on missing files") {
+        Archive::Reader reader;
+        REQUIRE_FALSE(reader.open_mapped(database.path.string() + ".missing").has_value());
+    }
+}
+
+TEST_CASE("Archive::Reader database throughput", "[.][benchmark][utilities][libarchive]") {
+    // About the size of core and extra together
+    TemporaryDatabase const database(15000);
+
+    auto const open_reader = [&](auto open) {
+        auto reader = std::make_unique<Archive::Reader>();
+        archive_read_support_filter_all(*reader);
+        archive_read_support_format_all(*reader);
+        REQUIRE(open(*reader).has_value());
+        return reader;
+    };
+
+    BENCHMARK("open_filename, 1 KiB blocks") {
+        auto reader = open_reader([&](auto& r) { return r.open_filename(database.path, 1024); });
+        return read_descs(*reader);
+    };
+
+    BENCHMARK("open_filename, default blocks") {
+        auto reader = open_reader([&](auto& r) { return r.open_filename(database.path); });
+        return read_descs(*reader);
+    };
+
+    BENCHMARK("open_mapped") {
+        auto reader = open_reader([&](auto& r) { return r.open_mapped(database.path); });
+        return read_descs(*reader);
+    };
+}
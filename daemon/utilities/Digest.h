@@ -0,0 +1,58 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+
+#pragma once
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <openssl/evp.h>
+#include <string>
+
+namespace bxt::Utilities {
+
+// Incremental message digest, so data can be hashed while it is read for
+// another purpose instead of reading it again.
+class Digest {
+public:
+    explicit Digest(EVP_MD const* algorithm)
+        : m_context(EVP_MD_CTX_new(), EVP_MD_CTX_free) {
+        EVP_DigestInit_ex(m_context.get(), algorithm, nullptr);
+    }
+
+    static Digest md5() {
+        return Digest(EVP_md5());
+    }
+
+    static Digest sha256() {
+        return Digest(EVP_sha256());
+    }
+
+    void update(void const* data, std::size_t size) {
+        EVP_DigestUpdate(m_context.get(), data, size);
+    }
+
+    // Finalizes the digest and returns it as a lowercase hex string
+    std::string hex_digest() {
+        std::array<unsigned char, EVP_MAX_MD_SIZE> digest;
+        unsigned int digest_size = 0;
+        EVP_DigestFinal_ex(m_context.get(), digest.data(), &digest_size);
+
+        constexpr char hex_digits[] = "0123456789abcdef";
+
+        std::string result(digest_size * 2, '\0');
+        for (unsigned int i = 0; i < digest_size; ++i) {
+            result[i * 2] = hex_digits[digest[i] >> 4];
+            result[i * 2 + 1] = hex_digits[digest[i] & 0x0f];
+        }
+        return result;
+    }
+
+private:
+    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> m_context;
+};
+
+} // namespace bxt::Utilities
@@ -14,15 +14,16 @@
 #include "utilities/log/Logging.h"
 
 #include <algorithm>
+#include <atomic>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/regex.hpp>
 #include <boost/algorithm/string/split.hpp>
-#include <coro/latch.hpp>
-#include <execution>
+#include <coro/when_all.hpp>
 #include <expected>
 #include <filesystem>
 #include <fmt/format.h>
 #include <iterator>
+#include <mutex>
 #include <utilities/libarchive/Reader.h>
 #include <utilities/libarchive/Writer.h>
 
@@ -31,28 +32,19 @@ namespace bxt::Utilities::AlpmDb::DatabaseUtils {
 constexpr static frozen::set<frozen::string, 3> supported_package_extensions = {
     "pkg.tar.gz", "pkg.tar.xz", "pkg.tar.zst"};
 
-coro::task<Result<phmap::parallel_flat_hash_map<std::string, Desc>>>
-    parse_packages(std::set<std::string> const packages) {
-    phmap::parallel_flat_hash_map<std::string, Desc> descriptions;
-
-    coro::latch latch {static_cast<ptrdiff_t>(packages.size())};
+coro::task<ParsedPackages> parse_packages(coro::thread_pool& pool,
+                                          std::set<std::string> const packages,
+                                          std::size_t max_concurrency) {
+    ParsedPackages result;
 
-    accept(packages, [&descriptions, &latch](std::string const& name, Desc const& description) {
-        descriptions.lazy_emplace_l(
-            name,
-            [description, &latch, name](auto& value) {
-                value.second = description;
-                latch.count_down();
-            },
-            [description, &latch, name](auto const& ctor) {
-                ctor(name, description);
-                latch.count_down();
-            });
-    });
+    result.errors = co_await accept(
+        pool, packages,
+        [&result](std::string const& name, Desc const& description) {
+            result.descriptions.insert_or_assign(name, description);
+        },
+        max_concurrency);
 
-    co_await latch;
-
-    co_return descriptions;
+    co_return result;
 }
 
 void create_symlinks(std::filesystem::path path) {
@@ -146,24 +138,75 @@ coro::task<Result<phmap::parallel_flat_hash_map<std::string, Desc>>>
     co_return {};
 }
 
-coro::task<Result<void>>
-    accept(std::set<std::string> files,
-           std::function<void(std::string const& name, Desc const& description)> visitor) {
-    for (auto const& package : files) {
-        auto description = Desc::parse_package(package);
-        if (!description.has_value()) {
-            co_return bxt::make_error<DatabaseError>(DatabaseError::ErrorType::InvalidEntityError);
-        }
-        auto const name = description->get("NAME");
+namespace {
+    struct ParseQueue {
+        std::vector<std::string> files;
+        std::atomic<std::size_t> next = 0;
 
-        auto const version = description->get("VERSION");
+        std::mutex mutex;
+        std::function<void(std::string const& name, Desc const& description)> visitor;
+        std::vector<PackageParseError> errors;
+    };
 
-        if (!name.has_value() || !version.has_value()) {
-            continue;
+    // Takes files from the queue until it's empty, so the number of workers
+    // bounds how many packages are parsed at once.
+    coro::task<void> parse_worker(coro::thread_pool& pool, ParseQueue& queue) {
+        co_await pool.schedule();
+
+        for (auto index = queue.next++; index < queue.files.size(); index = queue.next++) {
+            auto const& filepath = queue.files[index];
+
+            auto description = Desc::parse_package(filepath);
+
+            std::lock_guard const lock(queue.mutex);
+
+            if (!description.has_value()) {
+                queue.errors.emplace_back(filepath, std::move(description.error()));
+                continue;
+            }
+
+            auto const name = description->get("NAME");
+            auto const version = description->get("VERSION");
+
+            if (!name.has_value() || !version.has_value()) {
+                queue.errors.emplace_back(
+                    filepath, Desc::ParseError(Desc::ParseError::ErrorType::NoPackageInfo));
+                continue;
+            }
+
+            queue.visitor(fmt::format("{}-{}", *name, *version), *description);
         }
+    }
+} // namespace
+
+coro::task<std::vector<PackageParseError>>
+    accept(coro::thread_pool& pool,
+           std::set<std::string> files,
+           std::function<void(std::string const& name, Desc const& description)> visitor,
+           std::size_t max_concurrency) {
+    ParseQueue queue {.files = {std::make_move_iterator(files.begin()),
+                                std::make_move_iterator(files.end())},
+                      .visitor = std::move(visitor)};
+
+    if (queue.files.empty()) {
+        co_return {};
+    }
 
-        visitor(fmt::format("{}-{}", *name, *version), *description);
+    auto const worker_count = std::clamp<std::size_t>(max_concurrency, 1, queue.files.size());
+
+    std::vector<coro::task<void>> workers;
+    workers.reserve(worker_count);
+    for (std::size_t i = 0; i < worker_count; ++i) {
+        workers.emplace_back(parse_worker(pool, queue));
     }
+
+    co_await coro::when_all(std::move(workers));
+
+    if (!queue.errors.empty()) {
+        logw("{} of {} packages failed to parse", queue.errors.size(), queue.files.size());
+    }
+
+    co_return std::move(queue.errors);
 }
 
 } // namespace bxt::Utilities::AlpmDb::DatabaseUtils
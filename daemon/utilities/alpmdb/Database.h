@@ -10,6 +10,7 @@
 #include "utilities/errors/DatabaseError.h"
 #include "utilities/libarchive/Writer.h"
 
+#include <algorithm>
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/log/trivial.hpp>
@@ -18,6 +19,7 @@
 #include <coro/mutex.hpp>
 #include <coro/sync_wait.hpp>
 #include <coro/task.hpp>
+#include <coro/thread_pool.hpp>
 #include <expected>
 #include <filesystem>
 #include <fmt/format.h>
@@ -30,21 +32,44 @@
 #include <set>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace bxt::Utilities::AlpmDb::DatabaseUtils {
 
 BXT_DECLARE_RESULT(DatabaseError)
 
-coro::task<Result<phmap::parallel_flat_hash_map<std::string, Desc>>>
-    parse_packages(std::set<std::string> files);
+// Upper bound of packages being parsed at once, regardless of the pool size
+inline std::size_t const DefaultParseConcurrency =
+    std::max(1u, std::thread::hardware_concurrency());
+
+struct PackageParseError {
+    std::string filepath;
+    Desc::ParseError error;
+};
+
+struct ParsedPackages {
+    phmap::parallel_flat_hash_map<std::string, Desc> descriptions;
+    std::vector<PackageParseError> errors;
+};
+
+// Parses package files on the thread pool. Files that fail to parse are
+// reported in errors and don't affect the rest of the batch.
+coro::task<ParsedPackages> parse_packages(coro::thread_pool& pool,
+                                          std::set<std::string> files,
+                                          std::size_t max_concurrency = DefaultParseConcurrency);
 
 coro::task<Result<phmap::parallel_flat_hash_map<std::string, Desc>>>
     load(std::filesystem::path path);
 
-coro::task<Result<void>>
-    accept(std::set<std::string> files,
-           std::function<void(std::string const& name, Desc const& description)> visitor);
+// Calls the visitor with "name-version" and the description of every parsed
+// package. The visitor calls are serialized, but happen on the pool threads.
+coro::task<std::vector<PackageParseError>>
+    accept(coro::thread_pool& pool,
+           std::set<std::string> files,
+           std::function<void(std::string const& name, Desc const& description)> visitor,
+           std::size_t max_concurrency = DefaultParseConcurrency);
 
 template<typename TBuffer>
 Result<void> write_buffer_to_archive(Archive::Writer& writer,
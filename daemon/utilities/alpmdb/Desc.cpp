@@ -8,11 +8,11 @@
 
 #include "utilities/alpmdb/DescFormatter.h"
 #include "utilities/alpmdb/PkgInfo.h"
+#include "utilities/Digest.h"
 #include "utilities/libarchive/Error.h"
 #include "utilities/libarchive/Reader.h"
 
 #include <boost/algorithm/string/join.hpp>
-#include <boost/iostreams/device/mapped_file.hpp>
 #include <expected>
 #include <fmt/format.h>
 #include <frozen/set.h>
@@ -21,28 +21,135 @@
 #include <optional>
 
 namespace bxt::Utilities::AlpmDb {
-std::optional<std::string> Desc::get(std::string const& key) const {
-    auto prepared_key = fmt::format("%{}%\n", key);
-    auto value_begin = desc.find(prepared_key);
+namespace {
+    bool is_metadata_entry(std::string_view pathname) {
+        return pathname.ends_with(".PKGINFO") || pathname.starts_with("/.");
+    }
+} // namespace
 
-    if (value_begin == std::string::npos) {
-        return {};
+void Desc::reindex() {
+    m_fields.clear();
+
+    std::string_view const text = desc;
+
+    auto const line_at = [&text](std::size_t offset) {
+        auto end = text.find('\n', offset);
+        return text.substr(offset, end == std::string_view::npos ? end : end - offset);
+    };
+
+    std::size_t offset = 0;
+    while (offset < text.size()) {
+        auto const header = line_at(offset);
+        offset += header.size() + 1;
+
+        if (header.size() < 2 || !header.starts_with('%') || !header.ends_with('%')) {
+            continue;
+        }
+
+        // Values continue up to the next empty line
+        auto const value_offset = std::min(offset, text.size());
+        auto value_end = value_offset;
+        while (offset < text.size()) {
+            auto const line = line_at(offset);
+            offset += line.size() + 1;
+
+            if (line.empty()) {
+                break;
+            }
+            value_end = std::min(offset - 1, text.size());
+        }
+
+        m_fields.emplace_back(Field {
+            .key_offset = static_cast<uint32_t>(header.data() - text.data() + 1),
+            .key_size = static_cast<uint32_t>(header.size() - 2),
+            .value_offset = static_cast<uint32_t>(value_offset),
+            .value_size = static_cast<uint32_t>(value_end - value_offset)});
+    }
+}
+
+std::optional<std::string_view> Desc::field(std::string_view key) const {
+    std::string_view const text = desc;
+
+    for (auto const& field : m_fields) {
+        if (text.substr(field.key_offset, field.key_size) == key) {
+            return text.substr(field.value_offset, field.value_size);
+        }
     }
 
-    value_begin += prepared_key.size();
-    auto value_end = desc.find("\n", value_begin);
+    return {};
+}
 
-    if (value_end == std::string::npos) {
+std::optional<std::string_view> Desc::get(std::string_view key) const {
+    auto const value = field(key);
+
+    if (!value.has_value()) {
         return {};
     }
 
-    return desc.substr(value_begin, value_end - value_begin);
+    return value->substr(0, value->find('\n'));
 }
 
+namespace {
+    // Reads entries up to .PKGINFO, or all of them if the file list is needed
+    Desc::Result<PkgInfo> read_package_info(Archive::Reader& reader, std::ostringstream* files) {
+        using ParseError = Desc::ParseError;
+
+        PkgInfo package_info;
+
+        if (files) {
+            *files << Desc::FilesHeader;
+        }
+
+        bool found = false;
+        for (auto& [header, entry] : reader) {
+            if (!header) {
+                continue;
+            }
+            std::string pathname = archive_entry_pathname(*header);
+
+            if (!is_metadata_entry(pathname)) {
+                if (files) {
+                    *files << pathname << "\n";
+                }
+                continue;
+            }
+            found = true;
+
+            auto contents = entry.read_all();
+
+            if (!contents.has_value()) {
+                if (auto const invalidentry =
+                        std::get_if<Archive::InvalidEntryError>(&contents.error())) {
+                    return std::unexpected(ParseError(ParseError::ErrorType::InvalidArchive,
+                                                      std::move(*invalidentry)));
+                } else {
+                    return std::unexpected(ParseError(
+                        ParseError::ErrorType::InvalidArchive,
+                        std::move(*std::get_if<Archive::LibArchiveError>(&contents.error()))));
+                }
+            }
+
+            package_info.parse(
+                std::string_view {reinterpret_cast<char*>(contents->data()), contents->size()});
+
+            // .PKGINFO is the first entry of a package, without the file list
+            // nothing else has to be decompressed
+            if (!files) {
+                break;
+            }
+        }
+
+        if (!found) {
+            return std::unexpected(ParseError(ParseError::ErrorType::NoPackageInfo));
+        }
+
+        return package_info;
+    }
+} // namespace
+
 Desc::Result<Desc> Desc::parse_package(std::filesystem::path const& filepath,
                                        std::string const& signature,
                                        bool create_files) {
-    std::ostringstream desc;
     std::ostringstream files;
 
     Archive::Reader file_reader;
@@ -50,61 +157,98 @@ Desc::Result<Desc> Desc::parse_package(std::filesystem::path const& filepath,
     archive_read_support_filter_all(file_reader);
     archive_read_support_format_all(file_reader);
 
-    auto const package_infos = file_reader.open_filename(filepath);
+    // The package is read only once: checksums and size for the description
+    // are computed from the same blocks libarchive decompresses.
+    auto md5 = Digest::md5();
+    auto sha256 = Digest::sha256();
+    std::uintmax_t size = 0;
+
+    auto const package_infos =
+        file_reader.open_filename(filepath, [&](uint8_t const* data, std::size_t length) {
+            md5.update(data, length);
+            sha256.update(data, length);
+            size += length;
+        });
 
     if (!package_infos.has_value()) {
         return std::unexpected(
             ParseError(ParseError::ErrorType::InvalidArchive, std::move(package_infos.error())));
     }
 
-    PkgInfo package_info;
+    auto package_info = read_package_info(file_reader, create_files ? &files : nullptr);
 
-    bool found = false;
-    for (auto& [header, entry] : file_reader) {
-        if (!header) {
-            continue;
-        }
-        std::string pathname = archive_entry_pathname(*header);
+    if (!package_info.has_value()) {
+        return std::unexpected(std::move(package_info.error()));
+    }
 
-        if (!pathname.ends_with(".PKGINFO") && !pathname.starts_with("/.")) {
-            if (create_files) {
-                files << archive_entry_pathname(*header) << "\n";
-            }
-            continue;
-        }
-        found = true;
-
-        auto contents = entry.read_all();
-
-        if (!contents.has_value()) {
-            if (auto const invalidentry =
-                    std::get_if<Archive::InvalidEntryError>(&contents.error())) {
-                return std::unexpected(
-                    ParseError(ParseError::ErrorType::InvalidArchive, std::move(*invalidentry)));
-            } else {
-                return std::unexpected(ParseError(
-                    ParseError::ErrorType::InvalidArchive,
-                    std::move(*std::get_if<Archive::LibArchiveError>(&contents.error()))));
-            }
-        }
+    if (auto const drained = file_reader.drain(); !drained.has_value()) {
+        return std::unexpected(
+            ParseError(ParseError::ErrorType::InvalidArchive, std::move(drained.error())));
+    }
 
-        package_info.parse(
-            std::string_view {reinterpret_cast<char*>(contents->data()), contents->size()});
+    DescFormatter formatter {
+        std::move(*package_info), filepath, signature,
+        DescFormatter::Checksums {
+            .size = size, .md5 = md5.hex_digest(), .sha256 = sha256.hex_digest()}};
 
-        if (!create_files) {
-            break;
-        }
+    return Desc {formatter.format(), files.str()};
+}
+
+Desc::Result<Desc> Desc::parse_package(std::span<uint8_t const> contents,
+                                       std::filesystem::path const& filepath,
+                                       DescFormatter::Checksums checksums,
+                                       std::string const& signature,
+                                       bool create_files) {
+    std::ostringstream files;
+
+    Archive::Reader file_reader;
+
+    archive_read_support_filter_all(file_reader);
+    archive_read_support_format_all(file_reader);
+
+    if (auto const opened = file_reader.open_memory(contents.data(), contents.size());
+        !opened.has_value()) {
+        return std::unexpected(
+            ParseError(ParseError::ErrorType::InvalidArchive, std::move(opened.error())));
     }
 
-    if (!found) {
-        return std::unexpected(ParseError(ParseError::ErrorType::NoPackageInfo));
+    auto package_info = read_package_info(file_reader, create_files ? &files : nullptr);
+
+    if (!package_info.has_value()) {
+        return std::unexpected(std::move(package_info.error()));
+    }
+
+    DescFormatter formatter {std::move(*package_info), filepath, signature, std::move(checksums)};
+
+    return Desc {formatter.format(), files.str()};
+}
+
+Desc::Result<std::string> Desc::extract_files(std::filesystem::path const& filepath) {
+    std::ostringstream files;
+
+    Archive::Reader file_reader;
+
+    archive_read_support_filter_all(file_reader);
+    archive_read_support_format_all(file_reader);
+
+    if (auto const opened = file_reader.open_filename(filepath); !opened.has_value()) {
+        return std::unexpected(
+            ParseError(ParseError::ErrorType::InvalidArchive, std::move(opened.error())));
     }
 
-    DescFormatter formatter {package_info, filepath, signature};
+    files << FilesHeader;
+    for (auto& [header, entry] : file_reader) {
+        if (!header) {
+            continue;
+        }
+        std::string_view const pathname = archive_entry_pathname(*header);
 
-    desc << formatter.format();
+        if (!is_metadata_entry(pathname)) {
+            files << pathname << "\n";
+        }
+    }
 
-    return Desc {.desc = desc.str(), .files = files.str()};
+    return files.str();
 }
 
 } // namespace bxt::Utilities::AlpmDb
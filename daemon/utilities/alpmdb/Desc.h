@@ -7,6 +7,7 @@
 #pragma once
 
 #include "frozen/unordered_map.h"
+#include "utilities/alpmdb/DescFormatter.h"
 #include "utilities/alpmdb/PkgInfo.h"
 #include "utilities/Error.h"
 #include "utilities/errors/Macro.h"
@@ -14,11 +15,15 @@
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <cereal/access.hpp>
+#include <cstdint>
 #include <expected>
 #include <filesystem>
 #include <memory>
 #include <optional>
+#include <ranges>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace bxt::Utilities::AlpmDb {
@@ -32,6 +37,7 @@ struct Desc {
 
         ParseError(ErrorType type)
             : error_type(type) {
+            message = error_messages.at(error_type).data();
         }
         explicit ParseError(ErrorType type, bxt::Error const&& source)
             : bxt::Error(std::make_unique<bxt::Error>(std::move(source)))
@@ -50,17 +56,82 @@ struct Desc {
     };
     BXT_DECLARE_RESULT(ParseError)
 
-    template<class Archive> void serialize(Archive& ar) {
+    // Starts every extracted file list, even the one of a package without
+    // files
+    static constexpr std::string_view FilesHeader = "%FILES%\n";
+
+    Desc() = default;
+    explicit Desc(std::string desc, std::string files = {})
+        : desc(std::move(desc))
+        , files(std::move(files)) {
+        reindex();
+    }
+
+    template<class Archive> void save(Archive& ar) const {
         ar(desc, files);
     }
 
+    template<class Archive> void load(Archive& ar) {
+        ar(desc, files);
+        reindex();
+    }
+
     static Result<Desc> parse_package(std::filesystem::path const& filepath,
                                       std::string const& signature = "",
                                       bool create_files = true);
 
-    std::optional<std::string> get(std::string const& key) const;
+    // Parses a package that is already in memory, e.g. an upload. The caller
+    // computes the checksums while it has the data at hand.
+    static Result<Desc> parse_package(std::span<uint8_t const> contents,
+                                      std::filesystem::path const& filepath,
+                                      DescFormatter::Checksums checksums,
+                                      std::string const& signature = "",
+                                      bool create_files = true);
+
+    // Lists the package contents in the "files" format, header included.
+    // Unlike parse_package this decompresses the whole archive.
+    static Result<std::string> extract_files(std::filesystem::path const& filepath);
+
+    // First value of the field, the views point into desc.
+    std::optional<std::string_view> get(std::string_view key) const;
+
+    // All values of a multi-value field (e.g. DEPENDS), empty if the field
+    // is missing.
+    auto values(std::string_view key) const {
+        return std::views::split(field(key).value_or(std::string_view {}), '\n')
+               | std::views::transform([](auto const& value) {
+                     return std::string_view(value.begin(), value.end());
+                 });
+    }
+
+    bool operator==(Desc const& other) const {
+        return desc == other.desc && files == other.files;
+    }
+
+    // Whether the file list is known. Lists of older records lack the header
+    // and have to be extracted again.
+    bool has_files() const {
+        return files.starts_with(FilesHeader);
+    }
+
+    // Rebuilds the field index, needed only if desc was modified in place.
+    void reindex();
 
     std::string desc;
+    // Contents of the "files" entry, see has_files()
     std::string files;
+
+private:
+    // Offsets of a "%KEY%" header and its value lines inside desc
+    struct Field {
+        uint32_t key_offset;
+        uint32_t key_size;
+        uint32_t value_offset;
+        uint32_t value_size;
+    };
+
+    std::optional<std::string_view> field(std::string_view key) const;
+
+    std::vector<Field> m_fields;
 };
 } // namespace bxt::Utilities::AlpmDb
@@ -8,9 +8,8 @@
 #include "DescFormatter.h"
 
 #include "utilities/base64.h"
-#include "utilities/hash_from_file.h"
 
-#include <sstream>
+#include <string>
 
 namespace bxt::Utilities::AlpmDb {
 
@@ -18,39 +17,47 @@ namespace bxt::Utilities::AlpmDb {
 // It follows the format used by repo-add.sh in pacman for compatibility:
 // https://gitlab.archlinux.org/pacman/pacman/-/blob/6ba5c20e7629ae9bdd7ceaf5a45484c434363ec5/scripts/repo-add.sh.in#L296-326
 std::string DescFormatter::format() const {
-    std::ostringstream oss;
-    oss << format_entry<"FILENAME">(m_filepath.filename().string());
-    oss << format_pkginfo_entry<"NAME", "pkgname">();
-    oss << format_pkginfo_entry<"BASE", "pkgbase">();
-    oss << format_pkginfo_entry<"VERSION", "pkgver">();
-    oss << format_pkginfo_entry<"DESC", "pkgdesc">();
-    oss << format_pkginfo_entry<"GROUPS", "groups">();
-    oss << format_entry<"CSIZE">(std::to_string(std::filesystem::file_size(m_filepath)));
-    oss << format_pkginfo_entry<"ISIZE", "size">();
+    // Field names and the computed entries take well under 1 KiB, values can't
+    // exceed the size of the .PKGINFO they come from.
+    constexpr std::size_t FormattingOverhead = 1024;
+
+    auto const filename = m_filepath.filename().string();
+    auto const encoded_signature =
+        m_signature.empty() ? std::string() : bxt::Utilities::b64_encode(m_signature);
+
+    std::string output;
+    output.reserve(m_pkg_info.size() + filename.size() + encoded_signature.size()
+                   + FormattingOverhead);
+
+    format_entry<"FILENAME">(filename, output);
+    format_pkginfo_entry<"NAME", "pkgname">(output);
+    format_pkginfo_entry<"BASE", "pkgbase">(output);
+    format_pkginfo_entry<"VERSION", "pkgver">(output);
+    format_pkginfo_entry<"DESC", "pkgdesc">(output);
+    format_pkginfo_entry<"GROUPS", "groups">(output);
+    format_entry<"CSIZE">(std::to_string(m_checksums.size), output);
+    format_pkginfo_entry<"ISIZE", "size">(output);
 
     // add checksums
-    oss << format_entry<"MD5SUM">(bxt::hash_from_file<MD5, MD5_DIGEST_LENGTH>(m_filepath.string()));
+    format_entry<"MD5SUM">(m_checksums.md5, output);
 
-    oss << format_entry<"SHA256SUM">(
-        bxt::hash_from_file<SHA256, SHA256_DIGEST_LENGTH>(m_filepath.string()));
+    format_entry<"SHA256SUM">(m_checksums.sha256, output);
 
     // add PGP sig
-    if (!m_signature.empty()) {
-        oss << format_entry<"PGPSIG">(bxt::Utilities::b64_encode(m_signature));
-    }
-
-    oss << format_pkginfo_entry<"URL", "url">();
-    oss << format_pkginfo_entry<"LICENSE", "license">();
-    oss << format_pkginfo_entry<"ARCH", "arch">();
-    oss << format_pkginfo_entry<"BUILDDATE", "builddate">();
-    oss << format_pkginfo_entry<"PACKAGER", "packager">();
-    oss << format_pkginfo_entry<"REPLACES", "replaces">();
-    oss << format_pkginfo_entry<"CONFLICTS", "conflict">();
-    oss << format_pkginfo_entry<"PROVIDES", "provides">();
-    oss << format_pkginfo_entry<"DEPENDS", "depend">();
-    oss << format_pkginfo_entry<"OPTDEPENDS", "optdepend">();
-    oss << format_pkginfo_entry<"MAKEDEPENDS", "makedepend">();
-    oss << format_pkginfo_entry<"CHECKDEPENDS", "checkdepend">();
-    return oss.str();
+    format_entry<"PGPSIG">(encoded_signature, output);
+
+    format_pkginfo_entry<"URL", "url">(output);
+    format_pkginfo_entry<"LICENSE", "license">(output);
+    format_pkginfo_entry<"ARCH", "arch">(output);
+    format_pkginfo_entry<"BUILDDATE", "builddate">(output);
+    format_pkginfo_entry<"PACKAGER", "packager">(output);
+    format_pkginfo_entry<"REPLACES", "replaces">(output);
+    format_pkginfo_entry<"CONFLICTS", "conflict">(output);
+    format_pkginfo_entry<"PROVIDES", "provides">(output);
+    format_pkginfo_entry<"DEPENDS", "depend">(output);
+    format_pkginfo_entry<"OPTDEPENDS", "optdepend">(output);
+    format_pkginfo_entry<"MAKEDEPENDS", "makedepend">(output);
+    format_pkginfo_entry<"CHECKDEPENDS", "checkdepend">(output);
+    return output;
 }
 } // namespace bxt::Utilities::AlpmDb
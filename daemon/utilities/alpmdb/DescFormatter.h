@@ -9,46 +9,75 @@
 #include "utilities/alpmdb/PkgInfo.h"
 #include "utilities/FixedString.h"
 
-#include <boost/algorithm/string/join.hpp>
+#include <cstdint>
 #include <filesystem>
-#include <fmt/format.h>
-#include <openssl/md5.h>
-#include <openssl/sha.h>
+#include <ranges>
 #include <string>
+#include <string_view>
 
 namespace bxt::Utilities::AlpmDb {
 class DescFormatter {
 public:
-    DescFormatter(PkgInfo m_pkg_info, std::filesystem::path m_filepath, std::string m_signature)
+    // Computed while the package is read, so the file is not read again
+    struct Checksums {
+        std::uintmax_t size = 0;
+        std::string md5;
+        std::string sha256;
+    };
+
+    DescFormatter(PkgInfo m_pkg_info,
+                  std::filesystem::path m_filepath,
+                  std::string m_signature,
+                  Checksums m_checksums)
         : m_pkg_info(std::move(m_pkg_info))
         , m_filepath(std::move(m_filepath))
-        , m_signature(std::move(m_signature)) {
+        , m_signature(std::move(m_signature))
+        , m_checksums(std::move(m_checksums)) {
     }
 
-    static constexpr char format_string[] = "%{}%\n{}\n\n";
-
+    // Appends "%DESC_FIELD%\nvalue\n...\n\n" to the output if the key is set.
+    // Like repo-add, a key whose first value is empty (e.g. "url = ") is left
+    // out.
     template<FixedString desc_field, FixedString pkginfo_field>
-    std::string format_pkginfo_entry() const {
-        auto values = m_pkg_info.values(pkginfo_field.buf);
-        if (values.empty()) {
-            return "";
+    void format_pkginfo_entry(std::string& output) const {
+        constexpr auto key_index = pkginfo_key_index(pkginfo_field.buf);
+
+        auto values = m_pkg_info.values<key_index>();
+        if (std::ranges::empty(values) || (*values.begin()).empty()) {
+            return;
         }
 
-        return fmt::format(format_string, desc_field.buf, boost::join(values, "\n"));
+        append_header<desc_field>(output);
+        for (auto const value : values) {
+            output.append(value);
+            output.push_back('\n');
+        }
+        output.push_back('\n');
     }
-    template<FixedString desc_field> std::string format_entry(std::string const& value) const {
+
+    template<FixedString desc_field>
+    void format_entry(std::string_view value, std::string& output) const {
         if (value.empty()) {
-            return "";
+            return;
         }
-        return fmt::format(format_string, desc_field.buf, value);
+        append_header<desc_field>(output);
+        output.append(value);
+        output.append("\n\n");
     }
 
     std::string format() const;
 
 private:
+    template<FixedString desc_field> static void append_header(std::string& output) {
+        output.push_back('%');
+        output.append(desc_field.buf);
+        output.append("%\n");
+    }
+
     PkgInfo m_pkg_info;
     std::filesystem::path m_filepath;
     std::string m_signature;
+    Checksums m_checksums;
 };
 
 } // namespace bxt::Utilities::AlpmDb
@@ -6,20 +6,18 @@
  */
 #include "PkgInfo.h"
 
-#include <algorithm>
-#include <boost/algorithm/string/regex.hpp>
-#include <iostream>
-#include <regex>
-#include <sstream>
-
 namespace bxt::Utilities::AlpmDb {
 
 void PkgInfo::parse(std::string_view contents) {
+    m_buffer.assign(contents);
+    m_entries.clear();
+
+    std::string_view const buffer = m_buffer;
     std::string_view line;
     std::size_t pos = 0, prev_pos = 0;
 
-    while ((pos = contents.find('\n', prev_pos)) != std::string_view::npos) {
-        line = contents.substr(prev_pos, pos - prev_pos);
+    while ((pos = buffer.find('\n', prev_pos)) != std::string_view::npos) {
+        line = buffer.substr(prev_pos, pos - prev_pos);
         prev_pos = pos + 1;
 
         if (line.starts_with("#")) {
@@ -31,19 +29,15 @@ void PkgInfo::parse(std::string_view contents) {
             continue;
         }
 
-        std::string_view key = line.substr(0, delim_pos);
-        std::string_view value = line.substr(delim_pos + 3);
-
-        m_values[std::string(key)].emplace_back(value);
-    }
-}
+        auto const line_offset = static_cast<uint32_t>(line.data() - buffer.data());
 
-std::vector<std::string> PkgInfo::values(std::string const& key) const {
-    auto it = m_values.find(key);
-    if (it != m_values.end()) {
-        return it->second;
+        m_entries.emplace_back(Entry {
+            .key = pkginfo_key_index(line.substr(0, delim_pos)),
+            .key_offset = line_offset,
+            .key_size = static_cast<uint32_t>(delim_pos),
+            .value_offset = static_cast<uint32_t>(line_offset + delim_pos + 3),
+            .value_size = static_cast<uint32_t>(line.size() - delim_pos - 3)});
     }
-    return {};
 }
 
 } // namespace bxt::Utilities::AlpmDb
@@ -6,21 +6,74 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <boost/container/small_vector.hpp>
+#include <cstdint>
+#include <ranges>
 #include <string>
-#include <unordered_map>
-#include <vector>
+#include <string_view>
 
 namespace bxt::Utilities::AlpmDb {
 
+// .PKGINFO keys known at compile time, shared with DescFormatter
+inline constexpr std::array<std::string_view, 25> PkgInfoKeys = {
+    "pkgname",  "pkgbase",   "pkgver",    "pkgdesc",    "url",         "builddate",
+    "packager", "size",      "arch",      "license",    "replaces",    "group",
+    "groups",   "conflict",  "provides",  "backup",     "depend",      "optdepend",
+    "makedepend", "checkdepend", "pkgtype", "xdata",    "makepkgopt",  "installed",
+    "reason"};
+
+inline constexpr uint8_t UnknownPkgInfoKey = PkgInfoKeys.size();
+
+constexpr uint8_t pkginfo_key_index(std::string_view key) {
+    return std::ranges::find(PkgInfoKeys, key) - PkgInfoKeys.begin();
+}
+
+// Parsed .PKGINFO. Keys and values are kept as offsets into a single owned
+// copy of the file, so a parse allocates a constant number of times.
 class PkgInfo {
 public:
     PkgInfo() = default;
     void parse(std::string_view contents);
 
-    std::vector<std::string> values(std::string const& key) const;
+    // Values of a known key, resolved at compile time
+    template<uint8_t key_index> auto values() const {
+        static_assert(key_index != UnknownPkgInfoKey, "Unknown .PKGINFO key");
+
+        return m_entries
+               | std::views::filter([](Entry const& entry) { return entry.key == key_index; })
+               | std::views::transform([this](Entry const& entry) { return value(entry); });
+    }
+
+    auto values(std::string_view key) const {
+        return m_entries | std::views::filter([this, key](Entry const& entry) {
+                   return std::string_view(m_buffer).substr(entry.key_offset, entry.key_size)
+                          == key;
+               })
+               | std::views::transform([this](Entry const& entry) { return value(entry); });
+    }
+
+    // Size of the parsed contents, an upper bound for the formatted values
+    std::size_t size() const {
+        return m_buffer.size();
+    }
 
 private:
-    std::unordered_map<std::string, std::vector<std::string>> m_values;
+    struct Entry {
+        uint8_t key;
+        uint32_t key_offset;
+        uint32_t key_size;
+        uint32_t value_offset;
+        uint32_t value_size;
+    };
+
+    std::string_view value(Entry const& entry) const {
+        return std::string_view(m_buffer).substr(entry.value_offset, entry.value_size);
+    }
+
+    std::string m_buffer;
+    boost::container::small_vector<Entry, 64> m_entries;
 };
 
 } // namespace bxt::Utilities::AlpmDb
@@ -0,0 +1,82 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#include "PushSource.h"
+
+#include <algorithm>
+
+namespace Archive {
+
+PushSource::PushSource(std::size_t capacity)
+    : m_capacity(std::max<std::size_t>(1, capacity)) {
+}
+
+bool PushSource::write(uint8_t const* data, std::size_t size) {
+    std::unique_lock lock(m_mutex);
+
+    // A single block larger than the capacity is still accepted into an
+    // empty buffer, otherwise it could never be written
+    m_writable.wait(lock, [this, size] {
+        return m_closed || m_buffered == 0 || m_buffered + size <= m_capacity;
+    });
+
+    if (m_closed) {
+        return false;
+    }
+
+    m_blocks.emplace_back(data, data + size);
+    m_buffered += size;
+    m_readable.notify_one();
+
+    return true;
+}
+
+void PushSource::finish(bool succeeded) {
+    std::lock_guard lock(m_mutex);
+
+    m_finished = true;
+    m_failed = !succeeded;
+    m_readable.notify_all();
+}
+
+bool PushSource::wait() {
+    std::unique_lock lock(m_mutex);
+
+    m_readable.wait(lock, [this] { return !m_blocks.empty() || m_finished; });
+
+    return !m_blocks.empty();
+}
+
+std::optional<std::span<uint8_t const>> PushSource::read() {
+    std::unique_lock lock(m_mutex);
+
+    m_readable.wait(lock, [this] { return !m_blocks.empty() || m_finished; });
+
+    if (m_blocks.empty()) {
+        if (m_failed) {
+            return std::nullopt;
+        }
+        return std::span<uint8_t const> {};
+    }
+
+    m_current = std::move(m_blocks.front());
+    m_blocks.pop_front();
+    m_buffered -= m_current.size();
+    m_writable.notify_one();
+
+    return std::span<uint8_t const>(m_current);
+}
+
+void PushSource::close() {
+    std::lock_guard lock(m_mutex);
+
+    m_closed = true;
+    m_blocks.clear();
+    m_buffered = 0;
+    m_writable.notify_all();
+}
+
+} // namespace Archive
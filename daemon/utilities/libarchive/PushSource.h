@@ -0,0 +1,64 @@
+/* === This file is part of bxt ===
+ *
+ *   SPDX-FileCopyrightText: 2024 Artem Grinev <agrinev@manjaro.org>
+ *   SPDX-License-Identifier: AGPL-3.0-or-later
+ *
+ */
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace Archive {
+
+// Hands data pushed by one thread (e.g. an HTTP content receiver) to a
+// Reader pulling it on another one through Reader::open_source. The writer
+// blocks while `capacity` bytes are buffered, so memory stays bounded no
+// matter how far the network is ahead of the parser.
+class PushSource {
+public:
+    static constexpr std::size_t DefaultCapacity = 4 * 1024 * 1024;
+
+    explicit PushSource(std::size_t capacity = DefaultCapacity);
+
+    PushSource(PushSource const&) = delete;
+    PushSource& operator=(PushSource const&) = delete;
+
+    // Producer side. Returns false once the reader has closed the source.
+    bool write(uint8_t const* data, std::size_t size);
+    // Ends the data, a failed source makes the reader fail as well
+    void finish(bool succeeded = true);
+
+    // Consumer side. Blocks until there is data to read, returns false if the
+    // source finished without any.
+    bool wait();
+    // Next block, empty at the end of the data or nullopt if the producer
+    // failed. The block stays valid until the next call.
+    std::optional<std::span<uint8_t const>> read();
+    // Stops the producer, e.g. when parsing failed halfway
+    void close();
+
+private:
+    std::size_t const m_capacity;
+
+    std::mutex m_mutex;
+    std::condition_variable m_readable;
+    std::condition_variable m_writable;
+
+    std::deque<std::vector<uint8_t>> m_blocks;
+    std::size_t m_buffered = 0;
+    bool m_finished = false;
+    bool m_failed = false;
+    bool m_closed = false;
+
+    // Owned by the consumer, the block handed out by the last read()
+    std::vector<uint8_t> m_current;
+};
+
+} // namespace Archive
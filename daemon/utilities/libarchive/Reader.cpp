@@ -8,12 +8,19 @@
 
 #include "utilities/libarchive/Error.h"
 
+#include <algorithm>
 #include <archive.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <variant>
 
 namespace Archive {
-Reader::Result<void> Reader::open_filename(std::filesystem::path const& path) {
-    int status = archive_read_open_filename(m_archive.get(), path.c_str(), 1024);
+Reader::Result<void> Reader::open_filename(std::filesystem::path const& path,
+                                           std::size_t block_size) {
+    int status = archive_read_open_filename(m_archive.get(), path.c_str(), block_size);
 
     if (status != ARCHIVE_OK) {
         return std::unexpected(LibArchiveError(m_archive.get()));
@@ -22,6 +29,153 @@ Reader::Result<void> Reader::open_filename(std::filesystem::path const& path) {
     return {};
 }
 
+Reader::Result<void> Reader::open_filename(std::filesystem::path const& path,
+                                           Observer observer,
+                                           std::size_t block_size) {
+    auto const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        archive_set_error(m_archive.get(), errno, "Failed to open '%s'", path.c_str());
+        return std::unexpected(LibArchiveError(m_archive.get()));
+    }
+
+    m_observed_file = std::make_unique<ObservedFile>(
+        ObservedFile {.fd = fd, .buffer = std::vector<uint8_t>(block_size), .observer = observer});
+
+    // No skip callback is registered on purpose: skipped data has to be read
+    // as well, otherwise the observer would miss it.
+    int status = archive_read_open(m_archive.get(), m_observed_file.get(), nullptr, observed_read,
+                                   observed_close);
+
+    if (status != ARCHIVE_OK) {
+        return std::unexpected(LibArchiveError(m_archive.get()));
+    }
+
+    return {};
+}
+
+Reader::MappedFile::~MappedFile() {
+    ::munmap(data, size);
+}
+
+Reader::Result<void> Reader::open_mapped(std::filesystem::path const& path) {
+    auto const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        archive_set_error(m_archive.get(), errno, "Failed to open '%s'", path.c_str());
+        return std::unexpected(LibArchiveError(m_archive.get()));
+    }
+
+    struct stat file_stat {};
+    if (::fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        archive_set_error(m_archive.get(), file_stat.st_size == 0 ? EINVAL : errno,
+                          "Failed to map '%s'", path.c_str());
+        ::close(fd);
+        return std::unexpected(LibArchiveError(m_archive.get()));
+    }
+
+    auto const size = static_cast<std::size_t>(file_stat.st_size);
+    auto* const data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+
+    if (data == MAP_FAILED) {
+        archive_set_error(m_archive.get(), errno, "Failed to map '%s'", path.c_str());
+        return std::unexpected(LibArchiveError(m_archive.get()));
+    }
+
+    ::madvise(data, size, MADV_SEQUENTIAL);
+    m_mapped_file = std::make_unique<MappedFile>(data, size);
+
+    return open_memory(static_cast<uint8_t*>(data), size);
+}
+
+Reader::Result<void> Reader::open_source(Source source) {
+    m_source = std::make_unique<Source>(std::move(source));
+
+    int status =
+        archive_read_open(m_archive.get(), m_source.get(), nullptr, source_read, nullptr);
+
+    if (status != ARCHIVE_OK) {
+        return std::unexpected(LibArchiveError(m_archive.get()));
+    }
+
+    return {};
+}
+
+la_ssize_t Reader::source_read(struct archive* archive, void* client_data, void const** buffer) {
+    auto& source = *static_cast<Source*>(client_data);
+
+    auto const block = source();
+    if (!block.has_value()) {
+        archive_set_error(archive, EIO, "The source has failed");
+        return ARCHIVE_FATAL;
+    }
+
+    *buffer = block->data();
+    return static_cast<la_ssize_t>(block->size());
+}
+
+Reader::Result<void> Reader::drain() {
+    if (!m_observed_file || m_observed_file->fd < 0) {
+        return {};
+    }
+
+    void const* buffer = nullptr;
+    la_ssize_t size = 0;
+    while ((size = observed_read(m_archive.get(), m_observed_file.get(), &buffer)) > 0) {
+    }
+
+    if (size < 0) {
+        return std::unexpected(LibArchiveError(m_archive.get()));
+    }
+
+    return {};
+}
+
+Reader::Result<void> Reader::finished() {
+    if (m_status == ARCHIVE_EOF) {
+        return {};
+    }
+
+    // Warnings stop the iteration without an error message
+    if (archive_error_string(m_archive.get()) == nullptr) {
+        archive_set_error(m_archive.get(), ARCHIVE_ERRNO_MISC,
+                          "The archive ended before its last entry");
+    }
+    return std::unexpected(LibArchiveError(m_archive.get()));
+}
+
+la_ssize_t Reader::observed_read(struct archive* archive, void* client_data, void const** buffer) {
+    auto* file = static_cast<ObservedFile*>(client_data);
+
+    ssize_t size = 0;
+    do {
+        size = ::read(file->fd, file->buffer.data(), file->buffer.size());
+    } while (size < 0 && errno == EINTR);
+
+    if (size < 0) {
+        archive_set_error(archive, errno, "Read error");
+        return ARCHIVE_FATAL;
+    }
+
+    if (size > 0 && file->observer) {
+        file->observer(file->buffer.data(), static_cast<std::size_t>(size));
+    }
+
+    *buffer = file->buffer.data();
+    return size;
+}
+
+int Reader::observed_close([[maybe_unused]] struct archive* archive, void* client_data) {
+    auto* file = static_cast<ObservedFile*>(client_data);
+
+    if (file->fd >= 0) {
+        ::close(file->fd);
+        file->fd = -1;
+    }
+
+    return ARCHIVE_OK;
+}
+
 Reader::Result<void> Reader::open_memory(std::vector<uint8_t> const& byte_array) {
     int status = archive_read_open_memory(m_archive.get(), byte_array.data(), byte_array.size());
 
@@ -32,7 +186,7 @@ Reader::Result<void> Reader::open_memory(std::vector<uint8_t> const& byte_array)
     return {};
 }
 
-Reader::Result<void> Reader::open_memory(uint8_t* data, size_t length) {
+Reader::Result<void> Reader::open_memory(uint8_t const* data, size_t length) {
     int status = archive_read_open_memory(m_archive.get(), data, length);
 
     if (status != ARCHIVE_OK) {
@@ -43,21 +197,25 @@ Reader::Result<void> Reader::open_memory(uint8_t* data, size_t length) {
 }
 
 Reader::Entry::Result<std::vector<uint8_t>> Reader::Entry::read_all() {
-    constexpr int block_size = 1024;
-    std::array<uint8_t, block_size> buffer;
+    // The hint comes from the archive header, which may lie. Larger entries
+    // grow the vector as they are read.
+    constexpr std::size_t MaxSizeHint = 16 * 1024 * 1024;
 
-    std::size_t actual_size = 0;
     std::vector<uint8_t> result;
+    result.reserve(std::min(m_size_hint, MaxSizeHint));
 
-    do {
-        auto const read_result = read_buffer(buffer, actual_size);
-
-        if (!read_result.has_value()) {
-            return std::unexpected(read_result.error());
+    auto const read_ok = for_each_block([&result](std::span<uint8_t const> block,
+                                                  std::size_t offset) {
+        // Sparse entries skip the holes, those read as zeroes
+        if (offset > result.size()) {
+            result.resize(offset);
         }
+        result.insert(result.end(), block.begin(), block.end());
+    });
 
-        std::copy(buffer.begin(), buffer.begin() + actual_size, std::back_inserter(result));
-    } while (actual_size == block_size);
+    if (!read_ok.has_value()) {
+        return std::unexpected(read_ok.error());
+    }
 
     return result;
 }
@@ -11,12 +11,15 @@
 #include "utilities/errors/Macro.h"
 
 #include <archive.h>
+#include <archive_entry.h>
 #include <array>
 #include <expected>
 #include <filesystem>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <optional>
+#include <span>
 #include <variant>
 #include <vector>
 
@@ -29,6 +32,7 @@ public:
         template<typename T>
         using Result = std::expected<T, std::variant<InvalidEntryError, LibArchiveError>>;
         friend class Reader;
+        friend class Iterator;
 
     public:
         template<std::size_t amount>
@@ -46,6 +50,41 @@ public:
             return {};
         }
 
+        // Calls the visitor with every block of the entry data as decompressed
+        // by libarchive, without copying it. Blocks are valid only during the
+        // call, offset is the position of the block within the entry.
+        template<typename TVisitor> Result<void> for_each_block(TVisitor&& visitor) {
+            if (!m_reader) {
+                return std::unexpected(InvalidEntryError());
+            }
+
+            // Nothing is read on ARCHIVE_RETRY, the call may succeed again
+            constexpr int MaxRetries = 3;
+            int retries = 0;
+
+            while (true) {
+                void const* block = nullptr;
+                std::size_t size = 0;
+                la_int64_t offset = 0;
+
+                auto const status = archive_read_data_block(m_reader, &block, &size, &offset);
+
+                if (status == ARCHIVE_EOF) {
+                    return {};
+                }
+                if (status == ARCHIVE_RETRY && ++retries <= MaxRetries) {
+                    continue;
+                }
+                if (status < ARCHIVE_WARN || status == ARCHIVE_RETRY) {
+                    return std::unexpected(LibArchiveError(m_reader));
+                }
+                retries = 0;
+
+                visitor(std::span(static_cast<uint8_t const*>(block), size),
+                        static_cast<std::size_t>(offset));
+            }
+        }
+
         Result<std::vector<uint8_t>> read_all();
         Result<std::vector<uint8_t>> read(std::size_t amount);
 
@@ -61,6 +100,9 @@ public:
             : m_reader(a) {
         }
         archive* m_reader = nullptr;
+
+        // Size from the header if the format stores it, used to preallocate
+        std::size_t m_size_hint = 0;
     };
 
     class Iterator {
@@ -85,26 +127,12 @@ public:
         ~Iterator() = default;
 
         iterator& operator++(int) {
-            archive_entry* entry = {};
-            auto status = archive_read_next_header(m_archive, &entry);
-
-            m_value.header = Header(entry);
-
-            if (status != ARCHIVE_OK) {
-                m_value.header = std::nullopt;
-            }
+            advance();
             return *this;
         }
 
         iterator& operator++() {
-            archive_entry* entry = {};
-            auto status = archive_read_next_header(m_archive, &entry);
-
-            m_value.header = Header(entry);
-
-            if (status != ARCHIVE_OK) {
-                m_value.header = std::nullopt;
-            }
+            advance();
 
             return *this;
         }
@@ -143,16 +171,64 @@ public:
         }
 
     private:
+        void advance() {
+            archive_entry* entry = {};
+            auto status = archive_read_next_header(m_archive, &entry);
+
+            m_value.header = Header(entry);
+            m_value.entry.m_size_hint = 0;
+            if (m_status) {
+                *m_status = status;
+            }
+
+            if (status != ARCHIVE_OK) {
+                m_value.header = std::nullopt;
+            } else if (archive_entry_size_is_set(entry)) {
+                m_value.entry.m_size_hint = static_cast<std::size_t>(archive_entry_size(entry));
+            }
+        }
+
         Value m_value;
         archive* m_archive = nullptr;
+        // Status of the last header read, kept by the reader
+        int* m_status = nullptr;
     };
 
     Reader() = default;
     BXT_DECLARE_RESULT(LibArchiveError)
 
-    Result<void> open_filename(std::filesystem::path const& path);
+    // Amount of the file handed to libarchive per read. Compressed packages
+    // and databases are read sequentially, so large blocks mean fewer syscalls
+    // and decompressor calls.
+    static constexpr std::size_t DefaultBlockSize = 128 * 1024;
+
+    // Receives every raw (still compressed) block read from the file
+    using Observer = std::function<void(uint8_t const* data, std::size_t size)>;
+
+    Result<void> open_filename(std::filesystem::path const& path,
+                               std::size_t block_size = DefaultBlockSize);
+
+    // Opens the file the same way as above, but passes all bytes read from it
+    // to the observer. Call drain() before finishing with the archive to let
+    // the observer see the bytes the archive didn't need to read.
+    Result<void> open_filename(std::filesystem::path const& path,
+                               Observer observer,
+                               std::size_t block_size = DefaultBlockSize);
+
+    // Maps a local file into memory and reads it from there, libarchive then
+    // works on the page cache directly instead of copying into read buffers.
+    Result<void> open_mapped(std::filesystem::path const& path);
+
+    // Pulls the archive from a callback, e.g. while it is still being
+    // downloaded (see PushSource). The callback returns the next block, an
+    // empty one at the end or nullopt on failure; a block has to stay valid
+    // until the next call.
+    using Source = std::function<std::optional<std::span<uint8_t const>>()>;
+    Result<void> open_source(Source source);
+
+    Result<void> drain();
     Result<void> open_memory(std::vector<uint8_t> const& byte_array);
-    Result<void> open_memory(uint8_t* data, size_t length);
+    Result<void> open_memory(uint8_t const* data, size_t length);
 
     struct archive* archive() {
         return m_archive.get();
@@ -164,6 +240,7 @@ public:
     Iterator begin() {
         Iterator it(m_archive.get());
         it.m_archive = m_archive.get();
+        it.m_status = &m_status;
         it++;
 
         return it;
@@ -173,6 +250,10 @@ public:
         return Iterator(m_archive.get());
     }
 
+    // Iteration stops at the end of the archive as well as on an error, e.g.
+    // of a truncated one. Fails for the latter once the iteration is over.
+    Result<void> finished();
+
     Result<void> close() {
         if (archive_read_close(m_archive.get()) != ARCHIVE_OK) {
             return bxt::make_error<LibArchiveError>(m_archive.get());
@@ -181,8 +262,41 @@ public:
     }
 
 private:
+    struct ObservedFile {
+        int fd = -1;
+        std::vector<uint8_t> buffer;
+        Observer observer;
+    };
+
+    static la_ssize_t
+        observed_read(struct archive* archive, void* client_data, void const** buffer);
+    static int observed_close(struct archive* archive, void* client_data);
+
+    static la_ssize_t
+        source_read(struct archive* archive, void* client_data, void const** buffer);
+
+    struct MappedFile {
+        MappedFile(void* data, std::size_t size)
+            : data(data)
+            , size(size) {
+        }
+        MappedFile(MappedFile const&) = delete;
+        MappedFile& operator=(MappedFile const&) = delete;
+        ~MappedFile();
+
+        void* data;
+        std::size_t size;
+    };
+
+    // Must outlive m_archive, the close callback still refers to it
+    std::unique_ptr<ObservedFile> m_observed_file;
+    std::unique_ptr<MappedFile> m_mapped_file;
+    std::unique_ptr<Source> m_source;
+
     std::unique_ptr<struct archive, decltype(&archive_read_free)> m_archive {archive_read_new(),
                                                                              archive_read_free};
+
+    int m_status = ARCHIVE_OK;
 };
 
 } // namespace Archive